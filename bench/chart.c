@@ -0,0 +1,127 @@
+// chart.c
+// Прогноз в столбцы и точки графика: разбор сохраненного ответа
+// /data/2.5/forecast (forecast.h) и построение точек серий (chart.h) для
+// рамки шириной --width. Кроме 40 точек настоящего прогноза - длинная
+// синтетическая серия (--points): на ней видно прореживание - точек
+// на экран уходит не больше 4 на столбец пикселей, сколько бы их ни было.
+//
+// Компиляция: cc -O2 bench/chart.c -o bench/chart -lX11
+// Запуск из корня репозитория: bench/chart [--ms 300] [--width 500] [--points 100000]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../forecast.h"
+#include "../chart.h"
+
+static volatile long sink;      // не дает компилятору выбросить работу
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *read_file(const char *path, long *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    if (data && fread(data, 1, *len, f) != (size_t)*len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// Точки серии за один вызов chart_points, нс
+static double measure_points(const ChartFrame *f, const float *t, const float *v, int n,
+                             XPoint *out, int max_out, double budget_ms, int *count) {
+    long iters = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (int i = 0; i < 16; i++) {
+            *count = chart_points(f, t, v, n, out, max_out);
+            sink += out[*count / 2].y;
+        }
+        iters += 16;
+        elapsed = now_ns() - start;
+    } while (elapsed < budget_ms * 1e6);
+    return elapsed / iters;
+}
+
+int main(int argc, char **argv) {
+    double budget_ms = 300;
+    int width = 500, points = 100000;
+    const char *path = "bench/responses/forecast_ryazan.json";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) budget_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) points = atoi(argv[++i]);
+        else path = argv[i];
+    }
+    if (width < 1 || points < 2) return 1;
+
+    long len;
+    char *text = read_file(path, &len);
+    if (!text) {
+        perror(path);
+        return 1;
+    }
+
+    static Forecast fc;
+    if (!forecast_parse(&fc, text, len)) {
+        fprintf(stderr, "%s: not a forecast\n", path);
+        return 1;
+    }
+    long iters = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (int i = 0; i < 16; i++) {
+            forecast_parse(&fc, text, len);
+            sink += fc.n;
+        }
+        iters += 16;
+        elapsed = now_ns() - start;
+    } while (elapsed < budget_ms * 1e6);
+    double parse_ns = elapsed / iters;
+    printf("forecast parse   %6ld bytes  %2d points  %8.1f us  %6.1f MB/s  (%zu bytes of columns)\n",
+           len, fc.n, parse_ns / 1e3, len / parse_ns * 1e3,
+           sizeof(fc.hours) + sizeof(fc.temp) + sizeof(fc.humidity) + sizeof(fc.precip) + sizeof(fc.pop));
+
+    int max_out = 4 * width + 2;
+    XPoint *out = malloc(sizeof(XPoint) * max_out);
+    ChartFrame f = { 0, 0, width, 100, 0, fc.hours[fc.n - 1], 0, 0 };
+    chart_range(fc.temp, fc.n, &f.v0, &f.v1);
+    int count;
+    double ns = measure_points(&f, fc.hours, fc.temp, fc.n, out, max_out, budget_ms, &count);
+    printf("forecast series  %7d -> %5d points  %8.2f us  %6.1f ns/point\n",
+           fc.n, count, ns / 1e3, ns / fc.n);
+
+    // Синтетическая серия: суточный ход и шум
+    float *t = malloc(sizeof(float) * points);
+    float *v = malloc(sizeof(float) * points);
+    unsigned seed = 1;
+    for (int i = 0; i < points; i++) {
+        seed = seed * 1103515245 + 12345;
+        t[i] = i * 0.25f;
+        v[i] = 10 * ((i / 48) % 2 ? 1 : -1) + (float)(seed >> 16 & 0xFF) / 64;
+    }
+    f.t1 = t[points - 1];
+    chart_range(v, points, &f.v0, &f.v1);
+    ns = measure_points(&f, t, v, points, out, max_out, budget_ms, &count);
+    printf("long series      %7d -> %5d points  %8.2f us  %6.1f ns/point\n",
+           points, count, ns / 1e3, ns / points);
+
+    free(t);
+    free(v);
+    free(out);
+    free(text);
+    return 0;
+}
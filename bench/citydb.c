@@ -0,0 +1,137 @@
+// citydb.c
+// Подсказки городов (citydb.h): сборка справочника из списка и поиск по
+// префиксу, как при наборе в поле ввода - по поиску на каждое нажатие,
+// от первой буквы до полного имени, латиницей и кириллицей. Кроме
+// настоящего списка - синтетический на --cities городов: время поиска
+// от размера справочника почти не зависит (двоичный поиск в отрезке
+// первого байта и просмотр только подходящих ключей).
+//
+// Компиляция: cc -O2 bench/citydb.c -o bench/citydb
+// Запуск из корня репозитория: bench/citydb [--ms 300] [--cities 200000] [cities.tsv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../citydb.h"
+
+#define MAX_RESULTS 6
+#define HIST_US     1000        // гистограмма времени поиска по микросекундам
+
+static volatile long sink;      // не дает компилятору выбросить работу
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long hist[HIST_US + 1];
+
+// Набор name по символу (UTF-8 - целиком): поиск на каждый префикс.
+// Возвращает число поисков; время - в *total и гистограмму
+static int type_name(const CityDb *db, const char *name, double *total) {
+    const CityRecord *out[MAX_RESULTS];
+    char prefix[CITYDB_NAME_MAX];
+    int len = strlen(name), lookups = 0;
+    if (len >= CITYDB_NAME_MAX) len = CITYDB_NAME_MAX - 1;
+    for (int i = 1; i <= len; i++) {
+        if (i < len && (name[i] & 0xC0) == 0x80) continue;
+        memcpy(prefix, name, i);
+        prefix[i] = '\0';
+        double start = now_ns();
+        sink += citydb_suggest(db, prefix, out, MAX_RESULTS);
+        double ns = now_ns() - start;
+        *total += ns;
+        hist[ns / 1e3 < HIST_US ? (int)(ns / 1e3) : HIST_US]++;
+        lookups++;
+    }
+    return lookups;
+}
+
+// Все имена справочника, набранные по символу, - пока не выйдет budget_ms
+static void measure(const char *label, const CityDb *db, double budget_ms) {
+    double total = 0, start = now_ns();
+    long lookups = 0;
+    unsigned i = 0;
+    memset(hist, 0, sizeof(hist));
+    do {
+        const CityRecord *c = &db->cities[i++ % db->h->ncities];
+        lookups += type_name(db, citydb_name(db, c), &total);
+        if (c->name_ru) lookups += type_name(db, citydb_name_ru(db, c), &total);
+    } while (now_ns() - start < budget_ms * 1e6);
+
+    // 99.9-й перцентиль: редкие выбросы - вытеснение процесса, не поиск
+    long seen = 0;
+    int p999 = 0;
+    while (p999 < HIST_US && (seen += hist[p999]) < lookups - lookups / 1000) p999++;
+    printf("%-10s %7u cities %8u keys %9zu bytes  %8ld lookups  %6.0f ns avg  p99.9 < %d us\n",
+           label, db->h->ncities, db->h->nkeys, db->map_len, lookups, total / lookups, p999 + 1);
+}
+
+static int build_and_open(const char *list, const char *path, CityDb *db) {
+    double start = now_ns();
+    if (!citydb_build(list, path)) {
+        fprintf(stderr, "%s: cannot build %s\n", list, path);
+        return 0;
+    }
+    double build_ms = (now_ns() - start) / 1e6;
+    start = now_ns();
+    if (!citydb_map(db, path)) {
+        fprintf(stderr, "%s: not a city list\n", path);
+        return 0;
+    }
+    printf("%s: built in %.1f ms, mapped in %.1f us\n", list, build_ms, (now_ns() - start) / 1e3);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    double budget_ms = 300;
+    int ncities = 200000;
+    const char *list = "cities.tsv";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) budget_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "--cities") == 0 && i + 1 < argc) ncities = atoi(argv[++i]);
+        else list = argv[i];
+    }
+
+    CityDb db;
+    memset(&db, 0, sizeof(db));
+    if (!build_and_open(list, "/tmp/citydb-bench.db", &db)) return 1;
+    measure("bundled", &db, budget_ms);
+
+    // Синтетический список: имена из слогов, половина - с кириллицей
+    static const char *latin[] = { "ka", "ro", "mi", "sa", "no", "vo", "gor", "sk", "tu", "le", "pe", "an" };
+    static const char *cyrillic[] = { "ка", "ро", "ми", "са", "но", "во", "гор", "ск", "ту", "ле", "пе", "ан" };
+    const char *tsv = "/tmp/citydb-bench.tsv";
+    FILE *f = fopen(tsv, "w");
+    if (!f) {
+        perror(tsv);
+        return 1;
+    }
+    unsigned seed = 1;
+    for (int i = 0; i < ncities; i++) {
+        char name[64] = "", name_ru[96] = "";
+        int syllables = 2 + i % 4;
+        for (int k = 0; k < syllables; k++) {
+            seed = seed * 1103515245 + 12345;
+            int s = (seed >> 16) % 12;
+            strcat(name, latin[s]);
+            strcat(name_ru, cyrillic[s]);
+        }
+        name[0] -= 32;
+        fprintf(f, "%d\t%.4f\t%.4f\tXX\t%s\t%s\n", 1000000 + i, (i % 180) - 90.0, (i % 360) - 180.0,
+                name, i % 2 ? name_ru : "");
+    }
+    fclose(f);
+    if (!build_and_open(tsv, "/tmp/citydb-bench-big.db", &db)) return 1;
+    measure("synthetic", &db, budget_ms);
+
+    citydb_close(&db);
+    remove(tsv);
+    remove("/tmp/citydb-bench.db");
+    remove("/tmp/citydb-bench-big.db");
+    return 0;
+}
@@ -0,0 +1,246 @@
+// json.c
+// Пропускная способность разбора ответа OpenWeatherMap: прежний разбор
+// strstr по каждому полю против однопроходного json.h - целым текстом и
+// кусками по 1448 байт (сегмент TCP), как тело приходит из сокета.
+// Для каждого записанного ответа печатает нс на разбор и МБ/с и
+// сравнивает извлеченные поля; разбор по одному байту обязан дать то же,
+// что и целым текстом.
+//
+// Компиляция: cc -O2 bench/json.c -o bench/json
+// Запуск из корня репозитория: bench/json [--ms 300] [file.json ...]
+// (по умолчанию - bench/responses/*.json)
+
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../json.h"
+
+#define CHUNK 1448
+
+typedef struct {
+    char temperature[20];
+    char feels_like[20];
+    char humidity[20];
+    char description[50];
+    char city[50];
+    char icon_code[10];
+    char error[100];
+} Result;
+
+typedef struct {
+    int cod;
+    double temp;
+    double feels_like;
+    int humidity;
+    char description[50];
+    char name[50];
+    char icon[10];
+    char message[80];
+} Reply;
+
+enum { WF_COD, WF_TEMP, WF_FEELS_LIKE, WF_HUMIDITY, WF_DESCRIPTION, WF_NAME, WF_ICON, WF_MESSAGE, WF_COUNT };
+
+static const JsonField fields[WF_COUNT] = {
+    JSON_FIELD("cod",                    JSON_F_INT,    Reply, cod),
+    JSON_FIELD("main.temp",              JSON_F_DOUBLE, Reply, temp),
+    JSON_FIELD("main.feels_like",        JSON_F_DOUBLE, Reply, feels_like),
+    JSON_FIELD("main.humidity",          JSON_F_INT,    Reply, humidity),
+    JSON_FIELD("weather[0].description", JSON_F_TEXT,   Reply, description),
+    JSON_FIELD("name",                   JSON_F_TEXT,   Reply, name),
+    JSON_FIELD("weather[0].icon",        JSON_F_TEXT,   Reply, icon),
+    JSON_FIELD("message",                JSON_F_TEXT,   Reply, message),
+};
+
+static volatile int sink;   // не дает компилятору выбросить разбор
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ---------- прежний разбор (weather.c / new_icon.c до json.h) ----------
+static void strstr_copy(const char *json, const char *key, int skip, char stop,
+                        char *dest, int size, int kelvin) {
+    const char *ptr = strstr(json, key);
+    if (!ptr) return;
+    ptr += skip;
+    const char *end = strchr(ptr, stop);
+    if (!end) return;
+    int len = end - ptr;
+    if (len >= size - 1) return;
+    strncpy(dest, ptr, len);
+    dest[len] = '\0';
+    if (kelvin) snprintf(dest, size, "%.1f", (float)(atof(dest) - 273.15));
+}
+
+static void parse_strstr(const char *json, Result *r) {
+    memset(r, 0, sizeof(*r));
+    if (strstr(json, "\"cod\":200")) {
+        strstr_copy(json, "\"temp\":", 7, ',', r->temperature, sizeof(r->temperature), 1);
+        strstr_copy(json, "\"feels_like\":", 13, ',', r->feels_like, sizeof(r->feels_like), 1);
+        strstr_copy(json, "\"humidity\":", 11, ',', r->humidity, sizeof(r->humidity), 0);
+        strstr_copy(json, "\"icon\":\"", 8, '"', r->icon_code, sizeof(r->icon_code) + 1, 0);
+        strstr_copy(json, "\"description\":\"", 15, '"', r->description, sizeof(r->description), 0);
+        strstr_copy(json, "\"name\":\"", 8, '"', r->city, sizeof(r->city), 0);
+        return;
+    }
+    const char *msg = strstr(json, "\"message\":\"");
+    if (msg) {
+        msg += 11;
+        const char *end = strchr(msg, '"');
+        if (end) snprintf(r->error, sizeof(r->error), "API Error: %.*s", (int)(end - msg), msg);
+    } else {
+        strcpy(r->error, "API returned error");
+    }
+}
+
+// ---------- json.h ----------
+static void to_result(const JsonParser *p, const Reply *reply, Result *r) {
+    memset(r, 0, sizeof(*r));
+    if (!p->error && reply->cod == 200) {
+        if (json_found(p, WF_TEMP)) snprintf(r->temperature, sizeof(r->temperature), "%.1f", reply->temp - 273.15);
+        if (json_found(p, WF_FEELS_LIKE)) snprintf(r->feels_like, sizeof(r->feels_like), "%.1f", reply->feels_like - 273.15);
+        if (json_found(p, WF_HUMIDITY)) snprintf(r->humidity, sizeof(r->humidity), "%d", reply->humidity);
+        strcpy(r->description, reply->description);
+        strcpy(r->city, reply->name);
+        strcpy(r->icon_code, reply->icon);
+    } else if (json_found(p, WF_MESSAGE)) {
+        snprintf(r->error, sizeof(r->error), "API Error: %s", reply->message);
+    } else {
+        strcpy(r->error, "API returned error");
+    }
+}
+
+static void parse_json(const char *json, long len, long chunk, Result *r) {
+    JsonParser p;
+    Reply reply;
+    memset(&reply, 0, sizeof(reply));
+    json_init(&p, fields, WF_COUNT, &reply);
+    for (long off = 0; off < len; off += chunk) {
+        json_feed(&p, json + off, len - off < chunk ? len - off : chunk);
+    }
+    json_finish(&p);
+    to_result(&p, &reply, r);
+}
+
+// ---------- замер ----------
+typedef struct {
+    const char *name;
+    long chunk;     // 0 - strstr
+} Method;
+
+static const Method methods[] = {
+    { "strstr",       0 },
+    { "json",         1L << 30 },
+    { "json/1448",    CHUNK },
+};
+
+static double measure(const Method *m, const char *text, long len, double budget_ms) {
+    Result r;
+    long iters = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (int i = 0; i < 64; i++) {
+            if (m->chunk) parse_json(text, len, m->chunk, &r);
+            else parse_strstr(text, &r);
+            sink += r.temperature[0];
+        }
+        iters += 64;
+        elapsed = now_ns() - start;
+    } while (elapsed < budget_ms * 1e6);
+    return elapsed / iters;
+}
+
+static void show(const char *label, const Result *r) {
+    printf("    %-7s temp=%s feels=%s hum=%s desc=\"%s\" name=\"%s\" icon=%s err=\"%s\"\n",
+           label, r->temperature, r->feels_like, r->humidity, r->description,
+           r->city, r->icon_code, r->error);
+}
+
+static int same(const Result *a, const Result *b) {
+    return strcmp(a->temperature, b->temperature) == 0 &&
+           strcmp(a->feels_like, b->feels_like) == 0 &&
+           strcmp(a->humidity, b->humidity) == 0 &&
+           strcmp(a->description, b->description) == 0 &&
+           strcmp(a->city, b->city) == 0 &&
+           strcmp(a->icon_code, b->icon_code) == 0 &&
+           strcmp(a->error, b->error) == 0;
+}
+
+static int run_file(const char *path, double budget_ms) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(len + 1);
+    if (!text || fread(text, 1, len, f) != (size_t)len) {
+        fclose(f);
+        free(text);
+        return 0;
+    }
+    fclose(f);
+    text[len] = '\0';
+
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    printf("%s (%ld bytes)\n", name, len);
+
+    int ok = 1;
+    Result old, whole, bytewise;
+    parse_strstr(text, &old);
+    parse_json(text, len, len, &whole);
+    parse_json(text, len, 1, &bytewise);
+    if (!same(&whole, &bytewise)) {
+        printf("  FAIL: byte-by-byte parse differs\n");
+        ok = 0;
+    }
+
+    double base = 0;
+    for (int i = 0; i < (int)(sizeof(methods) / sizeof(methods[0])); i++) {
+        double ns = measure(&methods[i], text, len, budget_ms);
+        if (i == 0) base = ns;
+        printf("  %-10s %9.0f ns/parse %8.1f MB/s  x%.2f\n",
+               methods[i].name, ns, len / ns * 1e3, base / ns);
+    }
+
+    if (same(&old, &whole)) {
+        printf("  fields: same\n");
+    } else {
+        printf("  fields: differ\n");
+        show("strstr", &old);
+        show("json", &whole);
+    }
+    free(text);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    double budget_ms = 300;
+    int ok = 1, files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            budget_ms = atof(argv[++i]);
+        } else {
+            ok &= run_file(argv[i], budget_ms);
+            files++;
+        }
+    }
+    if (files == 0) {
+        glob_t g;
+        if (glob("bench/responses/*.json", 0, NULL, &g) != 0) {
+            fprintf(stderr, "json: no files (run from the repository root)\n");
+            return 1;
+        }
+        for (size_t i = 0; i < g.gl_pathc; i++) ok &= run_file(g.gl_pathv[i], budget_ms);
+        globfree(&g);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,380 @@
+// latency.c
+// Задержка "ввод -> кадр" для файлового менеджера и погоды.
+// Запускает Xvfb, стартует приложение с FRAME_MARK=1, подает нажатия
+// через XTest и ждет PropertyNotify на _BENCH_FRAME (см. render.h) -
+// это момент, когда кадр отправлен серверу. Печатает p50/p99 и число
+// X запросов на кадр по каждому сценарию.
+//
+// Компиляция: cc bench/latency.c -o bench/latency -lX11 -lXtst
+// Запуск из корня репозитория: bench/latency [--display :99] [--no-xvfb]
+//                             [--rows 10000] [--fm ./conductor] [--weather ./weather]
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SETTLE_MS      30     // тишина перед следующим вводом
+#define FRAME_TIMEOUT  5000   // мс ожидания кадра
+#define MAX_SAMPLES    20000
+
+typedef struct {
+    const char *name;
+    double lat[MAX_SAMPLES];    // мкс
+    long requests[MAX_SAMPLES];
+    int count;
+    int timeouts;
+} Scenario;
+
+typedef struct {
+    Display *dpy;
+    Window win;
+    Atom mark;
+    pid_t pid;
+    unsigned long last_seq;
+    long last_requests;
+} Target;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void die(const char *msg) {
+    fprintf(stderr, "latency: %s\n", msg);
+    exit(1);
+}
+
+// ---------- Xvfb and target processes ----------
+static pid_t spawn(char *const argv[], const char *display) {
+    pid_t pid = fork();
+    if (pid < 0) die("fork");
+    if (pid == 0) {
+        setenv("DISPLAY", display, 1);
+        setenv("FRAME_MARK", "1", 1);
+        // вывод приложений не мешает таблице результатов
+        freopen("/dev/null", "w", stdout);
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+static Display *open_display_retry(const char *name, int timeout_ms) {
+    double deadline = now_us() + timeout_ms * 1000.0;
+    while (now_us() < deadline) {
+        Display *dpy = XOpenDisplay(name);
+        if (dpy) return dpy;
+        usleep(50000);
+    }
+    return NULL;
+}
+
+static Window find_window(Display *dpy, Window w, const char *title) {
+    char *name = NULL;
+    if (XFetchName(dpy, w, &name) && name) {
+        int match = strcmp(name, title) == 0;
+        XFree(name);
+        if (match) return w;
+    }
+
+    Window root, parent, *children = NULL;
+    unsigned int n = 0;
+    Window found = None;
+    if (XQueryTree(dpy, w, &root, &parent, &children, &n)) {
+        for (unsigned int i = 0; i < n && found == None; i++) {
+            found = find_window(dpy, children[i], title);
+        }
+        if (children) XFree(children);
+    }
+    return found;
+}
+
+// Ждет очередную метку кадра; 1 - дождались, 0 - таймаут
+static int wait_frame(Target *t, int timeout_ms) {
+    double deadline = now_us() + timeout_ms * 1000.0;
+    int fd = ConnectionNumber(t->dpy);
+
+    for (;;) {
+        while (XPending(t->dpy)) {
+            XEvent ev;
+            XNextEvent(t->dpy, &ev);
+            if (ev.type != PropertyNotify || ev.xproperty.atom != t->mark ||
+                ev.xproperty.state != PropertyNewValue) continue;
+
+            Atom type;
+            int format;
+            unsigned long n, after;
+            unsigned char *data = NULL;
+            if (XGetWindowProperty(t->dpy, t->win, t->mark, 0, 2, False, XA_CARDINAL,
+                                   &type, &format, &n, &after, &data) == Success &&
+                data && n == 2) {
+                long *v = (long *)data;
+                t->last_seq = v[0];
+                t->last_requests = v[1];
+            }
+            if (data) XFree(data);
+            return 1;
+        }
+
+        double left = deadline - now_us();
+        if (left <= 0) return 0;
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        struct timeval tv;
+        tv.tv_sec = (long)(left / 1e6);
+        tv.tv_usec = (long)left % 1000000;
+        select(fd + 1, &fds, NULL, NULL, &tv);
+    }
+}
+
+// Съедает все кадры, пока приложение не затихнет на SETTLE_MS
+static void settle(Target *t) {
+    while (wait_frame(t, SETTLE_MS)) {
+    }
+}
+
+static int attach(Target *t, const char *display, char *const argv[], const char *title) {
+    memset(t, 0, sizeof(*t));
+    t->dpy = XOpenDisplay(display);
+    if (!t->dpy) return 0;
+    t->mark = XInternAtom(t->dpy, "_BENCH_FRAME", False);
+    t->pid = spawn(argv, display);
+
+    double deadline = now_us() + 30e6; // погода может долго ждать сеть
+    while (now_us() < deadline) {
+        t->win = find_window(t->dpy, DefaultRootWindow(t->dpy), title);
+        if (t->win != None) break;
+        usleep(20000);
+    }
+    if (t->win == None) return 0;
+
+    XSelectInput(t->dpy, t->win, PropertyChangeMask);
+    XSync(t->dpy, False);
+
+    // Первый кадр по Expose мог пройти до XSelectInput - не ждем его строго
+    wait_frame(t, 2000);
+    settle(t);
+    return 1;
+}
+
+static void detach(Target *t) {
+    if (t->pid > 0) {
+        kill(t->pid, SIGTERM);
+        waitpid(t->pid, NULL, 0);
+    }
+    if (t->dpy) XCloseDisplay(t->dpy);
+}
+
+// ---------- input injection ----------
+static void fake_key(Display *dpy, KeySym ks, int shift) {
+    KeyCode kc = XKeysymToKeycode(dpy, ks);
+    KeyCode sh = XKeysymToKeycode(dpy, XK_Shift_L);
+    if (shift) XTestFakeKeyEvent(dpy, sh, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, kc, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, kc, False, CurrentTime);
+    if (shift) XTestFakeKeyEvent(dpy, sh, False, CurrentTime);
+}
+
+static void fake_click(Target *t, int x, int y) {
+    int rx, ry;
+    Window child;
+    XTranslateCoordinates(t->dpy, t->win, DefaultRootWindow(t->dpy), x, y, &rx, &ry, &child);
+    XTestFakeMotionEvent(t->dpy, -1, rx, ry, CurrentTime);
+    XTestFakeButtonEvent(t->dpy, 1, True, CurrentTime);
+    XTestFakeButtonEvent(t->dpy, 1, False, CurrentTime);
+}
+
+static void focus(Target *t) {
+    XSetInputFocus(t->dpy, t->win, RevertToPointerRoot, CurrentTime);
+    XSync(t->dpy, False);
+}
+
+static void record(Scenario *sc, Target *t, double start) {
+    if (!wait_frame(t, FRAME_TIMEOUT)) {
+        sc->timeouts++;
+        return;
+    }
+    if (sc->count < MAX_SAMPLES) {
+        sc->lat[sc->count] = now_us() - start;
+        sc->requests[sc->count] = t->last_requests;
+        sc->count++;
+    }
+}
+
+static void measure_key(Scenario *sc, Target *t, KeySym ks, int shift) {
+    settle(t);
+    double start = now_us();
+    fake_key(t->dpy, ks, shift);
+    XFlush(t->dpy);
+    record(sc, t, start);
+}
+
+// ---------- report ----------
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(double *v, int n, double p) {
+    if (n == 0) return 0;
+    int i = (int)(p * (n - 1) + 0.5);
+    return v[i];
+}
+
+static void report(Scenario *sc) {
+    double total_req = 0;
+    for (int i = 0; i < sc->count; i++) total_req += sc->requests[i];
+    qsort(sc->lat, sc->count, sizeof(double), cmp_double);
+
+    printf("%-16s %7d %9.0f %9.0f %9.0f %10.1f %8d\n",
+           sc->name, sc->count,
+           percentile(sc->lat, sc->count, 0.50),
+           percentile(sc->lat, sc->count, 0.99),
+           sc->count ? sc->lat[sc->count - 1] : 0,
+           sc->count ? total_req / sc->count : 0,
+           sc->timeouts);
+}
+
+// ---------- scenarios ----------
+static void make_tree(const char *dir, int rows) {
+    char path[1024];
+    mkdir(dir, 0755);
+    for (int i = 0; i < rows; i++) {
+        snprintf(path, sizeof(path), "%s/row_%05d.txt", dir, i);
+        FILE *f = fopen(path, "w");
+        if (!f) die("cannot create test tree");
+        fprintf(f, "line %d\n", i);
+        fclose(f);
+    }
+    snprintf(path, sizeof(path), "%s/.hidden", dir);
+    FILE *f = fopen(path, "w");
+    if (f) fclose(f);
+}
+
+static void file_manager(const char *display, const char *fm, int rows) {
+    static Scenario scroll = {.name = "fm-scroll"}, hidden = {.name = "fm-toggle-hidden"},
+                   viewer = {.name = "fm-open-viewer"};
+    char dir[] = "/tmp/latency-tree-XXXXXX";
+    if (!mkdtemp(dir)) die("mkdtemp");
+    make_tree(dir, rows);
+
+    char *argv[] = {(char *)fm, dir, NULL};
+    Target t;
+    if (!attach(&t, display, argv, "Minix File Manager")) die("file manager window not found");
+    focus(&t);
+
+    for (int i = 0; i < rows; i++) measure_key(&scroll, &t, XK_Down, 0);
+    for (int i = 0; i < 20; i++) measure_key(&hidden, &t, XK_h, 0);
+
+    // Просмотр: Home -> первый файл, Enter открывает, Escape закрывает
+    for (int i = 0; i < 20; i++) {
+        fake_key(t.dpy, XK_Home, 0);
+        settle(&t);
+        measure_key(&viewer, &t, XK_Return, 0);
+        XSync(t.dpy, False);
+        fake_key(t.dpy, XK_Escape, 0);
+        XFlush(t.dpy);
+        settle(&t);
+        focus(&t);
+    }
+
+    detach(&t);
+    report(&scroll);
+    report(&hidden);
+    report(&viewer);
+
+    char cmd[1100];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    system(cmd);
+}
+
+static void weather(const char *display, const char *app) {
+    static Scenario type = {.name = "weather-type"};
+    char *argv[] = {(char *)app, "Ryazan", NULL};
+    Target t;
+    if (!attach(&t, display, argv, "MINIX3 Weather")) die("weather window not found");
+
+    // Поле ввода города: 150..350 x offset_y+30..+55 (offset_y = 110)
+    fake_click(&t, 250, 150);
+    XFlush(t.dpy);
+    settle(&t);
+    focus(&t);
+
+    const char *city = "Saint Petersburg";
+    for (int round = 0; round < 10; round++) {
+        for (const char *p = city; *p; p++) {
+            KeySym ks = *p == ' ' ? XK_space : (KeySym)tolower((unsigned char)*p);
+            measure_key(&type, &t, ks, isupper((unsigned char)*p));
+        }
+        for (const char *p = city; *p; p++) measure_key(&type, &t, XK_BackSpace, 0);
+    }
+
+    detach(&t);
+    report(&type);
+}
+
+int main(int argc, char **argv) {
+    const char *display = ":99";
+    const char *fm = "./conductor";
+    const char *weather_app = "./weather";
+    int use_xvfb = 1;
+    int rows = 10000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--display") == 0 && i + 1 < argc) display = argv[++i];
+        else if (strcmp(argv[i], "--no-xvfb") == 0) use_xvfb = 0;
+        else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fm") == 0 && i + 1 < argc) fm = argv[++i];
+        else if (strcmp(argv[i], "--weather") == 0 && i + 1 < argc) weather_app = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--display :N] [--no-xvfb] [--rows N] "
+                            "[--fm path] [--weather path]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!use_xvfb) {
+        const char *env = getenv("DISPLAY");
+        if (env) display = env;
+    }
+
+    pid_t xvfb = 0;
+    if (use_xvfb) {
+        char *xargv[] = {"Xvfb", (char *)display, "-screen", "0", "1024x768x24", "-nolisten", "tcp", NULL};
+        xvfb = spawn(xargv, display);
+    }
+
+    Display *probe = open_display_retry(display, 10000);
+    if (!probe) die("cannot connect to X server");
+    int ev, er, maj, min;
+    if (!XTestQueryExtension(probe, &ev, &er, &maj, &min)) die("XTest extension missing");
+    XCloseDisplay(probe);
+
+    printf("%-16s %7s %9s %9s %9s %10s %8s\n",
+           "scenario", "samples", "p50 us", "p99 us", "max us", "req/frame", "timeouts");
+    if (access(fm, X_OK) == 0) file_manager(display, fm, rows);
+    else fprintf(stderr, "skip file manager: %s not built\n", fm);
+    if (access(weather_app, X_OK) == 0) weather(display, weather_app);
+    else fprintf(stderr, "skip weather: %s not built\n", weather_app);
+
+    if (xvfb > 0) {
+        kill(xvfb, SIGTERM);
+        waitpid(xvfb, NULL, 0);
+    }
+    return 0;
+}
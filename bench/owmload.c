@@ -0,0 +1,217 @@
+// owmload.c
+// Нагрузка на заглушку API (bench/owmserver) тем же путем, что у окна:
+// fetch.h (пул соединений, конвейер, сроки фаз) и потоковый разбор json.h
+// прямо из буфера чтения. --parallel запросов идут одновременно по кругу
+// путей (погода по имени и id, прогноз, /group, иконка), каждый ответ
+// проверяется: статус 200, JSON разобран целиком и cod = 200 (у иконки -
+// подпись PNG). Итог - запросы в секунду, перцентили полного времени
+// запроса и отчет fetch_report. С --expect PCT код выхода 1, если
+// удачных ответов меньше PCT процентов - для регрессионных прогонов с
+// помехами заглушки. --wait MS - ждать, пока сервер начнет принимать
+// соединения (заглушка запущена в фоне тем же скриптом), не дольше MS.
+//
+// Компиляция: cc -O2 bench/owmload.c -o bench/owmload
+// Запуск: bench/owmserver & bench/owmload [--server 127.0.0.1:8080]
+//         [--requests 1000] [--parallel 4] [--expect 100] [--wait 5000] [путь ...]
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../fetch.h"
+#include "../json.h"
+
+#define LOAD_MAX_PARALLEL 16
+#define LOAD_MAX_PATHS    16
+
+typedef struct {
+    int cod;
+} LoadReply;
+
+static const JsonField load_fields[] = {
+    JSON_FIELD("cod", JSON_F_INT, LoadReply, cod),
+};
+
+typedef struct {
+    Fetch fetch;
+    JsonParser json;
+    LoadReply reply;
+    int json_body;          // путь отдает JSON (иначе - PNG)
+} LoadSlot;
+
+static const char *default_paths[] = {
+    "/data/2.5/weather?q=Ryazan&appid=bench",
+    "/data/2.5/weather?id=524901&appid=bench",
+    "/data/2.5/forecast?id=500096&appid=bench",
+    "/data/2.5/group?id=500096,524901&appid=bench",
+    "/img/wn/04d@2x.png",
+};
+
+static struct {
+    char host[64];
+    int port;
+    const char *paths[LOAD_MAX_PATHS];
+    int npaths;
+    long requests, started, done;
+    double *ms;             // полное время каждого запроса
+
+    long ok, http_errors, bad_body, failed, timeouts;
+    long bytes;
+} load;
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void slot_finish(LoadSlot *s);
+
+static int slot_start(LoadSlot *s, const char *path) {
+    s->json_body = strncmp(path, "/img/", 5) != 0;
+    if (s->json_body) {
+        memset(&s->reply, 0, sizeof(s->reply));
+        json_init(&s->json, load_fields, 1, &s->reply);
+        fetch_set_sink(&s->fetch, json_sink, &s->json);
+    } else {
+        fetch_set_sink(&s->fetch, NULL, NULL);
+    }
+    return fetch_start(&s->fetch, load.host, load.port, path);
+}
+
+// Следующий запрос в слот; не начавшийся (ошибка сразу) засчитывается тут же
+static void slot_next(LoadSlot *s) {
+    while (load.started < load.requests) {
+        const char *path = load.paths[load.started++ % load.npaths];
+        if (slot_start(s, path)) return;
+        slot_finish(s);
+    }
+}
+
+// Ответ завершился: в какую графу итога он попал
+static void slot_finish(LoadSlot *s) {
+    Fetch *f = &s->fetch;
+    load.bytes += f->received;
+    if (f->state != FETCH_DONE) {
+        load.failed++;
+        if (f->timed_out) load.timeouts++;
+    } else if (f->status != 200) {
+        load.http_errors++;
+    } else if (s->json_body ? !json_finish(&s->json) || ((s->json.found & 1) && s->reply.cod != 200) :
+               f->body_len < 8 || memcmp(f->body, "\x89PNG", 4) != 0) {
+        load.bad_body++;
+    } else {
+        load.ok++;
+    }
+    load.ms[load.done++] = fetch_now_ms() - f->t_start;
+}
+
+// Сервер принимает соединения? Пробное соединение раз в 20 мс до срока
+static int wait_for_server(const char *host, int port, double wait_ms) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, service, &hints, &ai) != 0) return 0;
+
+    double deadline = fetch_now_ms() + wait_ms;
+    int up = 0;
+    while (!up) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        up = fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+        if (fd >= 0) close(fd);
+        if (up || fetch_now_ms() >= deadline) break;
+        usleep(20000);
+    }
+    freeaddrinfo(ai);
+    return up;
+}
+
+int main(int argc, char **argv) {
+    const char *server = "127.0.0.1:8080";
+    int parallel = 4;
+    double expect = -1, wait_ms = 0;
+    load.requests = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) server = argv[++i];
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) load.requests = atol(argv[++i]);
+        else if (strcmp(argv[i], "--parallel") == 0 && i + 1 < argc) parallel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) expect = atof(argv[++i]);
+        else if (strcmp(argv[i], "--wait") == 0 && i + 1 < argc) wait_ms = atof(argv[++i]);
+        else if (load.npaths < LOAD_MAX_PATHS) load.paths[load.npaths++] = argv[i];
+    }
+    if (load.npaths == 0) {
+        load.npaths = sizeof(default_paths) / sizeof(default_paths[0]);
+        memcpy(load.paths, default_paths, sizeof(default_paths));
+    }
+    if (parallel < 1) parallel = 1;
+    if (parallel > LOAD_MAX_PARALLEL) parallel = LOAD_MAX_PARALLEL;
+    long requests = load.requests;
+    load.ms = requests > 0 ? malloc(sizeof(double) * requests) : NULL;
+    if (!load.ms) return 1;
+
+    snprintf(load.host, sizeof(load.host), "%s", server);
+    char *colon = strrchr(load.host, ':');
+    load.port = colon && atoi(colon + 1) > 0 ? atoi(colon + 1) : 80;
+    if (colon) *colon = '\0';
+    if (wait_ms > 0 && !wait_for_server(load.host, load.port, wait_ms)) {
+        fprintf(stderr, "owmload: %s:%d not accepting connections after %.0f ms\n",
+                load.host, load.port, wait_ms);
+        return 1;
+    }
+
+    static LoadSlot slots[LOAD_MAX_PARALLEL];
+    double t0 = fetch_now_ms();
+    for (int i = 0; i < parallel; i++) {
+        fetch_init(&slots[i].fetch);
+        slot_next(&slots[i]);
+    }
+
+    while (load.done < requests) {
+        struct pollfd fds[LOAD_MAX_PARALLEL];
+        int timeout = -1;
+        for (int i = 0; i < parallel; i++) {
+            Fetch *f = &slots[i].fetch;
+            fds[i].fd = fetch_active(f) ? fetch_fd(f) : -1;
+            fds[i].events = fds[i].fd >= 0 ? fetch_events(f) : 0;
+            fds[i].revents = 0;
+            int t = fetch_timeout_ms(f);
+            if (t >= 0 && (timeout < 0 || t < timeout)) timeout = t;
+        }
+        if (poll(fds, parallel, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            return 1;
+        }
+        for (int i = 0; i < parallel; i++) {
+            LoadSlot *s = &slots[i];
+            if (!fetch_active(&s->fetch)) continue;
+            if (!fetch_step(&s->fetch, fds[i].revents) && !fetch_check_deadline(&s->fetch)) continue;
+            slot_finish(s);
+            slot_next(s);
+        }
+    }
+    double elapsed = (fetch_now_ms() - t0) / 1e3;
+
+    double *ms = load.ms;
+    qsort(ms, requests, sizeof(double), cmp_double);
+    printf("owmload: %ld requests to %s:%d, %d parallel, %.2f s: %.0f req/s, %.1f MB/s\n",
+           requests, load.host, load.port, parallel, elapsed, requests / elapsed, load.bytes / elapsed / 1e6);
+    printf("  ok %ld, http errors %ld, bad body %ld, failed %ld (%ld timeouts)\n",
+           load.ok, load.http_errors, load.bad_body, load.failed, load.timeouts);
+    printf("  request ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           ms[requests / 2], ms[requests * 9 / 10], ms[requests * 99 / 100], ms[requests - 1]);
+    fetch_report(stdout);
+
+    for (int i = 0; i < parallel; i++) fetch_free(&slots[i].fetch);
+    free(ms);
+    double ok_pct = 100.0 * load.ok / requests;
+    if (expect >= 0 && ok_pct < expect) {
+        printf("owmload: %.1f%% ok, expected at least %.1f%%\n", ok_pct, expect);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,738 @@
+// owmserver.c
+// Заглушка OpenWeatherMap: локальный HTTP/1.1 сервер, который отдает
+// записанные ответы bench/responses/*.json и иконки bench/icons/*.png.
+// Путь fetch.h -> json.h -> отрисовка так можно мерить и проверять без
+// сети и без живого API. Клиент направляется на заглушку переменной
+// WEATHER_API=127.0.0.1:8080 (weather, new_icon, bench/owmload).
+//
+// Маршруты:
+//   /data/2.5/weather?q=имя|id=N   weather_*.json по имени или id города
+//   /data/2.5/forecast?q=|id=      forecast_*.json
+//   /data/2.5/group?id=a,b,...     {"cnt":n,"list":[...]} из ответов weather
+//   /img/wn/КОД[@2x].png           icons/КОД.png
+// Неизвестный город - 404 из weather_404.json, как у API; с --synth -
+// сочиненный ответ (стабильный: погода от хэша имени или id), чтобы
+// панель на десятки городов было чем нагрузить. Без appid - 401.
+// У каждого тела ETag, If-None-Match с ним - 304; --max-age добавляет
+// Cache-Control.
+//
+// Помехи - у каждого ответа свои, из генератора с --seed, так что прогон
+// с теми же флагами повторяется:
+//   --latency MS --jitter MS   задержка до первого байта, MS +- jitter
+//   --chunk N                  тело chunked кусками по N байт
+//   --partial N --gap MS       запись не больше N байт, пауза между записями
+//   --slowloris MS             ответ по байту раз в MS (держит соединение)
+//   --errors PCT               503/500/502 вместо ответа
+//   --drop PCT                 обрыв соединения посреди тела
+//   --stall PCT                ответа нет вовсе (срок первого байта клиента)
+//   --close                    Connection: close после каждого ответа
+// Запросы конвейера отвечаются по порядку. Итог печатается по SIGINT /
+// SIGTERM или после --requests N ответов.
+//
+// Компиляция: cc -O2 bench/owmserver.c -o bench/owmserver
+// Запуск из корня репозитория: bench/owmserver [--port 8080] [--dir bench] [помехи]
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../json.h"
+
+#define OWM_MAX_REPLIES 64
+#define OWM_MAX_CONNS   64
+#define OWM_IN_MAX      8192        // заголовки запроса (и конвейер за ними)
+#define OWM_GROUP_MAX   20          // городов в /group, как у API
+
+typedef struct {
+    char name[64];                  // город из ответа или код иконки
+    char lang[4];                   // weather_<город>_<lang>.json, "" - по умолчанию
+    int id;
+    char *body;
+    long len;
+    unsigned etag;
+} Reply;
+
+typedef struct {
+    int fd;
+    char in[OWM_IN_MAX];
+    int in_len;
+    char *out;                      // текущий ответ целиком
+    long out_len, out_sent, out_cap;
+    long drop_at;                   // отправив столько, закрыть (-1 - нет)
+    double send_at;                 // раньше не писать
+    int step;                       // байт за запись, 0 - сколько примет сокет
+    double gap_ms;                  // пауза после каждой записи
+    int busy;                       // ответ в работе
+    int stalled;                    // ответа не будет
+    int close_after;
+} Conn;
+
+static struct {
+    const char *dir;
+    int port;
+    double latency, jitter, gap, slowloris;
+    int chunk, partial;
+    int errors, drop, stall;        // проценты
+    int close, synth, max_age;
+    long max_requests;
+    unsigned long long seed;
+} opt = { .dir = "bench", .port = 8080, .seed = 1 };
+
+static Reply weather[OWM_MAX_REPLIES], forecast[OWM_MAX_REPLIES], icons[OWM_MAX_REPLIES];
+static int nweather, nforecast, nicons;
+static Reply not_found;
+static Conn conns[OWM_MAX_CONNS];
+static volatile sig_atomic_t stop;
+
+static struct {
+    unsigned long connections, requests, bytes;
+    unsigned long status[6];        // по сотням: 2xx, 3xx, 4xx, 5xx
+    unsigned long replayed, synthesized, not_modified;
+    unsigned long errors, drops, stalls, slow, pipelined;
+} stats;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Свой генератор (xorshift): прогон зависит только от --seed
+static double rnd(void) {
+    opt.seed ^= opt.seed << 13;
+    opt.seed ^= opt.seed >> 7;
+    opt.seed ^= opt.seed << 17;
+    return (opt.seed >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int chance(int pct) {
+    return pct > 0 && rnd() * 100 < pct;
+}
+
+static unsigned fnv1a(const char *s, long len) {
+    unsigned h = 2166136261u;
+    for (long i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static char *read_file(const char *path, long *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    if (data && fread(data, 1, *len, f) != (size_t)*len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// ---------- записанные ответы ----------
+
+typedef struct {
+    int cod;
+    int id;
+    char name[64];
+} ReplyInfo;
+
+static const JsonField weather_info[] = {
+    JSON_FIELD("cod",  JSON_F_INT,  ReplyInfo, cod),
+    JSON_FIELD("id",   JSON_F_INT,  ReplyInfo, id),
+    JSON_FIELD("name", JSON_F_TEXT, ReplyInfo, name),
+};
+
+static const JsonField forecast_info[] = {
+    JSON_FIELD("cod",       JSON_F_INT,  ReplyInfo, cod),
+    JSON_FIELD("city.id",   JSON_F_INT,  ReplyInfo, id),
+    JSON_FIELD("city.name", JSON_F_TEXT, ReplyInfo, name),
+};
+
+static void load_reply(Reply *r, const char *path, const JsonField *fields, int nfields, ReplyInfo *info) {
+    memset(r, 0, sizeof(*r));
+    r->body = read_file(path, &r->len);
+    if (!r->body) return;
+    r->etag = fnv1a(r->body, r->len);
+    if (fields) {
+        JsonParser p;
+        memset(info, 0, sizeof(*info));
+        json_init(&p, fields, nfields, info);
+        if (!json_parse(&p, r->body, r->len)) fprintf(stderr, "%s: %s\n", path, p.error);
+        r->id = info->id;
+        snprintf(r->name, sizeof(r->name), "%s", info->name);
+    }
+}
+
+static void load_replies(void) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/responses", opt.dir);
+    DIR *d = opendir(path);
+    struct dirent *e;
+    while (d && (e = readdir(d)) != NULL) {
+        int len = strlen(e->d_name);
+        if (len < 6 || strcmp(e->d_name + len - 5, ".json") != 0) continue;
+        snprintf(path, sizeof(path), "%s/responses/%s", opt.dir, e->d_name);
+        ReplyInfo info;
+        Reply r;
+        const char *suffix = strrchr(e->d_name, '_');
+        int lang = suffix && suffix != strchr(e->d_name, '_') && len - (suffix - e->d_name) == 8;
+        if (strncmp(e->d_name, "weather_", 8) == 0) {
+            load_reply(&r, path, weather_info, 3, &info);
+            if (!r.body) continue;
+            if (lang) snprintf(r.lang, sizeof(r.lang), "%.2s", suffix + 1);
+            if (info.cod != 200 && !not_found.body) not_found = r;
+            else if (info.cod == 200 && nweather < OWM_MAX_REPLIES) weather[nweather++] = r;
+            else free(r.body);
+        } else if (strncmp(e->d_name, "forecast_", 9) == 0 && nforecast < OWM_MAX_REPLIES) {
+            load_reply(&r, path, forecast_info, 3, &info);
+            if (r.body) forecast[nforecast++] = r;
+        }
+    }
+    if (d) closedir(d);
+
+    snprintf(path, sizeof(path), "%s/icons", opt.dir);
+    d = opendir(path);
+    while (d && (e = readdir(d)) != NULL && nicons < OWM_MAX_REPLIES) {
+        int len = strlen(e->d_name);
+        if (len < 5 || strcmp(e->d_name + len - 4, ".png") != 0) continue;
+        snprintf(path, sizeof(path), "%s/icons/%s", opt.dir, e->d_name);
+        Reply *r = &icons[nicons];
+        load_reply(r, path, NULL, 0, NULL);
+        if (!r->body) continue;
+        snprintf(r->name, sizeof(r->name), "%.*s", len - 4, e->d_name);
+        nicons++;
+    }
+    if (d) closedir(d);
+
+    if (!not_found.body) {
+        static char text[] = "{\"cod\":\"404\",\"message\":\"city not found\"}";
+        not_found.body = text;
+        not_found.len = strlen(text);
+    }
+}
+
+// Город по id или имени (без учета регистра), лучше на языке lang;
+// NULL - нет такого
+static Reply *find_reply(Reply *list, int n, int id, const char *name, const char *lang) {
+    Reply *any = NULL;
+    for (int i = 0; i < n; i++) {
+        if (id ? list[i].id != id : strcasecmp(list[i].name, name) != 0) continue;
+        if (strcmp(list[i].lang, lang) == 0) return &list[i];
+        if (!any) any = &list[i];
+    }
+    return any;
+}
+
+// Сочиненный ответ /weather для города, которого нет в записях
+static long synth_weather(char *out, long size, int id, const char *name) {
+    char city[64];
+    unsigned h = id ? (unsigned)id * 2654435761u : fnv1a(name, strlen(name));
+    if (!id) id = 9000000 + h % 1000000;
+    if (name[0]) snprintf(city, sizeof(city), "%s", name);
+    else snprintf(city, sizeof(city), "City %d", id);
+    for (char *c = city; *c; c++) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) *c = '_';  // имя идет в JSON как есть
+    }
+    static const char *sky[][2] = {
+        { "clear sky", "01d" }, { "few clouds", "02d" }, { "broken clouds", "04d" }, { "light rain", "10d" },
+    };
+    double temp = 258 + h % 40 + (h >> 8) % 100 / 100.0;
+    return snprintf(out, size,
+                    "{\"coord\":{\"lon\":0,\"lat\":0},\"weather\":[{\"id\":800,\"main\":\"Clouds\","
+                    "\"description\":\"%s\",\"icon\":\"%s\"}],\"base\":\"stations\",\"main\":{\"temp\":%.2f,"
+                    "\"feels_like\":%.2f,\"pressure\":1012,\"humidity\":%u},\"dt\":%ld,"
+                    "\"sys\":{\"country\":\"XX\"},\"id\":%d,\"name\":\"%s\",\"cod\":200}",
+                    sky[h % 4][0], sky[h % 4][1], temp, temp - 2.5, 40 + (h >> 4) % 60,
+                    (long)time(NULL), id, city);
+}
+
+// ---------- запросы ----------
+
+// Значение параметра key запроса (с раскодированием %XX и '+')
+static int query_param(const char *query, const char *key, char *out, int size) {
+    int klen = strlen(key);
+    for (const char *s = query; s && *s; s = strchr(s, '&'), s = s ? s + 1 : NULL) {
+        if (strncmp(s, key, klen) != 0 || s[klen] != '=') continue;
+        int n = 0;
+        for (s += klen + 1; *s && *s != '&' && n < size - 1; s++) {
+            if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+                char hex[3] = { s[1], s[2], 0 };
+                out[n++] = (char)strtol(hex, NULL, 16);
+                s += 2;
+            } else {
+                out[n++] = *s == '+' ? ' ' : *s;
+            }
+        }
+        out[n] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int status;
+    const char *type;
+    const char *body;
+    long len;
+    unsigned etag;                  // 0 - без ETag
+    char *own;                      // тело, собранное под запрос (free)
+} Response;
+
+static void respond_text(Response *res, int status, const char *text) {
+    res->status = status;
+    res->type = "application/json; charset=utf-8";
+    res->own = strdup(text);
+    res->body = res->own;
+    res->len = strlen(text);
+}
+
+static void respond_reply(Response *res, const Reply *r, const char *type) {
+    res->status = 200;
+    res->type = type;
+    res->body = r->body;
+    res->len = r->len;
+    res->etag = r->etag;
+    stats.replayed++;
+}
+
+static void route(const char *path, Response *res) {
+    char target[1024];
+    snprintf(target, sizeof(target), "%s", path);
+    char *query = strchr(target, '?');
+    if (query) *query++ = '\0';
+    char q[128] = "", ids[512] = "", lang[4] = "", appid[64];
+    int id = 0;
+    if (query) {
+        query_param(query, "q", q, sizeof(q));
+        query_param(query, "lang", lang, sizeof(lang));
+        if (query_param(query, "id", ids, sizeof(ids))) id = atoi(ids);
+    }
+
+    if (strncmp(target, "/img/wn/", 8) == 0) {
+        char code[64];
+        snprintf(code, sizeof(code), "%.63s", target + 8);
+        char *end = strstr(code, "@2x");
+        if (!end) end = strstr(code, ".png");
+        if (end) *end = '\0';
+        Reply *r = find_reply(icons, nicons, 0, code, "");
+        if (r) respond_reply(res, r, "image/png");
+        else respond_text(res, 404, "{\"cod\":\"404\",\"message\":\"icon not found\"}");
+        return;
+    }
+    if (strncmp(target, "/data/2.5/", 10) != 0) {
+        respond_text(res, 404, "{\"cod\":\"404\",\"message\":\"Internal error\"}");
+        return;
+    }
+    if (!query || !query_param(query, "appid", appid, sizeof(appid))) {
+        respond_text(res, 401, "{\"cod\":401,\"message\":\"Invalid API key. Please see "
+                               "https://openweathermap.org/faq#error401 for more info.\"}");
+        return;
+    }
+
+    const char *api = target + 10;
+    if (strcmp(api, "weather") == 0 || strcmp(api, "forecast") == 0) {
+        int is_weather = api[0] == 'w';
+        Reply *r = is_weather ? find_reply(weather, nweather, id, q, lang) :
+                                find_reply(forecast, nforecast, id, q, lang);
+        if (!r && !is_weather && opt.synth && nforecast > 0) r = &forecast[0];
+        if (r) {
+            respond_reply(res, r, "application/json; charset=utf-8");
+        } else if (is_weather && opt.synth && (id || q[0])) {
+            char text[1024];
+            synth_weather(text, sizeof(text), id, q);
+            respond_text(res, 200, text);
+            stats.synthesized++;
+        } else {
+            res->status = 404;
+            res->type = "application/json; charset=utf-8";
+            res->body = not_found.body;
+            res->len = not_found.len;
+        }
+        return;
+    }
+    if (strcmp(api, "group") == 0) {
+        // Как у API: неизвестные id в list не попадают, больше 20 - ошибка
+        int count = 0, n = 0;
+        long cap = 64, len;
+        const char *s;
+        for (s = ids; *s; s += strcspn(s, ",") + (s[strcspn(s, ",")] == ',')) {
+            Reply *r = find_reply(weather, nweather, atoi(s), "", lang);
+            cap += (r ? r->len : 1024) + 1;
+            count++;
+        }
+        if (count > OWM_GROUP_MAX) {
+            respond_text(res, 400, "{\"cod\":\"400\",\"message\":\"Maximum 20 cities per request\"}");
+            return;
+        }
+        char *out = malloc(cap);
+        if (!out) {
+            respond_text(res, 500, "{\"cod\":500,\"message\":\"Internal error\"}");
+            return;
+        }
+        // Список собирается за местом под заголовок, число городов - потом
+        len = 32;
+        for (s = ids; *s; s += strcspn(s, ",") + (s[strcspn(s, ",")] == ',')) {
+            Reply *r = find_reply(weather, nweather, atoi(s), "", lang);
+            if (!r && !(opt.synth && atoi(s) > 0)) continue;
+            if (n++) out[len++] = ',';
+            if (r) {
+                memcpy(out + len, r->body, r->len);
+                len += r->len;
+                stats.replayed++;
+            } else {
+                len += synth_weather(out + len, 1024, atoi(s), "");
+                stats.synthesized++;
+            }
+        }
+        len += sprintf(out + len, "]}");
+        char head[32];
+        int hlen = sprintf(head, "{\"cnt\":%d,\"list\":[", n);
+        memcpy(out + 32 - hlen, head, hlen);
+        res->status = 200;
+        res->type = "application/json; charset=utf-8";
+        res->own = out;
+        res->body = out + 32 - hlen;
+        res->len = len - (32 - hlen);
+        return;
+    }
+    respond_text(res, 404, "{\"cod\":\"404\",\"message\":\"Internal error\"}");
+}
+
+// ---------- соединения ----------
+
+static void conn_close(Conn *c) {
+    close(c->fd);
+    free(c->out);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static int out_append(Conn *c, const char *s, long n) {
+    if (c->out_len + n > c->out_cap) {
+        long cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + n) cap *= 2;
+        char *out = realloc(c->out, cap);
+        if (!out) return 0;
+        c->out = out;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, s, n);
+    c->out_len += n;
+    return 1;
+}
+
+static const char *reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        default:  return "Service Unavailable";
+    }
+}
+
+// Ответ на запрос из головы head (без пустой строки) - в c->out, с помехами
+static void conn_request(Conn *c, char *head) {
+    char method[8], path[1024];
+    double now = now_ms();
+    stats.requests++;
+    c->out_len = c->out_sent = 0;
+    c->drop_at = -1;
+    c->step = 0;
+    c->gap_ms = 0;
+    c->busy = 1;
+    c->stalled = 0;
+    c->close_after = opt.close;
+
+    char etag_in[32] = "";
+    for (char *line = strstr(head, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "If-None-Match:", 14) == 0) {
+            sscanf(line + 16, " %31[^\r]", etag_in);
+        } else if (strncasecmp(line + 2, "Connection:", 11) == 0 &&
+                   strncasecmp(line + 13 + strspn(line + 13, " "), "close", 5) == 0) {
+            c->close_after = 1;
+        }
+    }
+
+    Response res;
+    memset(&res, 0, sizeof(res));
+    if (sscanf(head, "%7s %1023s", method, path) != 2) {
+        respond_text(&res, 400, "{\"cod\":\"400\",\"message\":\"bad request\"}");
+        c->close_after = 1;
+    } else if (strcmp(method, "GET") != 0) {
+        respond_text(&res, 405, "{\"cod\":\"405\",\"message\":\"GET only\"}");
+    } else if (chance(opt.stall)) {
+        // Запрос прочитан, ответа не будет: клиент ждет до своего срока
+        stats.stalls++;
+        c->stalled = 1;
+        return;
+    } else if (chance(opt.errors)) {
+        static const int codes[] = { 503, 500, 502 };
+        res.status = codes[(int)(rnd() * 3)];
+        respond_text(&res, res.status, "{\"cod\":503,\"message\":\"Service temporarily unavailable (owmserver)\"}");
+        stats.errors++;
+    } else {
+        route(path, &res);
+    }
+
+    char etag[16] = "";
+    if (res.etag) snprintf(etag, sizeof(etag), "\"%08x\"", res.etag);
+    if (res.status == 200 && etag[0] && strcmp(etag, etag_in) == 0) {
+        res.status = 304;
+        stats.not_modified++;
+    }
+    stats.status[res.status / 100 < 6 ? res.status / 100 : 5]++;
+
+    char h[512];
+    int hl = snprintf(h, sizeof(h), "HTTP/1.1 %d %s\r\nServer: owmserver\r\n", res.status, reason(res.status));
+    if (res.status != 304) {
+        hl += snprintf(h + hl, sizeof(h) - hl, "Content-Type: %s\r\n", res.type);
+        if (opt.chunk > 0) hl += snprintf(h + hl, sizeof(h) - hl, "Transfer-Encoding: chunked\r\n");
+        else hl += snprintf(h + hl, sizeof(h) - hl, "Content-Length: %ld\r\n", res.len);
+    }
+    if (etag[0] && res.status / 100 != 4) hl += snprintf(h + hl, sizeof(h) - hl, "ETag: %s\r\n", etag);
+    if (opt.max_age > 0 && (res.status == 200 || res.status == 304)) {
+        hl += snprintf(h + hl, sizeof(h) - hl, "Cache-Control: max-age=%d\r\n", opt.max_age);
+    }
+    hl += snprintf(h + hl, sizeof(h) - hl, "Connection: %s\r\n\r\n", c->close_after ? "close" : "keep-alive");
+    int ok = out_append(c, h, hl);
+
+    if (res.status != 304 && opt.chunk > 0) {
+        for (long off = 0; ok && off < res.len; off += opt.chunk) {
+            long n = res.len - off < opt.chunk ? res.len - off : opt.chunk;
+            char size[16];
+            ok = out_append(c, size, sprintf(size, "%lx\r\n", n)) &&
+                 out_append(c, res.body + off, n) && out_append(c, "\r\n", 2);
+        }
+        if (ok) ok = out_append(c, "0\r\n\r\n", 5);
+    } else if (res.status != 304) {
+        ok = out_append(c, res.body, res.len);
+    }
+    free(res.own);
+    if (!ok) c->close_after = 1;
+
+    if (res.status != 304 && res.len > 1 && chance(opt.drop)) {
+        c->drop_at = hl + (c->out_len - hl) / 2;
+        stats.drops++;
+    }
+    double delay = opt.latency + opt.jitter * (2 * rnd() - 1);
+    c->send_at = now + (delay > 0 ? delay : 0);
+    if (opt.slowloris > 0) {
+        c->step = 1;
+        c->gap_ms = opt.slowloris;
+        stats.slow++;
+    } else if (opt.partial > 0) {
+        c->step = opt.partial;
+        c->gap_ms = opt.gap;
+    }
+}
+
+// Длина головы первого запроса во входном буфере (с пустой строкой), 0 - не пришла
+static int conn_head(const Conn *c) {
+    for (int i = 3; i < c->in_len; i++) {
+        if (c->in[i] == '\n' && c->in[i - 1] == '\r' && c->in[i - 2] == '\n' && c->in[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Следующий запрос из входного буфера, если ответ на прежний ушел
+static void conn_next(Conn *c) {
+    if (c->busy || c->fd < 0) return;
+    int used = conn_head(c);
+    if (!used) {
+        if (c->in_len == OWM_IN_MAX) conn_close(c);     // голова не влезла
+        return;
+    }
+    char head[OWM_IN_MAX + 1];
+    memcpy(head, c->in, used - 2);
+    head[used - 2] = '\0';
+    memmove(c->in, c->in + used, c->in_len - used);
+    c->in_len -= used;
+    conn_request(c, head);
+}
+
+// Запись очередного куска ответа, если подошел срок
+static void conn_write(Conn *c, double now) {
+    if (!c->busy || c->stalled || now < c->send_at) return;
+    long left = c->out_len - c->out_sent;
+    if (c->drop_at >= 0 && c->drop_at - c->out_sent < left) left = c->drop_at - c->out_sent;
+    if (c->step > 0 && c->step < left) left = c->step;
+    ssize_t n = left > 0 ? write(c->fd, c->out + c->out_sent, left) : 0;
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) conn_close(c);
+        return;
+    }
+    c->out_sent += n;
+    stats.bytes += n;
+    if (c->gap_ms > 0) c->send_at = now + c->gap_ms;
+
+    if (c->drop_at >= 0 && c->out_sent >= c->drop_at) {
+        conn_close(c);
+    } else if (c->out_sent == c->out_len) {
+        c->busy = 0;
+        if (c->close_after) conn_close(c);
+        else if (opt.max_requests && (long)stats.requests >= opt.max_requests) stop = 1;
+        else {
+            // Следующий запрос уже ждал в буфере - клиент шлет конвейером
+            if (conn_head(c)) stats.pipelined++;
+            conn_next(c);
+        }
+    }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void report(void) {
+    fprintf(stderr, "owmserver: %lu requests on %lu connections (%lu pipelined), %lu bytes; "
+            "2xx %lu, 304 %lu, 4xx %lu, 5xx %lu; replayed %lu, synthesized %lu; "
+            "injected: %lu errors, %lu drops, %lu stalls, %lu slow\n",
+            stats.requests, stats.connections, stats.pipelined, stats.bytes,
+            stats.status[2], stats.not_modified, stats.status[4], stats.status[5],
+            stats.replayed, stats.synthesized, stats.errors, stats.drops, stats.stalls, stats.slow);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--close") == 0) opt.close = 1;
+        else if (strcmp(a, "--synth") == 0) opt.synth = 1;
+        else if (!v) {
+            fprintf(stderr, "%s: value expected\n", a);
+            return 1;
+        }
+        else if (strcmp(a, "--port") == 0) opt.port = atoi(argv[++i]);
+        else if (strcmp(a, "--dir") == 0) opt.dir = argv[++i];
+        else if (strcmp(a, "--latency") == 0) opt.latency = atof(argv[++i]);
+        else if (strcmp(a, "--jitter") == 0) opt.jitter = atof(argv[++i]);
+        else if (strcmp(a, "--chunk") == 0) opt.chunk = atoi(argv[++i]);
+        else if (strcmp(a, "--partial") == 0) opt.partial = atoi(argv[++i]);
+        else if (strcmp(a, "--gap") == 0) opt.gap = atof(argv[++i]);
+        else if (strcmp(a, "--slowloris") == 0) opt.slowloris = atof(argv[++i]);
+        else if (strcmp(a, "--errors") == 0) opt.errors = atoi(argv[++i]);
+        else if (strcmp(a, "--drop") == 0) opt.drop = atoi(argv[++i]);
+        else if (strcmp(a, "--stall") == 0) opt.stall = atoi(argv[++i]);
+        else if (strcmp(a, "--max-age") == 0) opt.max_age = atoi(argv[++i]);
+        else if (strcmp(a, "--requests") == 0) opt.max_requests = atol(argv[++i]);
+        else if (strcmp(a, "--seed") == 0) opt.seed = strtoull(argv[++i], NULL, 10) | 1;
+        else {
+            fprintf(stderr, "%s: unknown option\n", a);
+            return 1;
+        }
+    }
+
+    load_replies();
+    if (nweather == 0) fprintf(stderr, "%s/responses: no weather_*.json\n", opt.dir);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 64) < 0) {
+        perror("owmserver");
+        return 1;
+    }
+    fcntl(lfd, F_SETFL, O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    for (int i = 0; i < OWM_MAX_CONNS; i++) conns[i].fd = -1;
+
+    fprintf(stderr, "owmserver: 127.0.0.1:%d, %d weather, %d forecast, %d icons "
+            "(WEATHER_API=127.0.0.1:%d)\n", opt.port, nweather, nforecast, nicons, opt.port);
+
+    while (!stop) {
+        struct pollfd fds[1 + OWM_MAX_CONNS];
+        int index[OWM_MAX_CONNS];
+        int nfds = 1, timeout = -1;
+        double now = now_ms();
+        fds[0].fd = lfd;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < OWM_MAX_CONNS; i++) {
+            Conn *c = &conns[i];
+            if (c->fd < 0) continue;
+            short events = c->in_len < OWM_IN_MAX ? POLLIN : 0;
+            if (c->busy && !c->stalled) {
+                if (now >= c->send_at) {
+                    events |= POLLOUT;
+                } else {
+                    int left = (int)(c->send_at - now) + 1;
+                    if (timeout < 0 || left < timeout) timeout = left;
+                }
+            }
+            fds[nfds].fd = c->fd;
+            fds[nfds].events = events;
+            index[nfds - 1] = i;
+            nfds++;
+        }
+        if (poll(fds, nfds, timeout) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(lfd, NULL, NULL)) >= 0) {
+                int i = 0;
+                while (i < OWM_MAX_CONNS && conns[i].fd >= 0) i++;
+                if (i == OWM_MAX_CONNS) {
+                    close(fd);
+                    continue;
+                }
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                memset(&conns[i], 0, sizeof(conns[i]));
+                conns[i].fd = fd;
+                stats.connections++;
+            }
+        }
+
+        now = now_ms();
+        for (int k = 1; k < nfds; k++) {
+            Conn *c = &conns[index[k - 1]];
+            if (c->fd != fds[k].fd) continue;
+            if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n = read(c->fd, c->in + c->in_len, OWM_IN_MAX - c->in_len);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                    conn_close(c);
+                    continue;
+                }
+                if (n > 0) c->in_len += n;
+                conn_next(c);
+            }
+            if (c->fd >= 0) conn_write(c, now);
+        }
+    }
+
+    report();
+    for (int i = 0; i < OWM_MAX_CONNS; i++) {
+        if (conns[i].fd >= 0) conn_close(&conns[i]);
+    }
+    close(lfd);
+    return 0;
+}
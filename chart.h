@@ -0,0 +1,92 @@
+#ifndef CHART_H
+#define CHART_H
+
+// Серии графиков -> точки экрана.
+// Серия - два столбца float одной длины: время и значение (как лежат в
+// Forecast). chart_points() переводит их в XPoint в рамке графика, и
+// серия рисуется одним r_polyline (XDrawLines), площадь под ней -
+// одним r_polygon (XFillPolygon).
+// Точек может быть больше, чем пикселей по ширине (узкое окно, длинная
+// история): тогда из точек, попавших в один столбец пикселей, остаются
+// первая, минимальная, максимальная и последняя в порядке следования.
+// Линия выглядит так же, как по всем точкам (пики и провалы не теряются),
+// а точек не больше 4 на столбец - объем запроса к X серверу зависит от
+// ширины графика, а не от длины серии.
+
+#include <X11/Xlib.h>
+
+typedef struct {
+    int x, y, w, h;         // рамка в пикселях
+    float t0, t1;           // время по горизонтали
+    float v0, v1;           // значения по вертикали (v0 - низ)
+} ChartFrame;
+
+// Минимум и максимум серии; пустая - 0..1
+static void chart_range(const float *v, int n, float *lo, float *hi) {
+    *lo = 0;
+    *hi = 1;
+    if (n <= 0) return;
+    *lo = *hi = v[0];
+    for (int i = 1; i < n; i++) {
+        if (v[i] < *lo) *lo = v[i];
+        if (v[i] > *hi) *hi = v[i];
+    }
+}
+
+static int chart_x(const ChartFrame *f, float t) {
+    float span = f->t1 > f->t0 ? f->t1 - f->t0 : 1;
+    return f->x + (int)((t - f->t0) / span * (f->w - 1) + 0.5f);
+}
+
+static int chart_y(const ChartFrame *f, float v) {
+    float span = f->v1 > f->v0 ? f->v1 - f->v0 : 1;
+    float k = (v - f->v0) / span;
+    if (k < 0) k = 0;
+    if (k > 1) k = 1;
+    return f->y + f->h - 1 - (int)(k * (f->h - 1) + 0.5f);
+}
+
+// Точки серии с прореживанием по столбцам; max_out >= 4 * f->w хватает
+// всегда. Возвращает число точек в out
+static int chart_points(const ChartFrame *f, const float *t, const float *v, int n,
+                        XPoint *out, int max_out) {
+    float span = f->t1 > f->t0 ? f->t1 - f->t0 : 1;
+    float kx = (f->w - 1) / span;
+    int count = 0;
+    int i = 0;
+    while (i < n && count + 4 <= max_out) {
+        // Столбец пикселей: точки i..end-1 (x - как в chart_x)
+        int col = f->x + (int)((t[i] - f->t0) * kx + 0.5f);
+        int lo = i, hi = i, end = i + 1;
+        while (end < n && f->x + (int)((t[end] - f->t0) * kx + 0.5f) == col) {
+            if (v[end] < v[lo]) lo = end;
+            if (v[end] > v[hi]) hi = end;
+            end++;
+        }
+        int keep[4] = { i, lo < hi ? lo : hi, lo < hi ? hi : lo, end - 1 };
+        for (int k = 0; k < 4; k++) {
+            if (k > 0 && keep[k] == keep[k - 1]) continue;
+            out[count].x = col;
+            out[count].y = chart_y(f, v[keep[k]]);
+            count++;
+        }
+        i = end;
+    }
+    return count;
+}
+
+// Площадь под серией до нижнего края рамки: точки линии и два угла.
+// max_out >= 4 * f->w + 2
+static int chart_area(const ChartFrame *f, const float *t, const float *v, int n,
+                      XPoint *out, int max_out) {
+    int count = chart_points(f, t, v, n, out, max_out - 2);
+    if (count == 0) return 0;
+    int base = f->y + f->h - 1;
+    out[count].x = out[count - 1].x;
+    out[count].y = base;
+    out[count + 1].x = out[0].x;
+    out[count + 1].y = base;
+    return count + 2;
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef CITYDB_H
+#define CITYDB_H
+
+// Справочник городов для подсказок ввода, без сети.
+// Источник - текст (cities.tsv: id, широта, долгота, страна, имя
+// латиницей, имя кириллицей, через табуляцию). citydb_build() собирает из
+// него двоичный файл, который читается через mmap как есть:
+//   CityDbHeader - счетчики и индекс по первому байту ключа;
+//   CityRecord[ncities] - города фиксированного размера;
+//   CityKey[nkeys] - ключи поиска (оба имени каждого города), по
+//                    возрастанию свернутой строки;
+//   строки - имена и свернутые ключи, каждая с '\0'.
+// Ключ свернут: латиница и кириллица в нижнем регистре, ё -> е. Поиск
+// по префиксу: индекс первого байта дает отрезок ключей, двоичный поиск
+// в нем - первый подходящий, дальше ключи подряд. Памяти поиск не
+// выделяет; страницы файла подгружает ядро по мере обращения.
+//
+// Файл - CITY_DB или cities.db в каталоге кэша; пересобирается, если
+// список (CITY_LIST, по умолчанию cities.tsv) новее.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CITYDB_MAGIC    0x31444357      // "WCD1"
+#define CITYDB_NAME_MAX 64
+#define CITYDB_MAX_CITIES 1000000
+
+typedef struct {
+    unsigned magic;
+    unsigned ncities;
+    unsigned nkeys;
+    unsigned strings_len;
+    unsigned index[257];        // index[b] - первый ключ, чей первый байт >= b
+} CityDbHeader;
+
+typedef struct {
+    int id;                     // id OpenWeatherMap
+    float lat, lon;
+    unsigned name;              // смещение в строках
+    unsigned name_ru;
+    char country[4];
+} CityRecord;                   // 24 байта
+
+typedef struct {
+    unsigned key;               // свернутое имя, смещение в строках
+    unsigned city;
+} CityKey;
+
+typedef struct {
+    void *map;
+    size_t map_len;
+    const CityDbHeader *h;
+    const CityRecord *cities;
+    const CityKey *keys;
+    const char *strings;
+} CityDb;
+
+// Свернуть строку для сравнения: нижний регистр латиницы и кириллицы
+// (UTF-8), ё -> е. Возвращает длину out
+static int citydb_fold(const char *in, char *out, int size) {
+    int n = 0;
+    const unsigned char *s = (const unsigned char *)in;
+    while (*s && n < size - 2) {
+        unsigned c = *s;
+        if (c >= 'A' && c <= 'Z') {
+            out[n++] = c + 32;
+            s++;
+        } else if ((c == 0xD0 || c == 0xD1) && (s[1] & 0xC0) == 0x80) {
+            unsigned cp = (c & 0x1F) << 6 | (s[1] & 0x3F);
+            if (cp >= 0x410 && cp <= 0x42F) cp += 0x20;     // А..Я
+            if (cp == 0x401 || cp == 0x451) cp = 0x435;     // Ё, ё
+            out[n++] = 0xC0 | cp >> 6;
+            out[n++] = 0x80 | (cp & 0x3F);
+            s += 2;
+        } else {
+            out[n++] = c;
+            s++;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static void citydb_close(CityDb *db) {
+    if (db->map) munmap(db->map, db->map_len);
+    memset(db, 0, sizeof(*db));
+}
+
+static int citydb_map(CityDb *db, const char *path) {
+    citydb_close(db);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CityDbHeader)) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const CityDbHeader *h = map;
+    size_t need = sizeof(*h) + (size_t)h->ncities * sizeof(CityRecord) +
+                  (size_t)h->nkeys * sizeof(CityKey) + h->strings_len;
+    if (h->magic != CITYDB_MAGIC || h->ncities > CITYDB_MAX_CITIES ||
+        h->nkeys > 2 * CITYDB_MAX_CITIES || need != (size_t)st.st_size ||
+        h->index[256] != h->nkeys) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    db->map = map;
+    db->map_len = st.st_size;
+    db->h = h;
+    db->cities = (const CityRecord *)(h + 1);
+    db->keys = (const CityKey *)(db->cities + h->ncities);
+    db->strings = (const char *)(db->keys + h->nkeys);
+    return 1;
+}
+
+// ---------- сборка ----------
+
+static const char *citydb_sort_strings;     // для qsort
+
+static int citydb_key_cmp(const void *a, const void *b) {
+    const CityKey *x = a, *y = b;
+    return strcmp(citydb_sort_strings + x->key, citydb_sort_strings + y->key);
+}
+
+typedef struct {
+    char *data;
+    unsigned len, cap;
+} CityDbPool;
+
+static unsigned citydb_pool_add(CityDbPool *p, const char *s, int len) {
+    if (p->len + len + 1 > p->cap) {
+        unsigned cap = p->cap ? p->cap * 2 : 4096;
+        while (cap < p->len + len + 1) cap *= 2;
+        char *data = realloc(p->data, cap);
+        if (!data) return 0;
+        p->data = data;
+        p->cap = cap;
+    }
+    unsigned off = p->len;
+    memcpy(p->data + off, s, len);
+    p->data[off + len] = '\0';
+    p->len += len + 1;
+    return off;
+}
+
+// Текстовый список -> двоичный файл (через временный и rename). 1 - собран
+static int citydb_build(const char *list, const char *path) {
+    FILE *in = fopen(list, "r");
+    if (!in) return 0;
+
+    CityRecord *cities = NULL;
+    CityKey *keys = NULL;
+    unsigned ncities = 0, nkeys = 0, cap = 0;
+    CityDbPool pool = { 0 };
+    char line[512];
+    int ok = 1;
+    citydb_pool_add(&pool, "", 0);          // смещение 0 - пустое имя
+
+    while (ok && fgets(line, sizeof(line), in) && ncities < CITYDB_MAX_CITIES) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *field[6];
+        int nf = 0;
+        for (char *s = line; nf < 6; nf++) {
+            field[nf] = s;
+            s = strchr(s, '\t');
+            if (!s) {
+                nf++;
+                break;
+            }
+            *s++ = '\0';
+        }
+        if (nf < 5 || atoi(field[0]) <= 0 || !field[4][0]) continue;
+
+        if (ncities == cap) {
+            cap = cap ? cap * 2 : 256;
+            CityRecord *c = realloc(cities, cap * sizeof(CityRecord));
+            CityKey *k = c ? realloc(keys, 2 * cap * sizeof(CityKey)) : NULL;
+            if (c) cities = c;
+            if (k) keys = k;
+            if (!c || !k) {
+                ok = 0;
+                break;
+            }
+        }
+        CityRecord *c = &cities[ncities];
+        memset(c, 0, sizeof(*c));
+        c->id = atoi(field[0]);
+        c->lat = strtof(field[1], NULL);
+        c->lon = strtof(field[2], NULL);
+        snprintf(c->country, sizeof(c->country), "%s", field[3]);
+        c->name = citydb_pool_add(&pool, field[4], strnlen(field[4], CITYDB_NAME_MAX - 1));
+        c->name_ru = nf > 5 && field[5][0] ? citydb_pool_add(&pool, field[5], strnlen(field[5], CITYDB_NAME_MAX - 1)) : 0;
+
+        char folded[CITYDB_NAME_MAX * 2];
+        for (int k = 0; k < 2; k++) {
+            unsigned name = k ? c->name_ru : c->name;
+            if (!name) continue;
+            int len = citydb_fold(pool.data + name, folded, sizeof(folded));
+            keys[nkeys].key = citydb_pool_add(&pool, folded, len);
+            keys[nkeys].city = ncities;
+            nkeys++;
+        }
+        ncities++;
+    }
+    fclose(in);
+    ok = ok && ncities > 0 && pool.data;
+
+    CityDbHeader h;
+    memset(&h, 0, sizeof(h));
+    if (ok) {
+        citydb_sort_strings = pool.data;
+        qsort(keys, nkeys, sizeof(CityKey), citydb_key_cmp);
+        h.magic = CITYDB_MAGIC;
+        h.ncities = ncities;
+        h.nkeys = nkeys;
+        h.strings_len = pool.len;
+        unsigned k = 0;
+        for (int b = 0; b <= 256; b++) {
+            while (k < nkeys && (unsigned char)pool.data[keys[k].key] < b) k++;
+            h.index[b] = b == 256 ? nkeys : k;
+        }
+    }
+
+    // path до 300 байт (citydb_open), tmp длиннее на ".tmp"
+    char tmp[310];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) ok = 0;
+    FILE *out = ok ? fopen(tmp, "wb") : NULL;
+    if (out) {
+        ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+             fwrite(cities, sizeof(CityRecord), ncities, out) == ncities &&
+             fwrite(keys, sizeof(CityKey), nkeys, out) == nkeys &&
+             fwrite(pool.data, 1, pool.len, out) == pool.len;
+        ok = fclose(out) == 0 && ok;
+        if (!ok || rename(tmp, path) != 0) {
+            remove(tmp);
+            ok = 0;
+        }
+    } else {
+        ok = 0;
+    }
+    free(cities);
+    free(keys);
+    free(pool.data);
+    return ok;
+}
+
+// Открыть справочник, при нужде пересобрав его из списка.
+// dir - каталог для cities.db, если CITY_DB не задан
+static int citydb_open(CityDb *db, const char *dir) {
+    const char *list = getenv("CITY_LIST");
+    const char *env = getenv("CITY_DB");
+    char path[300];
+    int n;
+    if (!list) list = "cities.tsv";
+    if (env) n = snprintf(path, sizeof(path), "%s", env);
+    else if (dir && dir[0]) n = snprintf(path, sizeof(path), "%s/cities.db", dir);
+    else n = snprintf(path, sizeof(path), "cities.db");
+    if (n >= (int)sizeof(path)) return 0;   // обрезанный путь указал бы на чужой файл
+
+    struct stat src, bin;
+    int have_src = stat(list, &src) == 0;
+    int stale = stat(path, &bin) != 0 || (have_src && src.st_mtime > bin.st_mtime);
+    if (stale && have_src && !citydb_build(list, path)) {
+        fprintf(stderr, "City list %s: cannot build %s\n", list, path);
+    }
+    return citydb_map(db, path);
+}
+
+static const char *citydb_name(const CityDb *db, const CityRecord *c) {
+    return db->strings + c->name;
+}
+
+static const char *citydb_name_ru(const CityDb *db, const CityRecord *c) {
+    return db->strings + c->name_ru;
+}
+
+// Первый ключ >= folded (len байт сравниваются как префикс)
+static unsigned citydb_lower_bound(const CityDb *db, const char *folded, int len) {
+    unsigned char first = folded[0];
+    unsigned lo = db->h->index[first], hi = db->h->index[first + 1];
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (strncmp(db->strings + db->keys[mid].key, folded, len) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Города, чье имя (любое) начинается с prefix: до max штук, по алфавиту
+// ключа, без повторов. Возвращает число найденных
+static int citydb_suggest(const CityDb *db, const char *prefix, const CityRecord **out, int max) {
+    char folded[CITYDB_NAME_MAX * 2];
+    int len = citydb_fold(prefix, folded, sizeof(folded));
+    if (!db->map || len == 0) return 0;
+
+    int n = 0;
+    for (unsigned k = citydb_lower_bound(db, folded, len); k < db->h->nkeys && n < max; k++) {
+        if (strncmp(db->strings + db->keys[k].key, folded, len) != 0) break;
+        const CityRecord *c = &db->cities[db->keys[k].city];
+        int dup = 0;
+        for (int i = 0; i < n; i++) dup |= out[i] == c;
+        if (!dup) out[n++] = c;
+    }
+    return n;
+}
+
+// Город с точно таким именем (без учета регистра); NULL - нет
+static const CityRecord *citydb_exact(const CityDb *db, const char *name) {
+    char folded[CITYDB_NAME_MAX * 2];
+    int len = citydb_fold(name, folded, sizeof(folded));
+    if (!db->map || len == 0) return NULL;
+    unsigned k = citydb_lower_bound(db, folded, len + 1);    // с '\0' - целиком
+    if (k < db->h->nkeys && strcmp(db->strings + db->keys[k].key, folded) == 0) {
+        return &db->cities[db->keys[k].city];
+    }
+    return NULL;
+}
+
+#endif
@@ -496,6 +496,8 @@
 #include <time.h>
 #include <errno.h>
 
+#include "render.h"
+
 #define WIN_W 800
 #define WIN_H 600
 
@@ -510,6 +512,10 @@
 #define VISIBLE_ITEMS ((WIN_H - HEADER_H - FOOTER_H - 2*MARGIN) / ITEM_H)
 #define FILE_PREVIEW_LIMIT 200000 // bytes
 
+#define COLOR_FG     0x000000
+#define COLOR_BG     0xFFFFFF
+#define COLOR_HIDDEN 0x888888 // скрытые файлы
+
 typedef struct {
     char name[PATH_MAX];
     int is_dir;
@@ -523,6 +529,10 @@ typedef struct {
     Window win;
     GC gc;
     XFontStruct *font;
+    FontMetrics metrics; // ширины глифов без запросов к серверу
+    XResources res;      // цвета и GC, выделенные один раз
+    XBatch batch;        // примитивы кадра, уходят пачкой в draw_all
+    Renderer r;          // Xlib или программный буфер (--headless)
     int win_w, win_h;
 
     char cwd[PATH_MAX];
@@ -544,6 +554,14 @@ static void die(const char *msg) {
     exit(1);
 }
 
+static void app_exit(FMApp *app) {
+    xb_report(&app->batch);
+    xres_report(&app->res);
+    xres_free(&app->res);
+    XCloseDisplay(app->dpy);
+    exit(0);
+}
+
 static void ensure_capacity(FMApp *app) {
     if (!app->entries) {
         app->capacity = 256;
@@ -608,48 +626,50 @@ static int load_directory(FMApp *app, const char *path) {
 
 // ---------- text measurement ----------
 static int text_w(FMApp *app, const char *s) {
-    if (!s || !app->font) return 0;
-    return XTextWidth(app->font, s, strlen(s));
+    if (!s) return 0;
+    return r_text_width(&app->r, s, strlen(s));
 }
 
 // ---------- UI drawing ----------
+
 static void draw_header(FMApp *app) {
-    int y = MARGIN + app->font->ascent;
+    Renderer *r = &app->r;
+    int y = MARGIN + r->ascent;
     
     // Очищаем область заголовка
-    XClearArea(app->dpy, app->win, 0, 0, WIN_W, HEADER_H, False);
+    r_clear(r, 0, 0, WIN_W, HEADER_H);
     
     // Заголовок с текущим путем
-    XDrawString(app->dpy, app->win, app->gc, MARGIN, y, 
-                app->display_path, strlen(app->display_path));
+    r_text(r, COLOR_FG, MARGIN, y, app->display_path, strlen(app->display_path));
 
     // buttons: Up, Refresh, Exit, Show/Hide Hidden
     int bx = WIN_W - MARGIN - 60;
-    XDrawRectangle(app->dpy, app->win, app->gc, bx, MARGIN, 60, HEADER_H - 2*MARGIN);
-    XDrawString(app->dpy, app->win, app->gc, bx + 8, y, "Exit", 4);
+    r_rect(r, COLOR_FG, bx, MARGIN, 60, HEADER_H - 2*MARGIN);
+    r_text(r, COLOR_FG, bx + 8, y, "Exit", 4);
     
     bx -= 80;
-    XDrawRectangle(app->dpy, app->win, app->gc, bx, MARGIN, 70, HEADER_H - 2*MARGIN);
-    XDrawString(app->dpy, app->win, app->gc, bx + 8, y, "Refresh", 7);
+    r_rect(r, COLOR_FG, bx, MARGIN, 70, HEADER_H - 2*MARGIN);
+    r_text(r, COLOR_FG, bx + 8, y, "Refresh", 7);
     
     bx -= 80;
-    XDrawRectangle(app->dpy, app->win, app->gc, bx, MARGIN, 70, HEADER_H - 2*MARGIN);
-    XDrawString(app->dpy, app->win, app->gc, bx + 8, y, "Up", 2);
+    r_rect(r, COLOR_FG, bx, MARGIN, 70, HEADER_H - 2*MARGIN);
+    r_text(r, COLOR_FG, bx + 8, y, "Up", 2);
     
     bx -= 100;
-    XDrawRectangle(app->dpy, app->win, app->gc, bx, MARGIN, 95, HEADER_H - 2*MARGIN);
+    r_rect(r, COLOR_FG, bx, MARGIN, 95, HEADER_H - 2*MARGIN);
     if (app->show_hidden) {
-        XDrawString(app->dpy, app->win, app->gc, bx + 8, y, "Hide .*", 7);
+        r_text(r, COLOR_FG, bx + 8, y, "Hide .*", 7);
     } else {
-        XDrawString(app->dpy, app->win, app->gc, bx + 8, y, "Show .*", 7);
+        r_text(r, COLOR_FG, bx + 8, y, "Show .*", 7);
     }
 }
 
 static void draw_footer(FMApp *app) {
-    int y = WIN_H - FOOTER_H + MARGIN + app->font->ascent;
+    Renderer *r = &app->r;
+    int y = WIN_H - FOOTER_H + MARGIN + r->ascent;
     
     // Очищаем область футера
-    XClearArea(app->dpy, app->win, 0, WIN_H - FOOTER_H, WIN_W, FOOTER_H, False);
+    r_clear(r, 0, WIN_H - FOOTER_H, WIN_W, FOOTER_H);
     
     char buf[256] = {0};
     if (app->selected >= 0 && app->selected < app->entry_count) {
@@ -663,40 +683,38 @@ static void draw_footer(FMApp *app) {
         snprintf(buf, sizeof(buf), "Entries: %d | Hidden: %s", 
                  app->entry_count, app->show_hidden ? "shown" : "hidden");
     }
-    XDrawString(app->dpy, app->win, app->gc, MARGIN, y, buf, strlen(buf));
+    r_text(r, COLOR_FG, MARGIN, y, buf, strlen(buf));
 }
 
 static void draw_list(FMApp *app) {
+    Renderer *r = &app->r;
     int start_y = HEADER_H + MARGIN;
     int x = MARGIN;
     int w = WIN_W - 2*MARGIN;
     
     // background clear area
-    XClearArea(app->dpy, app->win, x, start_y, w, WIN_H - HEADER_H - FOOTER_H - 2*MARGIN, False);
+    r_clear(r, x, start_y, w, WIN_H - HEADER_H - FOOTER_H - 2*MARGIN);
 
     int max_visible = VISIBLE_ITEMS;
     for (int i = 0; i < max_visible; i++) {
         int idx = app->scroll + i;
         if (idx >= app->entry_count) break;
-        int y = start_y + i * ITEM_H + app->font->ascent;
+        int y = start_y + i * ITEM_H + r->ascent;
         // highlight selection
         if (idx == app->selected) {
-            XSetForeground(app->dpy, app->gc, WhitePixel(app->dpy, app->screen));
-            XFillRectangle(app->dpy, app->win, app->gc, x, start_y + i*ITEM_H, w, ITEM_H);
-            XSetForeground(app->dpy, app->gc, BlackPixel(app->dpy, app->screen));
+            r_fill(r, COLOR_BG, x, start_y + i*ITEM_H, w, ITEM_H);
         }
         FileEntry *e = &app->entries[idx];
         // icon as text
         const char *icon = e->is_dir ? "[DIR]" : "     ";
-        XDrawString(app->dpy, app->win, app->gc, x, y, icon, strlen(icon));
+        r_text(r, COLOR_FG, x, y, icon, strlen(icon));
         
         // Для скрытых файлов добавляем точку в начале имени
         if (e->name[0] == '.') {
-            XSetForeground(app->dpy, app->gc, 0x888888); // Серый цвет для скрытых файлов
-            XDrawString(app->dpy, app->win, app->gc, x + 60, y, e->name, strlen(e->name));
-            XSetForeground(app->dpy, app->gc, BlackPixel(app->dpy, app->screen));
+            // Серый цвет для скрытых файлов
+            r_text(r, COLOR_HIDDEN, x + 60, y, e->name, strlen(e->name));
         } else {
-            XDrawString(app->dpy, app->win, app->gc, x + 60, y, e->name, strlen(e->name));
+            r_text(r, COLOR_FG, x + 60, y, e->name, strlen(e->name));
         }
         
         // size on right
@@ -704,11 +722,20 @@ static void draw_list(FMApp *app) {
             char sizestr[32];
             snprintf(sizestr, sizeof(sizestr), "%lld", (long long)e->size);
             int tw = text_w(app, sizestr);
-            XDrawString(app->dpy, app->win, app->gc, WIN_W - MARGIN - tw, y, sizestr, strlen(sizestr));
+            r_text(r, COLOR_FG, WIN_W - MARGIN - tw, y, sizestr, strlen(sizestr));
         }
     }
 }
 
+// Примитивы всех трех областей копятся в батче и уходят одной пачкой;
+// XClearArea выполняются сразу, до сброса
+static void draw_all(FMApp *app) {
+    draw_header(app);
+    draw_list(app);
+    draw_footer(app);
+    r_flush(&app->r);
+}
+
 // ---------- file preview window ----------
 static void view_text_file(FMApp *app, const char *fullpath) {
     // Read text file up to limit
@@ -768,6 +795,7 @@ static void view_text_file(FMApp *app, const char *fullpath) {
             if (li >= lines_count) break;
             XDrawString(app->dpy, view, gc, 10, 35 + i*line_h, lines[li], strlen(lines[li]));
         }
+        r_mark_frame(&app->r);
         XFlush(app->dpy);
         
         // event loop with timeout
@@ -888,8 +916,7 @@ static void handle_button(FMApp *app, XButtonEvent *bev) {
         // Exit button
         if (bx >= bx1 && bx <= bx2) {
             // Exit
-            XCloseDisplay(app->dpy);
-            exit(0);
+            app_exit(app);
         }
         
         // Refresh button
@@ -942,11 +969,9 @@ static void handle_button(FMApp *app, XButtonEvent *bev) {
     }
 }
 
-static void handle_key(FMApp *app, XKeyEvent *kev) {
-    KeySym ks = XLookupKeysym(kev, 0);
+static void handle_keysym(FMApp *app, KeySym ks) {
     if (ks == XK_q || ks == XK_Escape) {
-        XCloseDisplay(app->dpy);
-        exit(0);
+        app_exit(app);
     } else if (ks == XK_Down) {
         if (app->selected + 1 < app->entry_count) app->selected++;
         int bottom = app->scroll + VISIBLE_ITEMS - 1;
@@ -984,8 +1009,67 @@ static void handle_key(FMApp *app, XKeyEvent *kev) {
     }
 }
 
+static void handle_key(FMApp *app, XKeyEvent *kev) {
+    handle_keysym(app, XLookupKeysym(kev, 0));
+}
+
+// ---------- headless benchmark ----------
+// conductor --headless [--frames N] [--snapshot file.ppm] [dir]
+// Рисует список программным растеризатором без X сервера: N кадров
+// с прокруткой вниз, как при удержании стрелки. Печатает время кадра
+// и сохраняет снимок последнего кадра.
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int run_headless(int argc, char **argv) {
+    FMApp app;
+    memset(&app, 0, sizeof(app));
+    app.win_w = WIN_W; app.win_h = WIN_H;
+
+    int frames = 1000;
+    const char *snapshot = NULL;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot = argv[++i];
+        } else if (chdir(argv[i]) != 0) {
+            die(argv[i]);
+        }
+    }
+    if (frames < 1) frames = 1;
+
+    if (!render_init_soft(&app.r, WIN_W, WIN_H)) die("render_init_soft");
+    if (!getcwd(app.cwd, sizeof(app.cwd))) strcpy(app.cwd, "/");
+    if (load_directory(&app, app.cwd) != 0) die(app.cwd);
+
+    double start = now_us();
+    for (int i = 0; i < frames; i++) {
+        draw_all(&app);
+        handle_keysym(&app, XK_Down);
+        if (app.selected + 1 >= app.entry_count) handle_keysym(&app, XK_Home);
+    }
+    double elapsed = now_us() - start;
+
+    printf("headless: %d entries, %d frames, %.1f us/frame, %lu primitives/frame\n",
+           app.entry_count, frames, elapsed / frames, app.r.prims / frames);
+
+    if (snapshot && !r_save_ppm(&app.r, snapshot)) die(snapshot);
+
+    render_free(&app.r);
+    free(app.entries);
+    return 0;
+}
+
 // ---------- init and main ----------
 int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        return run_headless(argc - 2, argv + 2);
+    }
+
     FMApp app;
     memset(&app, 0, sizeof(app));
     app.win_w = WIN_W; app.win_h = WIN_H;
@@ -1007,6 +1091,11 @@ int main(int argc, char **argv) {
     app.font = XLoadQueryFont(app.dpy, "6x13");
     if (!app.font) app.font = XLoadQueryFont(app.dpy, "fixed");
     if (!app.font) die("No font");
+    fm_init(&app.metrics, app.font);
+    xres_init(&app.res, app.dpy, app.screen, app.win);
+    xb_init(&app.batch, app.dpy, app.win, &app.metrics);
+    render_init_xlib(&app.r, app.dpy, app.win, &app.res, &app.batch,
+                     app.font, &app.metrics, WIN_W, WIN_H);
 
     XSetFont(app.dpy, app.gc, app.font->fid);
     XSetForeground(app.dpy, app.gc, BlackPixel(app.dpy, app.screen));
@@ -1025,24 +1114,15 @@ int main(int argc, char **argv) {
         
         if (ev.type == Expose) {
             // При экспозе перерисовываем все
-            draw_header(&app);
-            draw_list(&app);
-            draw_footer(&app);
-            XFlush(app.dpy);
+            draw_all(&app);
         } else if (ev.type == ButtonPress) {
             handle_button(&app, &ev.xbutton);
             // После обработки кнопки перерисовываем
-            draw_header(&app);
-            draw_list(&app);
-            draw_footer(&app);
-            XFlush(app.dpy);
+            draw_all(&app);
         } else if (ev.type == KeyPress) {
             handle_key(&app, &ev.xkey);
             // После обработки клавиши перерисовываем
-            draw_header(&app);
-            draw_list(&app);
-            draw_footer(&app);
-            XFlush(app.dpy);
+            draw_all(&app);
         }
     }
 
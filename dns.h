@@ -0,0 +1,211 @@
+#ifndef DNS_H
+#define DNS_H
+
+// Кэш разрешения имен на getaddrinfo (IPv4 и IPv6).
+// Разрешение идет в дочернем процессе: getaddrinfo блокирует, а потоков
+// в MINIX нет. Потомок пишет адреса в pipe одним write (меньше PIPE_BUF)
+// и завершается; главный цикл ждет pipe в том же poll, что и сокеты.
+// Результат живет DNS_TTL секунд (getaddrinfo не отдает TTL записи,
+// по умолчанию 300). Если запись использована в последней пятой части
+// срока, в фоне запускается повторное разрешение, и к истечению срока
+// адрес уже обновлен - запросы не ждут резолвер.
+// dns_report печатает долю попаданий и время разрешения.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DNS_MAX_HOSTS 8
+#define DNS_MAX_ADDRS 4
+#define DNS_ADDR_BYTES 28       // sockaddr_in6
+
+typedef struct {
+    unsigned char family;
+    unsigned char len;
+    unsigned char addr[DNS_ADDR_BYTES];     // struct sockaddr_in / sockaddr_in6
+} DnsAddr;
+
+typedef struct {
+    char host[64];
+    DnsAddr addrs[DNS_MAX_ADDRS];
+    int naddrs;
+    double expires;         // мс; 0 - адресов еще нет
+
+    pid_t pid;              // > 0 - идет разрешение
+    int fd;                 // pipe от потомка
+    double t_started;
+    DnsAddr incoming[DNS_MAX_ADDRS];
+    int got;                // байт прочитано в incoming
+    int failed;             // последнее разрешение не дало адресов
+} DnsEntry;
+
+typedef struct {
+    DnsEntry entries[DNS_MAX_HOSTS];
+    int count;
+    int ttl_ms;
+
+    unsigned long lookups;
+    unsigned long hits;         // адрес выдан из кэша сразу
+    unsigned long prefetches;
+    unsigned long failures;
+    unsigned long resolves;
+    double resolve_ms;          // суммарное время разрешения
+    double resolve_max_ms;
+} DnsCache;
+
+static DnsCache dns_cache;
+
+static double dns_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void dns_child(const char *host, int fd) {
+    struct addrinfo hints, *res = NULL, *ai;
+    DnsAddr out[DNS_MAX_ADDRS];
+    int n = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &res) == 0) {
+        for (ai = res; ai && n < DNS_MAX_ADDRS; ai = ai->ai_next) {
+            if (ai->ai_addrlen > DNS_ADDR_BYTES) continue;
+            out[n].family = ai->ai_family;
+            out[n].len = ai->ai_addrlen;
+            memcpy(out[n].addr, ai->ai_addr, ai->ai_addrlen);
+            n++;
+        }
+        freeaddrinfo(res);
+    }
+    if (n) write(fd, out, n * sizeof(DnsAddr));
+    _exit(0);
+}
+
+// Запуск разрешения в потомке; 0 - fork/pipe не удались
+static int dns_spawn(DnsEntry *e) {
+    int fds[2];
+    if (pipe(fds) < 0) return 0;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dns_child(e->host, fds[1]);
+    }
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    e->pid = pid;
+    e->fd = fds[0];
+    e->got = 0;
+    e->t_started = dns_now_ms();
+    return 1;
+}
+
+// Забирает ответ потомка, если он готов. 1 - разрешение завершилось
+static int dns_step(DnsEntry *e) {
+    if (e->pid <= 0) return 0;
+
+    for (;;) {
+        int n = read(e->fd, (char *)e->incoming + e->got, sizeof(e->incoming) - e->got);
+        if (n > 0) {
+            e->got += n;
+            if (e->got < (int)sizeof(e->incoming)) continue;
+        } else if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) return 0;
+        }
+        break;      // EOF, ошибка или буфер полон
+    }
+
+    close(e->fd);
+    waitpid(e->pid, NULL, 0);
+    e->pid = 0;
+    e->fd = -1;
+
+    double ms = dns_now_ms() - e->t_started;
+    dns_cache.resolves++;
+    dns_cache.resolve_ms += ms;
+    if (ms > dns_cache.resolve_max_ms) dns_cache.resolve_max_ms = ms;
+
+    int n = e->got / (int)sizeof(DnsAddr);
+    if (n == 0) {
+        // Старые адреса (если были) остаются до конца срока
+        e->failed = 1;
+        dns_cache.failures++;
+        return 1;
+    }
+    memcpy(e->addrs, e->incoming, n * sizeof(DnsAddr));
+    e->naddrs = n;
+    e->failed = 0;
+    e->expires = dns_now_ms() + dns_cache.ttl_ms;
+    return 1;
+}
+
+static int dns_ready(const DnsEntry *e) {
+    return e->naddrs > 0 && dns_now_ms() < e->expires;
+}
+
+// Запись для host: готовая (dns_ready) или с запущенным разрешением.
+// NULL - таблица полна или потомка запустить нельзя.
+static DnsEntry *dns_lookup(const char *host) {
+    if (dns_cache.ttl_ms == 0) {
+        const char *env = getenv("DNS_TTL");
+        dns_cache.ttl_ms = (env && atoi(env) > 0 ? atoi(env) : 300) * 1000;
+    }
+    dns_cache.lookups++;
+
+    DnsEntry *e = NULL;
+    for (int i = 0; i < dns_cache.count; i++) {
+        if (strcmp(dns_cache.entries[i].host, host) == 0) {
+            e = &dns_cache.entries[i];
+            break;
+        }
+    }
+    if (!e) {
+        if (dns_cache.count == DNS_MAX_HOSTS || strlen(host) >= sizeof(e->host)) return NULL;
+        e = &dns_cache.entries[dns_cache.count++];
+        memset(e, 0, sizeof(*e));
+        e->fd = -1;
+        strcpy(e->host, host);
+    }
+
+    dns_step(e);    // фоновое разрешение могло уже закончиться
+
+    if (dns_ready(e)) {
+        dns_cache.hits++;
+        double left = e->expires - dns_now_ms();
+        if (e->pid == 0 && left < dns_cache.ttl_ms / 5 && dns_spawn(e)) {
+            dns_cache.prefetches++;
+        }
+        return e;
+    }
+
+    if (e->pid == 0 && !dns_spawn(e)) return NULL;
+    return e;
+}
+
+static void dns_report(FILE *out) {
+    if (dns_cache.lookups == 0) return;
+    fprintf(out, "DNS: %lu lookups, hit rate %.1f%%, %lu resolves "
+                 "(avg %.1f ms, max %.1f ms), %lu prefetches, %lu failures\n",
+            dns_cache.lookups, 100.0 * dns_cache.hits / dns_cache.lookups,
+            dns_cache.resolves,
+            dns_cache.resolves ? dns_cache.resolve_ms / dns_cache.resolves : 0.0,
+            dns_cache.resolve_max_ms, dns_cache.prefetches, dns_cache.failures);
+}
+
+#endif
@@ -0,0 +1,771 @@
+#ifndef FETCH_H
+#define FETCH_H
+
+// Асинхронный HTTP GET, который не останавливает отрисовку.
+// Сокет неблокирующий, запрос - конечный автомат
+//   RESOLVING -> CONNECTING -> SENDING -> READING -> DONE / FAILED.
+// Главный цикл, пока fetch_active(), добавляет fetch_fd() с маской
+// fetch_events() в poll рядом с ConnectionNumber(display) и зовет
+// fetch_step(); тот возвращает 1 ровно один раз - когда запрос завершился.
+// Адреса берутся из кэша dns.h; RESOLVING ждет pipe резолвера, если
+// адреса хоста еще нет. Адреса пробуются по очереди (IPv6 и IPv4).
+// fetch_start() на занятом Fetch отменяет прежний запрос, его ответ уже
+// никогда не будет применен. Чтобы повтор того же запроса (двойной клик
+// Refresh) не отменял идущий, вызывающий сначала пробует fetch_join().
+//
+// Соединения HTTP/1.1 живут в общем пуле (FetchConn) и переиспользуются
+// всеми запросами программы к тому же хосту. Запрос к хосту, чье
+// соединение занято, но уже доказало keep-alive, ставится в конвейер:
+// уходит сразу, ответы читаются по очереди. Перед выдачей из пула
+// простаивающее соединение проверяется poll'ом с нулевым таймаутом -
+// закрытое сервером отбрасывается; если сервер закрыл соединение до
+// первого байта ответа, запрос один раз повторяется на новом.
+// Простаивающих соединений не больше FETCH_MAX_IDLE (и FETCH_IDLE_PER_HOST
+// на хост), старше FETCH_IDLE_MS закрываются.
+// Ответ разбирается потоково (httpparse.h) прямо из буфера чтения
+// соединения; тело уходит в sink запроса (fetch_set_sink) или в растущий
+// буфер f->buf, откуда его видно как f->body / f->body_len.
+//
+// У каждой фазы свой срок (FetchLimits): разрешение имени, connect,
+// первый байт ответа после отправки запроса, и общий срок на весь запрос.
+// poll в главном цикле спит не дольше fetch_timeout_ms(), просроченный
+// запрос завершается через fetch_check_deadline() с ошибкой "... timeout".
+// Время фаз копится в логарифмических гистограммах (fetch_report).
+// Сроки настраиваются переменной FETCH_TIMEOUTS="dns,connect,first,total" (мс).
+// Резолвер, не уложившийся в срок, не убивается: его ответ попадет в кэш.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns.h"
+#include "httpparse.h"
+
+#define FETCH_RBUF 4096         // буфер чтения соединения
+#define FETCH_HIST_BUCKETS 16   // <1, <2, <4 ... <16384 мс, дольше
+
+#define FETCH_MAX_CONNS     8
+#define FETCH_MAX_IDLE      4
+#define FETCH_IDLE_PER_HOST 2
+#define FETCH_IDLE_MS       30000
+#define FETCH_PIPELINE      4   // запросов в очереди одного соединения
+
+enum { FETCH_DNS, FETCH_CONNECT, FETCH_FIRST_BYTE, FETCH_TOTAL, FETCH_PHASES };
+
+static const char *fetch_phase_names[FETCH_PHASES] = {
+    "dns", "connect", "first byte", "total"
+};
+
+typedef struct {
+    int ms[FETCH_PHASES];       // срок фазы
+} FetchLimits;
+
+typedef struct {
+    unsigned long hist[FETCH_PHASES][FETCH_HIST_BUCKETS];
+    unsigned long count[FETCH_PHASES];
+    double sum_ms[FETCH_PHASES];
+    unsigned long timeouts[FETCH_PHASES];
+
+    unsigned long opened;       // новых соединений
+    unsigned long reused;       // запросов на соединении из пула
+    unsigned long pipelined;    // из них - в очередь за другим запросом
+    unsigned long stale;        // закрытых сервером, найдено в пуле
+    unsigned long retries;
+    unsigned long joined;       // повторов запроса, присоединенных к идущему
+    double connect_ms;          // сумма времени установки соединений
+} FetchStats;
+
+// Одна программа - одна единица трансляции, статистика общая для всех Fetch
+static FetchStats fetch_stats;
+
+enum {
+    FETCH_IDLE,
+    FETCH_RESOLVING,
+    FETCH_CONNECTING,
+    FETCH_SENDING,
+    FETCH_READING,
+    FETCH_DONE,
+    FETCH_FAILED
+};
+
+typedef struct Fetch Fetch;
+
+typedef struct {
+    int fd;                     // -1 - слот свободен
+    char host[64];
+    int port;
+    DnsEntry *dns;
+    int addr_index;             // текущий адрес в dns->addrs
+    int connected;
+    int keep_alive;             // последний ответ разрешил держать соединение
+    double t_connect;
+    double idle_since;          // 0 - в очереди есть запросы
+    unsigned long served;
+    Fetch *queue[FETCH_PIPELINE];   // queue[0] читает свой ответ
+    int nqueue;
+    char rbuf[FETCH_RBUF];      // прочитано, но еще не разобрано
+    int rpos;
+    int rlen;
+} FetchConn;
+
+static FetchConn fetch_conns[FETCH_MAX_CONNS];
+static int fetch_conns_ready;
+
+struct Fetch {
+    int state;
+    int reported;               // завершение уже отдано fetch_step
+
+    char host[64];
+    int port;
+    DnsEntry *dns;
+    FetchConn *conn;
+    int reused;                 // соединение взято из пула
+    int retried;
+
+    char request[1024];
+    char headers[256];          // дополнительные строки запроса (fetch_set_headers)
+    int req_len;
+    int req_sent;
+
+    HttpParser parser;
+    HttpSink sink;                  // NULL - тело копится в buf
+    void *sink_ctx;
+    HttpBuffer buf;
+    long received;                  // байт ответа разобрано
+    const char *body;               // после DONE - тело из buf, с '\0'
+    long body_len;
+    int status;                     // код из строки статуса
+
+    FetchLimits limits;
+    double t_start;                 // мс, монотонное время
+    double t_phase;                 // начало текущей фазы
+    double deadline;                // ближайший срок: фазы или общий
+    double saved_ms;                // оценка сэкономленного рукопожатия
+
+    char error[64];
+    int timed_out;                  // FAILED по сроку
+    unsigned long started;          // запущено запросов
+    unsigned long cancelled;        // отменено незавершенными
+};
+
+static double fetch_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fetch_init(Fetch *f) {
+    memset(f, 0, sizeof(*f));
+    f->reported = 1;
+    f->limits.ms[FETCH_DNS] = 2000;
+    f->limits.ms[FETCH_CONNECT] = 3000;
+    f->limits.ms[FETCH_FIRST_BYTE] = 5000;
+    f->limits.ms[FETCH_TOTAL] = 10000;
+
+    const char *env = getenv("FETCH_TIMEOUTS");
+    if (env) {
+        int ms[FETCH_PHASES];
+        if (sscanf(env, "%d,%d,%d,%d", &ms[0], &ms[1], &ms[2], &ms[3]) == FETCH_PHASES) {
+            memcpy(f->limits.ms, ms, sizeof(ms));
+        }
+    }
+
+    if (!fetch_conns_ready) {
+        for (int i = 0; i < FETCH_MAX_CONNS; i++) fetch_conns[i].fd = -1;
+        fetch_conns_ready = 1;
+        // Запись в закрытое сервером соединение - ошибка write, а не смерть
+        signal(SIGPIPE, SIG_IGN);
+    }
+}
+
+static void fetch_record(int phase, double ms) {
+    int bucket = 0;
+    while (bucket < FETCH_HIST_BUCKETS - 1 && ms >= (double)(1 << bucket)) bucket++;
+    fetch_stats.hist[phase][bucket]++;
+    fetch_stats.count[phase]++;
+    fetch_stats.sum_ms[phase] += ms;
+}
+
+// Начало фазы next: срок - ее лимит, но не позже общего срока запроса
+static void fetch_deadline(Fetch *f, int next) {
+    f->t_phase = fetch_now_ms();
+    f->deadline = f->t_start + f->limits.ms[FETCH_TOTAL];
+    if (next != FETCH_TOTAL && f->t_phase + f->limits.ms[next] < f->deadline) {
+        f->deadline = f->t_phase + f->limits.ms[next];
+    }
+}
+
+// Конец фазы phase: запись в гистограмму и срок для следующей
+static void fetch_enter(Fetch *f, int phase, int next) {
+    fetch_record(phase, fetch_now_ms() - f->t_phase);
+    fetch_deadline(f, next);
+}
+
+static int fetch_busy(const Fetch *f) {
+    return f->state == FETCH_RESOLVING || f->state == FETCH_CONNECTING ||
+           f->state == FETCH_SENDING || f->state == FETCH_READING;
+}
+
+// Запрос еще нужно вести: идет или завершился, но fetch_step об этом не сказал
+static int fetch_active(const Fetch *f) {
+    return fetch_busy(f) || !f->reported;
+}
+
+static int fetch_attach(Fetch *f, int allow_reuse);
+static void fetch_detach(Fetch *f);
+
+static int fetch_fail(Fetch *f, const char *what) {
+    snprintf(f->error, sizeof(f->error), "%s", what);
+    fetch_detach(f);
+    f->state = FETCH_FAILED;
+    return 0;
+}
+
+// ---------- connection pool ----------
+static void conn_close(FetchConn *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->nqueue = 0;
+    c->idle_since = 0;
+}
+
+// Простаивающее соединение живо, если читать из него нечего:
+// EOF или лишние байты значат, что сервер его закрыл или сломал
+static int conn_alive(FetchConn *c) {
+    struct pollfd pfd;
+    pfd.fd = c->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
+// Закрывает просроченные простаивающие соединения и лишние сверх лимитов
+static void conn_trim(void) {
+    double now = fetch_now_ms();
+    for (int i = 0; i < FETCH_MAX_CONNS; i++) {
+        FetchConn *c = &fetch_conns[i];
+        if (c->fd >= 0 && c->idle_since > 0 && now - c->idle_since > FETCH_IDLE_MS) {
+            conn_close(c);
+        }
+    }
+
+    for (;;) {
+        int total = 0;
+        FetchConn *oldest = NULL;
+        FetchConn *host_oldest = NULL;
+        for (int i = 0; i < FETCH_MAX_CONNS; i++) {
+            FetchConn *c = &fetch_conns[i];
+            if (c->fd < 0 || c->idle_since == 0) continue;
+            total++;
+            if (!oldest || c->idle_since < oldest->idle_since) oldest = c;
+
+            int same = 0;
+            FetchConn *first = c;
+            for (int j = 0; j < FETCH_MAX_CONNS; j++) {
+                FetchConn *d = &fetch_conns[j];
+                if (d->fd < 0 || d->idle_since == 0 || d->port != c->port ||
+                    strcmp(d->host, c->host) != 0) continue;
+                same++;
+                if (d->idle_since < first->idle_since) first = d;
+            }
+            if (same > FETCH_IDLE_PER_HOST) host_oldest = first;
+        }
+
+        if (host_oldest) conn_close(host_oldest);
+        else if (total > FETCH_MAX_IDLE) conn_close(oldest);
+        else break;
+    }
+}
+
+// Соединение для нового запроса: простаивающее живое или с конвейером
+static FetchConn *conn_find(const char *host, int port) {
+    FetchConn *pipeline = NULL;
+
+    conn_trim();
+    for (int i = 0; i < FETCH_MAX_CONNS; i++) {
+        FetchConn *c = &fetch_conns[i];
+        if (c->fd < 0 || c->port != port || strcmp(c->host, host) != 0) continue;
+
+        if (c->nqueue == 0) {
+            if (conn_alive(c)) return c;
+            fetch_stats.stale++;
+            conn_close(c);
+        } else if (c->connected && c->keep_alive && c->nqueue < FETCH_PIPELINE &&
+                   (!pipeline || c->nqueue < pipeline->nqueue)) {
+            pipeline = c;
+        }
+    }
+    return pipeline;
+}
+
+static FetchConn *conn_new(void) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < FETCH_MAX_CONNS; i++) {
+            FetchConn *c = &fetch_conns[i];
+            if (c->fd < 0) return c;
+            // Второй проход: вытеснить простаивающее
+            if (pass == 1 && c->nqueue == 0) {
+                conn_close(c);
+                return c;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void conn_connected(FetchConn *c) {
+    double ms = fetch_now_ms() - c->t_connect;
+    c->connected = 1;
+    fetch_record(FETCH_CONNECT, ms);
+    fetch_stats.connect_ms += ms;
+
+    for (int i = 0; i < c->nqueue; i++) {
+        c->queue[i]->state = FETCH_SENDING;
+        fetch_deadline(c->queue[i], FETCH_TOTAL);
+    }
+}
+
+// connect к адресам хоста, начиная с from. 0 - ни один адрес не принял
+static int conn_connect(FetchConn *c, int from) {
+    for (c->addr_index = from; c->addr_index < c->dns->naddrs; c->addr_index++) {
+        DnsAddr *a = &c->dns->addrs[c->addr_index];
+        struct sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        memcpy(&addr, a->addr, a->len);
+        if (a->family == AF_INET6) ((struct sockaddr_in6 *)&addr)->sin6_port = htons(c->port);
+        else ((struct sockaddr_in *)&addr)->sin_port = htons(c->port);
+
+        if (c->fd >= 0) close(c->fd);
+        c->fd = socket(a->family, SOCK_STREAM, 0);
+        if (c->fd < 0) continue;
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+
+        if (connect(c->fd, (struct sockaddr *)&addr, a->len) == 0) {
+            conn_connected(c);
+            return 1;
+        }
+        if (errno == EINPROGRESS) return 1;
+    }
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    return 0;
+}
+
+// Запрос покидает очередь соединения, его ответ прочитан целиком
+static void conn_dequeue(FetchConn *c) {
+    memmove(c->queue, c->queue + 1, (c->nqueue - 1) * sizeof(Fetch *));
+    c->nqueue--;
+    if (c->nqueue > 0) return;
+
+    if (c->keep_alive) {
+        c->idle_since = fetch_now_ms();
+        conn_trim();
+    } else {
+        conn_close(c);
+    }
+}
+
+// Соединение потеряно: запросы, чьи ответы не начаты, уходят на новое
+static void conn_abort(FetchConn *c) {
+    Fetch *queue[FETCH_PIPELINE];
+    int n = c->nqueue;
+    memcpy(queue, c->queue, n * sizeof(Fetch *));
+    conn_close(c);
+
+    for (int i = 0; i < n; i++) {
+        Fetch *g = queue[i];
+        g->conn = NULL;
+        if (!fetch_busy(g)) continue;
+        if (g->retried || g->received > 0) {
+            fetch_fail(g, "connection lost");
+            continue;
+        }
+        g->retried = 1;
+        fetch_stats.retries++;
+        if (!fetch_attach(g, 0)) fetch_fail(g, "connect failed");
+    }
+}
+
+// Ответ головы очереди разобран до конца
+static void conn_complete(FetchConn *c) {
+    Fetch *h = c->queue[0];
+
+    // Байты без запроса после последнего ответа - соединению верить нельзя
+    if (c->nqueue == 1 && c->rpos < c->rlen) h->parser.keep_alive = 0;
+
+    h->status = h->parser.status;
+    h->body_len = h->parser.body_bytes;     // и при sink: сколько ему отдано
+    if (!h->sink) {
+        if (!h->buf.data) http_buffer_append(&h->buf, "", 0);
+        h->body = h->buf.data;
+    }
+    h->state = FETCH_DONE;
+    h->conn = NULL;
+    fetch_record(FETCH_TOTAL, fetch_now_ms() - h->t_start);
+
+    c->served++;
+    c->keep_alive = h->parser.keep_alive;
+    conn_dequeue(c);
+}
+
+// Ведет соединение: connect, запись запросов по порядку, чтение ответов
+static void conn_pump(FetchConn *c, short revents) {
+    if (!c->connected) {
+        if (!(revents & (POLLOUT | POLLERR | POLLHUP))) return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            // Следующий адрес хоста, если есть
+            if (!conn_connect(c, c->addr_index + 1)) {
+                while (c->nqueue > 0) fetch_fail(c->queue[0], "connect failed");
+                conn_close(c);
+            }
+            return;
+        }
+        conn_connected(c);
+    }
+
+    for (int i = 0; i < c->nqueue; i++) {
+        Fetch *g = c->queue[i];
+        while (g->req_sent < g->req_len) {
+            int n = write(c->fd, g->request + g->req_sent, g->req_len - g->req_sent);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) goto read;
+                conn_abort(c);
+                return;
+            }
+            g->req_sent += n;
+        }
+        if (g->state == FETCH_SENDING) {
+            g->state = FETCH_READING;
+            fetch_deadline(g, FETCH_FIRST_BYTE);
+        }
+    }
+
+read:
+    while (c->nqueue > 0) {
+        Fetch *h = c->queue[0];
+        if (h->state != FETCH_READING) return;
+
+        if (c->rpos == c->rlen) {
+            int n = read(c->fd, c->rbuf, sizeof(c->rbuf));
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+            if (n <= 0) {
+                // Соединение закрыто
+                if (n == 0 && http_eof(&h->parser)) {
+                    conn_complete(c);           // тело до закрытия
+                    if (c->fd >= 0) conn_abort(c);
+                } else if (h->received == 0 && h->reused) {
+                    fetch_stats.stale++;
+                    conn_abort(c);              // повтор на новом соединении
+                } else {
+                    fetch_fail(h, n == 0 ? "connection closed" : "read failed");
+                }
+                return;
+            }
+            c->rpos = 0;
+            c->rlen = n;
+        }
+
+        if (h->received == 0) fetch_enter(h, FETCH_FIRST_BYTE, FETCH_TOTAL);
+        long used = http_feed(&h->parser, c->rbuf + c->rpos, c->rlen - c->rpos);
+        if (used < 0) {
+            fetch_fail(h, h->parser.error);
+            return;
+        }
+        h->received += used;
+        c->rpos += used;
+        if (h->parser.state == HTTP_DONE) conn_complete(c);
+    }
+}
+
+// Запрос получает соединение: из пула или новое
+static int fetch_attach(Fetch *f, int allow_reuse) {
+    FetchConn *c = allow_reuse ? conn_find(f->host, f->port) : NULL;
+    f->req_sent = 0;
+    f->received = 0;
+    http_buffer_reset(&f->buf);
+    http_parser_init(&f->parser, f->sink ? f->sink : http_buffer_sink,
+                     f->sink ? f->sink_ctx : (void *)&f->buf);
+
+    if (c) {
+        f->reused = 1;
+        fetch_stats.reused++;
+        if (c->nqueue > 0) fetch_stats.pipelined++;
+        if (fetch_stats.opened) f->saved_ms = fetch_stats.connect_ms / fetch_stats.opened;
+        c->idle_since = 0;
+        c->queue[c->nqueue++] = f;
+        f->conn = c;
+        f->state = FETCH_SENDING;
+        fetch_deadline(f, FETCH_TOTAL);
+        return 1;
+    }
+
+    c = conn_new();
+    if (!c) return fetch_fail(f, "too many connections");
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    snprintf(c->host, sizeof(c->host), "%s", f->host);
+    c->port = f->port;
+    c->dns = f->dns;
+    c->queue[0] = f;
+    c->nqueue = 1;
+    c->t_connect = fetch_now_ms();
+    f->conn = c;
+    f->reused = 0;
+    f->state = FETCH_CONNECTING;
+    fetch_deadline(f, FETCH_CONNECT);
+    fetch_stats.opened++;
+
+    if (!conn_connect(c, 0)) {
+        c->nqueue = 0;
+        return fetch_fail(f, "connect failed");
+    }
+    return 1;
+}
+
+// Запрос уходит из очереди соединения раньше, чем прочитан его ответ
+static void fetch_detach(Fetch *f) {
+    FetchConn *c = f->conn;
+    if (!c) return;
+    f->conn = NULL;
+
+    int i = 0;
+    while (i < c->nqueue && c->queue[i] != f) i++;
+    if (i == c->nqueue) return;
+
+    memmove(c->queue + i, c->queue + i + 1, (c->nqueue - i - 1) * sizeof(Fetch *));
+    c->nqueue--;
+
+    if (f->req_sent > 0) {
+        // Ответ уже в пути - соединение не разобрать, остальные повторятся
+        conn_abort(c);
+        return;
+    }
+    if (c->nqueue == 0) {
+        if (c->connected && (c->keep_alive || c->served == 0)) {
+            c->idle_since = fetch_now_ms();
+        } else {
+            conn_close(c);
+        }
+    }
+}
+
+// ---------- requests ----------
+static void fetch_cancel(Fetch *f) {
+    if (fetch_busy(f)) f->cancelled++;
+    fetch_detach(f);
+    f->state = FETCH_IDLE;
+    f->reported = 1;
+}
+
+static void fetch_free(Fetch *f) {
+    fetch_cancel(f);
+    http_buffer_free(&f->buf);
+    f->body = NULL;
+    f->body_len = 0;
+}
+
+// Тело следующих ответов - в sink по кускам, без буфера (NULL - в f->buf).
+// Сигнатура как у write callback в curl; вернуть меньше, чем дали, - отказ
+static void fetch_set_sink(Fetch *f, HttpSink sink, void *ctx) {
+    f->sink = sink;
+    f->sink_ctx = ctx;
+}
+
+// Дополнительные заголовки следующих запросов, каждая строка с "\r\n"
+// (If-None-Match и т.п.); "" - без них
+static void fetch_set_headers(Fetch *f, const char *headers) {
+    snprintf(f->headers, sizeof(f->headers), "%s", headers);
+}
+
+// Адреса есть - запрос встает в очередь соединения
+static int fetch_resolved(Fetch *f) {
+    fetch_enter(f, FETCH_DNS, FETCH_CONNECT);
+    return fetch_attach(f, 1);
+}
+
+// Запуск запроса. 0 - запрос не начался (ошибка в f->error, state = FAILED)
+// Тот же запрос (хост, порт, путь) уже идет на f - новый не нужен:
+// вызывающий дождется его результата. 1 - присоединились (fetch_stats.joined)
+static int fetch_join(Fetch *f, const char *host, int port, const char *path) {
+    int len = strlen(path);
+    if (!fetch_busy(f) || f->port != port || strcmp(f->host, host) != 0 ||
+        strncmp(f->request + 4, path, len) != 0 || f->request[4 + len] != ' ') {
+        return 0;
+    }
+    fetch_stats.joined++;
+    return 1;
+}
+
+static int fetch_start(Fetch *f, const char *host, int port, const char *path) {
+    fetch_cancel(f);
+    f->received = 0;
+    f->body = NULL;
+    f->body_len = 0;
+    f->status = 0;
+    f->error[0] = '\0';
+    f->timed_out = 0;
+    f->retried = 0;
+    f->reused = 0;
+    f->saved_ms = 0;
+    f->started++;
+    f->t_start = f->t_phase = fetch_now_ms();
+
+    f->req_len = snprintf(f->request, sizeof(f->request),
+                          "GET %s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "User-Agent: Minix3-Weather/1.0\r\n%s\r\n",
+                          path, host, f->headers);
+    if (f->req_len >= (int)sizeof(f->request)) return fetch_fail(f, "request too long");
+    f->req_sent = 0;
+
+    snprintf(f->host, sizeof(f->host), "%s", host);
+    f->port = port;
+    f->dns = dns_lookup(host);
+    if (!f->dns) return fetch_fail(f, "resolver unavailable");
+
+    if (!dns_ready(f->dns)) {
+        f->state = FETCH_RESOLVING;
+        f->reported = 0;
+        fetch_deadline(f, FETCH_DNS);
+        return 1;
+    }
+    if (!fetch_resolved(f)) return 0;
+    f->reported = 0;
+    return 1;
+}
+
+// fd, который ждет запрос: pipe резолвера или сокет; -1 - ждать нечего
+static int fetch_fd(const Fetch *f) {
+    if (f->state == FETCH_RESOLVING) return f->dns->fd;
+    return f->conn ? f->conn->fd : -1;
+}
+
+// Маска для poll
+static short fetch_events(const Fetch *f) {
+    if (f->state == FETCH_RESOLVING) return POLLIN;
+    if (!f->conn) return 0;
+    if (!f->conn->connected || f->req_sent < f->req_len) return POLLOUT;
+    return POLLIN;
+}
+
+// Продвигает запрос (и его соединение - с ним и чужие запросы в очереди).
+// 1 - запрос завершился (DONE или FAILED), возвращается один раз.
+static int fetch_step(Fetch *f, short revents) {
+    if (f->state == FETCH_RESOLVING) {
+        // Резолвер мог уже дочитать другой запрос к тому же хосту
+        if (f->dns->pid > 0 && !dns_step(f->dns)) return 0;
+        if (!dns_ready(f->dns)) fetch_fail(f, "no such host");
+        else fetch_resolved(f);
+        revents = 0;
+    }
+
+    if (f->conn) conn_pump(f->conn, revents);
+
+    if (!fetch_busy(f) && !f->reported) {
+        f->reported = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Сколько poll может спать до ближайшего срока; -1 - запрос не ждет
+static int fetch_timeout_ms(const Fetch *f) {
+    if (!fetch_active(f)) return -1;
+    if (!fetch_busy(f)) return 0;   // завершен чужим fetch_step
+    double left = f->deadline - fetch_now_ms();
+    return left > 0 ? (int)left + 1 : 0;
+}
+
+// Срок вышел - запрос завершается ошибкой. 1 - запрос только что истек
+static int fetch_check_deadline(Fetch *f) {
+    if (!fetch_busy(f) || fetch_now_ms() < f->deadline) return 0;
+
+    int phase = FETCH_TOTAL;
+    if (f->state == FETCH_RESOLVING) phase = FETCH_DNS;
+    else if (f->state == FETCH_CONNECTING) phase = FETCH_CONNECT;
+    else if (f->state == FETCH_READING && f->received == 0) phase = FETCH_FIRST_BYTE;
+    if (fetch_now_ms() >= f->t_start + f->limits.ms[FETCH_TOTAL]) phase = FETCH_TOTAL;
+
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s timeout", fetch_phase_names[phase]);
+    fetch_stats.timeouts[phase]++;
+    f->timed_out = 1;
+    fetch_fail(f, msg);
+    f->reported = 1;
+    return 1;
+}
+
+// Синхронное ожидание для кода вне главного цикла, с теми же сроками. 1 - DONE
+static int fetch_wait(Fetch *f) {
+    while (fetch_active(f)) {
+        struct pollfd pfd;
+        pfd.fd = fetch_fd(f);
+        pfd.events = fetch_events(f);
+        pfd.revents = 0;
+        if (pfd.fd >= 0 && poll(&pfd, 1, fetch_timeout_ms(f)) < 0 && errno != EINTR) {
+            fetch_fail(f, "poll failed");
+            f->reported = 1;
+            break;
+        }
+        if (fetch_step(f, pfd.revents) || fetch_check_deadline(f)) break;
+    }
+    return f->state == FETCH_DONE;
+}
+
+// Оценка перцентиля по гистограмме: верхняя граница корзины
+static int fetch_percentile(int phase, double p) {
+    unsigned long need = (unsigned long)(fetch_stats.count[phase] * p + 0.5);
+    unsigned long seen = 0;
+    if (need == 0) need = 1;
+    for (int b = 0; b < FETCH_HIST_BUCKETS; b++) {
+        seen += fetch_stats.hist[phase][b];
+        if (seen >= need) return 1 << b;
+    }
+    return 1 << (FETCH_HIST_BUCKETS - 1);
+}
+
+static void fetch_report(FILE *out) {
+    fprintf(out, "HTTP phases (ms):      n      avg    p50<=   p99<=  timeouts\n");
+    for (int i = 0; i < FETCH_PHASES; i++) {
+        unsigned long n = fetch_stats.count[i];
+        fprintf(out, "  %-12s %10lu %8.1f %8d %7d %9lu\n",
+                fetch_phase_names[i], n, n ? fetch_stats.sum_ms[i] / n : 0.0,
+                n ? fetch_percentile(i, 0.50) : 0, n ? fetch_percentile(i, 0.99) : 0,
+                fetch_stats.timeouts[i]);
+    }
+    for (int i = 0; i < FETCH_PHASES; i++) {
+        if (fetch_stats.count[i] == 0) continue;
+        fprintf(out, "  %-12s", fetch_phase_names[i]);
+        for (int b = 0; b < FETCH_HIST_BUCKETS; b++) {
+            fprintf(out, " %lu", fetch_stats.hist[i][b]);
+        }
+        fprintf(out, "\n");
+    }
+
+    double handshake = fetch_stats.opened ? fetch_stats.connect_ms / fetch_stats.opened : 0;
+    fprintf(out, "Connections: %lu opened, %lu reused (%lu pipelined), %lu stale, "
+                 "%lu retries; handshake avg %.1f ms, ~%.1f ms saved\n",
+            fetch_stats.opened, fetch_stats.reused, fetch_stats.pipelined,
+            fetch_stats.stale, fetch_stats.retries, handshake,
+            handshake * fetch_stats.reused);
+    if (fetch_stats.joined) {
+        fprintf(out, "Duplicate requests suppressed: %lu (joined the one in flight)\n",
+                fetch_stats.joined);
+    }
+    dns_report(out);
+}
+
+#endif
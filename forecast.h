@@ -0,0 +1,91 @@
+#ifndef FORECAST_H
+#define FORECAST_H
+
+// Прогноз на 5 дней с шагом 3 часа (/data/2.5/forecast) в столбцах.
+// Каждая величина - непрерывный массив float на все точки прогноза:
+// графику нужна одна величина по всем точкам подряд, и она читается из
+// одного массива, а не выбирается из записей по точке. Время - часы от
+// t0 (float не держит Unix time с точностью до секунды).
+// Разбор потоковый (json.h): значения list[i].* раскладываются по
+// столбцам прямо в обратном вызове on_value, без промежуточных строк.
+// Тело ответа подается в парсер из forecast_init через json_sink.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+#define FORECAST_MAX 40     // 5 дней по 8 точек
+
+typedef struct {
+    int n;                          // точек (по наибольшему i в list)
+    long t0;                        // dt первой точки, Unix time
+    float hours[FORECAST_MAX];      // от t0
+    float temp[FORECAST_MAX];       // °C
+    float humidity[FORECAST_MAX];   // %
+    float precip[FORECAST_MAX];     // дождь + снег, мм за 3 ч
+    float pop[FORECAST_MAX];        // вероятность осадков, 0..1
+
+    int cod;                        // "200" приходит строкой
+    char message[80];               // текст ошибки API
+    char city[50];
+    unsigned long found;            // биты FC_*
+} Forecast;
+
+enum { FC_COD, FC_MESSAGE, FC_CITY, FC_COUNT };
+
+static const JsonField forecast_fields[FC_COUNT] = {
+    JSON_FIELD("cod",       JSON_F_INT,  Forecast, cod),
+    JSON_FIELD("message",   JSON_F_TEXT, Forecast, message),
+    JSON_FIELD("city.name", JSON_F_TEXT, Forecast, city),
+};
+
+// Элемент list[i]: имя поля после "list[i]." -> столбец
+static void forecast_value(JsonParser *p, int type, const char *value, int len, void *ctx) {
+    Forecast *fc = ctx;
+    (void)len;
+    if (type != JSON_NUMBER || p->path_len >= JSON_PATH_MAX ||
+        strncmp(p->path, "list[", 5) != 0) return;
+    char *end;
+    long i = strtol(p->path + 5, &end, 10);
+    if (*end != ']' || end[1] != '.' || i < 0 || i >= FORECAST_MAX) return;
+    const char *key = end + 2;
+    double x = strtod(value, NULL);
+
+    if (i >= fc->n) fc->n = i + 1;
+    if (strcmp(key, "dt") == 0) {
+        if (fc->t0 == 0) fc->t0 = (long)x;
+        fc->hours[i] = (float)((x - fc->t0) / 3600);
+    } else if (strcmp(key, "main.temp") == 0) {
+        fc->temp[i] = (float)(x - 273.15);
+    } else if (strcmp(key, "main.humidity") == 0) {
+        fc->humidity[i] = (float)x;
+    } else if (strcmp(key, "rain.3h") == 0 || strcmp(key, "snow.3h") == 0) {
+        fc->precip[i] += (float)x;
+    } else if (strcmp(key, "pop") == 0) {
+        fc->pop[i] = (float)x;
+    }
+}
+
+static void forecast_init(Forecast *fc, JsonParser *p) {
+    memset(fc, 0, sizeof(*fc));
+    json_init(p, forecast_fields, FC_COUNT, fc);
+    p->on_value = forecast_value;
+    p->ctx = fc;
+}
+
+// Тело кончилось. 1 - прогноз разобран и в нем есть точки
+static int forecast_finish(Forecast *fc, JsonParser *p) {
+    int ok = json_finish(p);
+    fc->found = p->found;
+    return ok && fc->cod == 200 && fc->n > 0;
+}
+
+static int forecast_parse(Forecast *fc, const char *text, long len) {
+    JsonParser p;
+    forecast_init(fc, &p);
+    json_feed(&p, text, len);
+    return forecast_finish(fc, &p);
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// История наблюдений: по файлу на город, только дописывание.
+// Файл - заголовок HistoryHeader и записи HistoryRecord фиксированного
+// размера в порядке времени наблюдения (dt из ответа API); запись с
+// временем не новее последней не пишется, так что повторный разбор того
+// же ответа (кэш, общий запрос панели) историю не дублирует. Запись
+// уходит одним write с O_APPEND; оборванный хвост (сбой посреди записи)
+// читатель не видит, а следующая запись его отрезает.
+//
+// Читается файл через mmap: записи отсортированы по времени, так что
+// диапазон [t0, t1) находится двумя двоичными поисками прямо по
+// отображению, без индекса в памяти и без чтения файла целиком.
+// history_downsample() сворачивает диапазон в корзины (мин/макс/среднее)
+// для графика шириной в сотни пикселей, history_summary() - итог по
+// диапазону. Сеть для всего этого не нужна.
+//
+// Файл - <id>.hist (id города OpenWeatherMap) или <имя>.hist, если id
+// нет, в HISTORY_DIR или $HOME/.cache/weather/history.
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HISTORY_MAGIC 0x31485357        // "WSH1"
+
+typedef struct {
+    unsigned magic;
+    unsigned record_size;               // sizeof(HistoryRecord) при создании
+    int id;                             // id города, 0 - нет
+    char name[52];                      // город, как его назвал API
+} HistoryHeader;                        // 64 байта
+
+typedef struct {
+    long long time;                     // dt наблюдения, Unix time
+    float temp;                         // °C
+    float feels_like;
+    float humidity;                     // %
+    unsigned flags;                     // пока 0
+} HistoryRecord;                        // 24 байта
+
+typedef struct {
+    int fd;
+    void *map;
+    size_t map_len;
+    const HistoryHeader *header;
+    const HistoryRecord *rec;
+    long n;                             // целых записей
+} HistoryMap;
+
+typedef struct {
+    float hours;                        // середина корзины, часы от начала диапазона
+    float min, max, avg;
+    int n;                              // записей; 0 - пустая корзина
+} HistoryBucket;
+
+typedef struct {
+    long n;
+    long long first, last;              // время первой и последней записи
+    float min, max, avg;
+    long long min_at, max_at;
+} HistorySummary;
+
+static struct {
+    char dir[256];
+    int ready;
+    unsigned long appended;
+    unsigned long duplicates;           // не новее последней - пропущены
+    unsigned long failed;
+} history;
+
+static void history_init(void) {
+    if (history.ready) return;
+    history.ready = 1;
+
+    const char *dir = getenv("HISTORY_DIR");
+    const char *home = getenv("HOME");
+    if (dir) {
+        snprintf(history.dir, sizeof(history.dir), "%s", dir);
+    } else if (home) {
+        snprintf(history.dir, sizeof(history.dir), "%s/.cache", home);
+        mkdir(history.dir, 0700);
+        snprintf(history.dir, sizeof(history.dir), "%s/.cache/weather", home);
+        mkdir(history.dir, 0700);
+        snprintf(history.dir, sizeof(history.dir), "%s/.cache/weather/history", home);
+    }
+    if (history.dir[0] && mkdir(history.dir, 0700) < 0 && errno != EEXIST) history.dir[0] = '\0';
+}
+
+// Имя файла: id, иначе имя города: латиница и цифры в нижнем регистре,
+// прочие байты - _xx (шестнадцатерично), так что "Москва" и "Рязань" не
+// сходятся в один файл. Длинное имя обрезается и получает хэш целиком
+#define HISTORY_KEY_CHARS 48
+
+static int history_path(char *out, int size, int id, const char *name) {
+    history_init();
+    if (!history.dir[0]) return 0;
+    if (id > 0) return snprintf(out, size, "%s/%d.hist", history.dir, id) < size;
+
+    char key[HISTORY_KEY_CHARS + 16];
+    int n = 0;
+    const unsigned char *s = (const unsigned char *)name;
+    for (; *s && n <= HISTORY_KEY_CHARS - 3; s++) {
+        if (isalnum(*s) && *s < 0x80) key[n++] = tolower(*s);
+        else n += sprintf(key + n, "_%02x", *s);
+    }
+    if (*s) {
+        unsigned h = 2166136261u;   // FNV-1a
+        for (s = (const unsigned char *)name; *s; s++) h = (h ^ *s) * 16777619u;
+        n += sprintf(key + n, "-%08x", h);
+    }
+    key[n] = '\0';
+    if (n == 0) return 0;
+    return snprintf(out, size, "%s/%s.hist", history.dir, key) < size;
+}
+
+// Дописать наблюдение. 1 - записано, 0 - не новее последнего или ошибка
+static int history_append(int id, const char *name, const HistoryRecord *r) {
+    char path[320];
+    if (!history_path(path, sizeof(path), id, name)) return 0;
+
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0600);
+    if (fd < 0) {
+        history.failed++;
+        return 0;
+    }
+    struct stat st;
+    HistoryHeader h;
+    int ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size < (off_t)sizeof(h)) {
+        memset(&h, 0, sizeof(h));
+        h.magic = HISTORY_MAGIC;
+        h.record_size = sizeof(HistoryRecord);
+        h.id = id;
+        snprintf(h.name, sizeof(h.name), "%s", name);
+        ok = ftruncate(fd, 0) == 0 && write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h);
+        st.st_size = sizeof(h);
+    } else if (ok) {
+        ok = pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+             h.magic == HISTORY_MAGIC && h.record_size == sizeof(HistoryRecord);
+    }
+
+    if (ok) {
+        long n = (st.st_size - sizeof(h)) / sizeof(HistoryRecord);
+        off_t end = sizeof(h) + (off_t)n * sizeof(HistoryRecord);
+        HistoryRecord last;
+        if (n > 0 && pread(fd, &last, sizeof(last), end - sizeof(last)) == (ssize_t)sizeof(last) &&
+            last.time >= r->time) {
+            history.duplicates++;
+            close(fd);
+            return 0;
+        }
+        // Хвост от оборванной записи отрезается
+        if (end != st.st_size && ftruncate(fd, end) != 0) ok = 0;
+        if (ok) ok = write(fd, r, sizeof(*r)) == (ssize_t)sizeof(*r);
+    }
+    close(fd);
+    if (ok) history.appended++;
+    else history.failed++;
+    return ok;
+}
+
+// Отображение закрыто и после неудачного open (map == NULL)
+static void history_close(HistoryMap *m) {
+    if (m->map) {
+        munmap(m->map, m->map_len);
+        close(m->fd);
+    }
+    memset(m, 0, sizeof(*m));
+}
+
+// Отобразить fd целиком (size байт). 1 - это файл истории
+static int history_remap(HistoryMap *m, int fd, size_t size) {
+    void *map = size >= sizeof(HistoryHeader) ?
+                mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    const HistoryHeader *h = map;
+    if (map == MAP_FAILED || h->magic != HISTORY_MAGIC || h->record_size != sizeof(HistoryRecord)) {
+        if (map != MAP_FAILED) munmap(map, size);
+        return 0;
+    }
+    m->fd = fd;
+    m->map = map;
+    m->map_len = size;
+    m->header = h;
+    m->rec = (const HistoryRecord *)((const char *)map + sizeof(HistoryHeader));
+    m->n = (size - sizeof(HistoryHeader)) / sizeof(HistoryRecord);
+    return 1;
+}
+
+static int history_map_file(HistoryMap *m, const char *path) {
+    history_close(m);
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) != 0 || !history_remap(m, fd, st.st_size)) {
+        close(fd);
+        return 0;
+    }
+    return 1;
+}
+
+// Файл вырос с прошлого отображения - отобразить заново
+static void history_sync(HistoryMap *m) {
+    struct stat st;
+    if (!m->map || fstat(m->fd, &st) != 0 || (size_t)st.st_size == m->map_len) return;
+    int fd = m->fd;
+    munmap(m->map, m->map_len);
+    m->map = NULL;
+    if (!history_remap(m, fd, st.st_size)) {
+        close(fd);
+        history_close(m);
+    }
+}
+
+// Отобразить историю города. 1 - есть
+static int history_open(HistoryMap *m, int id, const char *name) {
+    char path[320];
+    if (!history_path(path, sizeof(path), id, name)) {
+        history_close(m);
+        return 0;
+    }
+    return history_map_file(m, path);
+}
+
+// Город по имени из заголовков (без учета регистра) - для запросов без id
+static int history_find(HistoryMap *m, const char *name) {
+    history_init();
+    DIR *d = history.dir[0] ? opendir(history.dir) : NULL;
+    if (!d) return 0;
+    struct dirent *e;
+    char path[600];
+    int found = 0;
+    while (!found && (e = readdir(d)) != NULL) {
+        int len = strlen(e->d_name);
+        if (len < 6 || strcmp(e->d_name + len - 5, ".hist") != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", history.dir, e->d_name);
+        found = history_map_file(m, path) && strcasecmp(m->header->name, name) == 0;
+    }
+    closedir(d);
+    if (!found) history_close(m);
+    return found;
+}
+
+// Первая запись со временем >= t (n - таких нет), O(log n)
+static long history_lower_bound(const HistoryMap *m, long long t) {
+    long lo = 0, hi = m->n;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (m->rec[mid].time < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Записи с временем в [t0, t1): первая и число
+static long history_range(const HistoryMap *m, long long t0, long long t1, long *first) {
+    *first = history_lower_bound(m, t0);
+    return history_lower_bound(m, t1) - *first;
+}
+
+static void history_summary(const HistoryMap *m, long first, long count, HistorySummary *s) {
+    memset(s, 0, sizeof(*s));
+    if (count <= 0) return;
+    const HistoryRecord *r = m->rec + first;
+    double sum = 0;
+    s->n = count;
+    s->first = r[0].time;
+    s->last = r[count - 1].time;
+    s->min = s->max = r[0].temp;
+    s->min_at = s->max_at = r[0].time;
+    for (long i = 0; i < count; i++) {
+        sum += r[i].temp;
+        if (r[i].temp < s->min) {
+            s->min = r[i].temp;
+            s->min_at = r[i].time;
+        }
+        if (r[i].temp > s->max) {
+            s->max = r[i].temp;
+            s->max_at = r[i].time;
+        }
+    }
+    s->avg = (float)(sum / count);
+}
+
+// Температура за [t0, t1) в nb корзин равной длительности. Возвращает
+// число непустых корзин: пустые (пропуски в истории) не выдаются, и
+// out[] подряд годится для графика
+static int history_downsample(const HistoryMap *m, long long t0, long long t1,
+                              HistoryBucket *out, int nb) {
+    long first;
+    long count = history_range(m, t0, t1, &first);
+    if (nb <= 0 || t1 <= t0) return 0;
+    double width = (double)(t1 - t0) / nb;
+    int used = 0;
+    long i = first, end = first + count;
+    for (int b = 0; b < nb && i < end; b++) {
+        long long stop = t0 + (long long)((b + 1) * width);
+        if (b == nb - 1) stop = t1;
+        if (m->rec[i].time >= stop) continue;
+
+        HistoryBucket *k = &out[used++];
+        double sum = 0;
+        k->min = k->max = m->rec[i].temp;
+        k->n = 0;
+        for (; i < end && m->rec[i].time < stop; i++) {
+            float v = m->rec[i].temp;
+            if (v < k->min) k->min = v;
+            if (v > k->max) k->max = v;
+            sum += v;
+            k->n++;
+        }
+        k->avg = (float)(sum / k->n);
+        k->hours = (float)((b + 0.5) * width / 3600);
+    }
+    return used;
+}
+
+static void history_report(FILE *out) {
+    if (!history.appended && !history.duplicates && !history.failed) return;
+    fprintf(out, "History: %lu observations appended, %lu duplicates skipped, %lu failed\n",
+            history.appended, history.duplicates, history.failed);
+}
+
+#endif
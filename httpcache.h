@@ -0,0 +1,251 @@
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+// Кэш ответов HTTP на диске.
+// Ключ - хост, порт и путь запроса; значение appid (ключ API) в ключе
+// заменяется на "*", так что ключ не попадает на диск. Файл записи -
+// заголовок HttpCacheHeader и тело ответа; пишется во временный файл и
+// переименовывается, оборванная запись не портит старую.
+//
+// Запись свежая max_age секунд от сохранения (Cache-Control: max-age
+// сервера или HTTP_CACHE_TTL, по умолчанию 600) - ее отдают без сети.
+// Устаревшая не больше чем на HTTP_CACHE_MAX_STALE (сутки) показывается
+// сразу, а в фоне идет условный запрос с If-None-Match / If-Modified-Since:
+// 304 только продлевает запись, 200 заменяет ее.
+// Каталог - HTTP_CACHE_DIR или $HOME/.cache/weather.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "httpparse.h"
+
+#define HTTP_CACHE_MAX_STALE (24 * 3600)
+#define HTTP_CACHE_MAGIC "WHC1"
+
+typedef struct {
+    char magic[4];
+    long stored;            // time(), когда ответ получен или подтвержден
+    long max_age;           // секунд свежести
+    char etag[128];
+    char last_modified[64];
+    char key[256];          // полный ключ: защита от совпадения хэшей
+    long body_len;
+} HttpCacheHeader;
+
+typedef struct {
+    HttpCacheHeader h;
+    HttpBuffer body;
+} HttpCacheEntry;
+
+typedef struct {
+    char dir[256];
+    long ttl;
+    int ready;
+
+    unsigned long fresh;        // отдано без сети
+    unsigned long stale;        // показано устаревшим, ушла проверка
+    unsigned long misses;
+    unsigned long revalidated;  // 304 - тело не передавалось
+    unsigned long stored;
+    long bytes_saved;           // тел, не прошедших по сети
+} HttpCache;
+
+static HttpCache http_cache;
+
+static void http_cache_init(void) {
+    if (http_cache.ready) return;
+    http_cache.ready = 1;
+
+    const char *ttl = getenv("HTTP_CACHE_TTL");
+    http_cache.ttl = ttl ? atol(ttl) : 600;
+
+    // Не влезший в dir путь обрезался бы до чужого каталога - тогда без кэша
+    const char *dir = getenv("HTTP_CACHE_DIR");
+    int n;
+    if (dir) {
+        n = snprintf(http_cache.dir, sizeof(http_cache.dir), "%s", dir);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home) return;
+        char parent[sizeof(http_cache.dir) - sizeof("/weather") + 1];
+        if (snprintf(parent, sizeof(parent), "%s/.cache", home) >= (int)sizeof(parent)) return;
+        mkdir(parent, 0700);
+        n = snprintf(http_cache.dir, sizeof(http_cache.dir), "%s/weather", parent);
+    }
+    if (n >= (int)sizeof(http_cache.dir)) {
+        http_cache.dir[0] = '\0';
+        return;
+    }
+    if (mkdir(http_cache.dir, 0700) < 0 && errno != EEXIST) http_cache.dir[0] = '\0';
+}
+
+// Ключ записи: "host:port/path", значение appid заменено на "*"
+static void http_cache_key(char *out, int size, const char *host, int port, const char *path) {
+    int n = snprintf(out, size, "%s:%d", host, port);
+    const char *s = path;
+    while (*s && n < size - 1) {
+        if ((s == path || s[-1] == '?' || s[-1] == '&') && strncmp(s, "appid=", 6) == 0) {
+            n += snprintf(out + n, size - n, "appid=*");
+            s += 6;
+            while (*s && *s != '&') s++;
+            continue;
+        }
+        out[n++] = *s++;
+    }
+    out[n < size ? n : size - 1] = '\0';
+}
+
+// Имя файла записи - FNV-1a ключа
+static int http_cache_path(char *out, int size, const char *key) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (const unsigned char *s = (const unsigned char *)key; *s; s++) {
+        h = (h ^ *s) * 1099511628211ULL;
+    }
+    return snprintf(out, size, "%s/%016llx", http_cache.dir, h) < size;
+}
+
+static void http_cache_free(HttpCacheEntry *e) {
+    http_buffer_free(&e->body);
+}
+
+// Запись для ключа; 0 - нет или повреждена
+static int http_cache_load(const char *key, HttpCacheEntry *e) {
+    char path[300];
+    memset(e, 0, sizeof(*e));
+    http_cache_init();
+    if (!http_cache.dir[0] || !http_cache_path(path, sizeof(path), key)) return 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    int ok = fread(&e->h, sizeof(e->h), 1, f) == 1 &&
+             memcmp(e->h.magic, HTTP_CACHE_MAGIC, 4) == 0 &&
+             strcmp(e->h.key, key) == 0 &&
+             e->h.body_len >= 0 && e->h.body_len <= HTTP_BODY_MAX;
+    if (ok) {
+        char chunk[4096];
+        long left = e->h.body_len;
+        http_buffer_append(&e->body, "", 0);
+        while (ok && left > 0) {
+            long n = left < (long)sizeof(chunk) ? left : (long)sizeof(chunk);
+            ok = fread(chunk, 1, n, f) == (size_t)n && http_buffer_append(&e->body, chunk, n);
+            left -= n;
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        http_cache_free(e);
+        memset(e, 0, sizeof(*e));
+    }
+    return ok;
+}
+
+static long http_cache_age(const HttpCacheEntry *e) {
+    return time(NULL) - e->h.stored;
+}
+
+static int http_cache_fresh(const HttpCacheEntry *e) {
+    long age = http_cache_age(e);
+    return age >= 0 && age < e->h.max_age;
+}
+
+// Устаревшую запись еще можно показать, пока идет проверка
+static int http_cache_usable(const HttpCacheEntry *e) {
+    long age = http_cache_age(e);
+    return age >= 0 && age < e->h.max_age + HTTP_CACHE_MAX_STALE;
+}
+
+enum { HTTP_CACHE_MISS, HTTP_CACHE_FRESH, HTTP_CACHE_STALE };
+
+// Поиск с учетом срока. При MISS запись все равно может быть загружена
+// (слишком старая) - ее валидаторы годятся для условного запроса.
+// e освобождается вызывающим (http_cache_free)
+static int http_cache_lookup(const char *key, HttpCacheEntry *e) {
+    if (http_cache_load(key, e)) {
+        if (http_cache_fresh(e)) {
+            http_cache.fresh++;
+            http_cache.bytes_saved += e->h.body_len;
+            return HTTP_CACHE_FRESH;
+        }
+        if (http_cache_usable(e)) {
+            http_cache.stale++;
+            return HTTP_CACHE_STALE;
+        }
+    }
+    http_cache.misses++;
+    return HTTP_CACHE_MISS;
+}
+
+// Заголовки условного запроса (для fetch_set_headers)
+static void http_cache_validators(const HttpCacheEntry *e, char *out, int size) {
+    int n = 0;
+    out[0] = '\0';
+    if (e->h.etag[0]) {
+        n += snprintf(out + n, size - n, "If-None-Match: %s\r\n", e->h.etag);
+    }
+    if (e->h.last_modified[0] && n < size) {
+        snprintf(out + n, size - n, "If-Modified-Since: %s\r\n", e->h.last_modified);
+    }
+}
+
+static int http_cache_write(const HttpCacheEntry *e) {
+    char path[300], tmp[310];
+    if (!http_cache.dir[0] || !http_cache_path(path, sizeof(path), e->h.key)) return 0;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return 0;
+    int ok = fwrite(&e->h, sizeof(e->h), 1, f) == 1 &&
+             fwrite(e->body.data, 1, e->h.body_len, f) == (size_t)e->h.body_len;
+    ok = fclose(f) == 0 && ok;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+// Срок и валидаторы из заголовков ответа
+static void http_cache_validate(HttpCacheEntry *e, const HttpParser *p) {
+    e->h.stored = time(NULL);
+    e->h.max_age = p->max_age >= 0 ? p->max_age : http_cache.ttl;
+    if (p->etag[0]) snprintf(e->h.etag, sizeof(e->h.etag), "%s", p->etag);
+    if (p->last_modified[0]) snprintf(e->h.last_modified, sizeof(e->h.last_modified), "%s", p->last_modified);
+}
+
+// Ответ 200 с телом body - новая запись
+static int http_cache_store(const char *key, const HttpParser *p, const char *body, long len) {
+    HttpCacheEntry e;
+    http_cache_init();
+    if (p->no_store || strlen(key) >= sizeof(e.h.key)) return 0;
+
+    memset(&e, 0, sizeof(e));
+    memcpy(e.h.magic, HTTP_CACHE_MAGIC, 4);
+    snprintf(e.h.key, sizeof(e.h.key), "%s", key);
+    http_cache_validate(&e, p);
+    e.h.body_len = len;
+    e.body.data = (char *)body;
+    if (!http_cache_write(&e)) return 0;
+    http_cache.stored++;
+    return 1;
+}
+
+// Ответ 304: тело из записи по-прежнему верно, продлеваем срок
+static int http_cache_refresh(HttpCacheEntry *e, const HttpParser *p) {
+    http_cache_validate(e, p);
+    http_cache.revalidated++;
+    http_cache.bytes_saved += e->h.body_len;
+    return http_cache_write(e);
+}
+
+static void http_cache_report(FILE *out) {
+    unsigned long total = http_cache.fresh + http_cache.stale + http_cache.misses;
+    if (total == 0) return;
+    fprintf(out, "HTTP cache: %lu fresh hits, %lu stale served, %lu misses, "
+                 "%lu revalidated (304), %lu stored, %ld body bytes not fetched\n",
+            http_cache.fresh, http_cache.stale, http_cache.misses,
+            http_cache.revalidated, http_cache.stored, http_cache.bytes_saved);
+}
+
+#endif
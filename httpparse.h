@@ -0,0 +1,273 @@
+#ifndef HTTPPARSE_H
+#define HTTPPARSE_H
+
+// Потоковый разбор ответа HTTP/1.1.
+// http_feed() принимает байты кусками любого размера, как они пришли из
+// read(): строка статуса и заголовки - конечный автомат, строка может
+// оборваться на любом байте. Тело ограничивается Content-Length, chunked
+// кодированием или закрытием соединения (http_eof). Разбор останавливается
+// ровно на конце ответа - остаток куска принадлежит следующему ответу
+// конвейера.
+// Тело не копируется парсером: куски отдаются в sink (сигнатура как у
+// write callback в curl) прямо из буфера чтения. HttpBuffer - растущий
+// буфер со своим счетчиком, готовый sink для тех, кому нужно тело целиком.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define HTTP_LINE_MAX    1024   // длиннее - обрезается, разбор продолжается
+#define HTTP_HEADER_MAX  16384  // все заголовки ответа
+#define HTTP_BODY_MAX    (4L << 20)
+
+typedef size_t (*HttpSink)(void *ptr, size_t size, size_t nmemb, void *userdata);
+
+enum {
+    HTTP_STATUS_LINE,
+    HTTP_HEADER_LINE,
+    HTTP_BODY_LENGTH,
+    HTTP_BODY_CLOSE,        // тело до закрытия соединения
+    HTTP_CHUNK_SIZE,
+    HTTP_CHUNK_DATA,
+    HTTP_CHUNK_END,         // "\r\n" после данных куска
+    HTTP_TRAILER,
+    HTTP_DONE,
+    HTTP_ERROR
+};
+
+typedef struct {
+    int state;
+    char line[HTTP_LINE_MAX];
+    int line_len;
+    long header_bytes;
+
+    int status;
+    long content_length;    // -1 - не указан
+    int chunked;
+    int keep_alive;
+    long remaining;         // байт до конца тела или куска
+    long body_bytes;
+
+    // Для кэша ответов (httpcache.h)
+    char etag[128];
+    char last_modified[64];
+    long max_age;           // Cache-Control: max-age; -1 - не указан
+    int no_store;           // Cache-Control: no-store
+
+    HttpSink sink;
+    void *sink_ctx;
+    const char *error;
+} HttpParser;
+
+typedef struct {
+    char *data;             // всегда с '\0' в конце
+    long len;
+    long cap;
+} HttpBuffer;
+
+static int http_buffer_append(HttpBuffer *b, const void *data, long len) {
+    if (b->len + len + 1 > b->cap) {
+        long cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + len + 1) cap *= 2;
+        if (cap > HTTP_BODY_MAX + 1) return 0;
+        char *p = realloc(b->data, cap);
+        if (!p) return 0;
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return 1;
+}
+
+static size_t http_buffer_sink(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    return http_buffer_append(userdata, ptr, size * nmemb) ? size * nmemb : 0;
+}
+
+static void http_buffer_reset(HttpBuffer *b) {
+    b->len = 0;
+    if (b->data) b->data[0] = '\0';
+}
+
+static void http_buffer_free(HttpBuffer *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+static void http_parser_init(HttpParser *p, HttpSink sink, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->state = HTTP_STATUS_LINE;
+    p->content_length = -1;
+    p->max_age = -1;
+    p->sink = sink;
+    p->sink_ctx = ctx;
+}
+
+static int http_error(HttpParser *p, const char *what) {
+    p->state = HTTP_ERROR;
+    p->error = what;
+    return -1;
+}
+
+static int http_header(HttpParser *p, char *line) {
+    char *value = strchr(line, ':');
+    if (!value) return 1;       // мусорная строка заголовка - пропускаем
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Content-Length") == 0) {
+        p->content_length = atol(value);
+        if (p->content_length < 0) return 0;
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+        for (char *s = value; *s; s++) {
+            if (strncasecmp(s, "chunked", 7) == 0) p->chunked = 1;
+        }
+    } else if (strcasecmp(line, "Connection") == 0) {
+        for (char *s = value; *s; s++) {
+            if (strncasecmp(s, "close", 5) == 0) p->keep_alive = 0;
+            if (strncasecmp(s, "keep-alive", 10) == 0) p->keep_alive = 1;
+        }
+    } else if (strcasecmp(line, "ETag") == 0) {
+        snprintf(p->etag, sizeof(p->etag), "%s", value);
+    } else if (strcasecmp(line, "Last-Modified") == 0) {
+        snprintf(p->last_modified, sizeof(p->last_modified), "%s", value);
+    } else if (strcasecmp(line, "Cache-Control") == 0) {
+        for (char *s = value; *s; s++) {
+            if (strncasecmp(s, "max-age=", 8) == 0) p->max_age = atol(s + 8);
+            if (strncasecmp(s, "no-store", 8) == 0) p->no_store = 1;
+            if (strncasecmp(s, "no-cache", 8) == 0) p->max_age = 0;
+        }
+    }
+    return 1;
+}
+
+// Заголовки кончились - выбор способа чтения тела
+static void http_headers_done(HttpParser *p) {
+    if (p->status / 100 == 1) {
+        // Промежуточный ответ (100 Continue): настоящий идет следом
+        HttpSink sink = p->sink;
+        void *ctx = p->sink_ctx;
+        http_parser_init(p, sink, ctx);
+        return;
+    }
+    if (p->status == 204 || p->status == 304) {
+        p->state = HTTP_DONE;
+    } else if (p->chunked) {
+        p->state = HTTP_CHUNK_SIZE;
+    } else if (p->content_length >= 0) {
+        p->remaining = p->content_length;
+        p->state = p->remaining ? HTTP_BODY_LENGTH : HTTP_DONE;
+    } else {
+        p->keep_alive = 0;
+        p->state = HTTP_BODY_CLOSE;
+    }
+}
+
+// Полная строка в p->line (без "\r\n")
+static int http_line(HttpParser *p) {
+    char *line = p->line;
+
+    switch (p->state) {
+        case HTTP_STATUS_LINE: {
+            int minor;
+            if (sscanf(line, "HTTP/1.%d %d", &minor, &p->status) != 2) {
+                return http_error(p, "malformed status line");
+            }
+            p->keep_alive = minor >= 1;
+            p->state = HTTP_HEADER_LINE;
+            break;
+        }
+        case HTTP_HEADER_LINE:
+            if (*line == '\0') http_headers_done(p);
+            else if (!http_header(p, line)) return http_error(p, "bad header");
+            break;
+        case HTTP_CHUNK_SIZE: {
+            char *end;
+            p->remaining = strtol(line, &end, 16);
+            if (end == line || p->remaining < 0) return http_error(p, "bad chunk size");
+            p->state = p->remaining ? HTTP_CHUNK_DATA : HTTP_TRAILER;
+            break;
+        }
+        case HTTP_CHUNK_END:
+            if (*line != '\0') return http_error(p, "bad chunk end");
+            p->state = HTTP_CHUNK_SIZE;
+            break;
+        case HTTP_TRAILER:
+            if (*line == '\0') p->state = HTTP_DONE;
+            break;
+    }
+    return 0;
+}
+
+static int http_body(HttpParser *p, const char *data, long len) {
+    p->body_bytes += len;
+    if (p->body_bytes > HTTP_BODY_MAX) return http_error(p, "response too large");
+    if (p->sink && p->sink((void *)data, 1, len, p->sink_ctx) != (size_t)len) {
+        return http_error(p, "body rejected");
+    }
+    return 0;
+}
+
+// Разбор куска. Возвращает число использованных байт (меньше len, если
+// ответ кончился раньше куска) или -1 при ошибке (причина в p->error)
+static long http_feed(HttpParser *p, const char *data, long len) {
+    long i = 0;
+
+    while (i < len && p->state != HTTP_DONE) {
+        switch (p->state) {
+            case HTTP_ERROR:
+                return -1;
+
+            case HTTP_BODY_LENGTH:
+            case HTTP_CHUNK_DATA: {
+                long n = len - i < p->remaining ? len - i : p->remaining;
+                if (http_body(p, data + i, n) < 0) return -1;
+                i += n;
+                p->remaining -= n;
+                if (p->remaining == 0) {
+                    p->state = p->state == HTTP_CHUNK_DATA ? HTTP_CHUNK_END : HTTP_DONE;
+                }
+                break;
+            }
+
+            case HTTP_BODY_CLOSE:
+                if (http_body(p, data + i, len - i) < 0) return -1;
+                i = len;
+                break;
+
+            default: {
+                // Строчные состояния: копим до '\n'
+                const char *nl = memchr(data + i, '\n', len - i);
+                long n = nl ? nl - (data + i) : len - i;
+                long room = HTTP_LINE_MAX - 1 - p->line_len;
+                memcpy(p->line + p->line_len, data + i, n < room ? n : room);
+                p->line_len += n < room ? n : room;
+                i += n;
+
+                if (p->state == HTTP_STATUS_LINE || p->state == HTTP_HEADER_LINE) {
+                    p->header_bytes += n + (nl ? 1 : 0);
+                    if (p->header_bytes > HTTP_HEADER_MAX) return http_error(p, "headers too large");
+                }
+                if (!nl) break;
+
+                i++;    // '\n'
+                if (p->line_len > 0 && p->line[p->line_len - 1] == '\r') p->line_len--;
+                p->line[p->line_len] = '\0';
+                p->line_len = 0;
+                if (http_line(p) < 0) return -1;
+                break;
+            }
+        }
+    }
+    return p->state == HTTP_ERROR ? -1 : i;
+}
+
+// Соединение закрыто. 1 - ответ на этом полон
+static int http_eof(HttpParser *p) {
+    if (p->state == HTTP_BODY_CLOSE) p->state = HTTP_DONE;
+    return p->state == HTTP_DONE;
+}
+
+#endif
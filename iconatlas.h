@@ -0,0 +1,457 @@
+#ifndef ICONATLAS_H
+#define ICONATLAS_H
+
+// Встроенные иконки погоды.
+// Стандартные иконки OpenWeatherMap (01..50, день и ночь) собраны из
+// слоев-рисунков ниже, как cloud_xpm в weather.c: первая строка слоя -
+// "x y ширина высота" его места в клетке 50x50, дальше символы палитры,
+// '.' - прозрачно. При запуске все 18 иконок рисуются в один атлас
+// (ICON_ATLAS_COLS x 3 клетки) - один Pixmap с маской; иконка выводится
+// одним XCopyArea из своей клетки, без сети и декодера.
+// Клетка ищется по таблице icon_atlas_row (номер условия из кода) и
+// последней букве кода ('n' - ночная колонка).
+
+#include "iconcache.h"
+
+#define ICON_ATLAS_SIDE  50
+#define ICON_ATLAS_COLS  6
+#define ICON_ATLAS_ROWS  3
+#define ICON_ATLAS_CELLS (ICON_ATLAS_COLS * ICON_ATLAS_ROWS)
+
+static const struct {
+    char ch;
+    unsigned rgb;
+} icon_atlas_palette[] = {
+    { 'Y', 0xFFC83C }, { 'O', 0xFF9F1A },   // солнце и лучи
+    { 'M', 0xF2E6A0 }, { 'm', 0xD6C87A },   // луна
+    { 'W', 0xF4F6F8 }, { 'w', 0xD8DCE0 },   // облако, тень
+    { 'g', 0x9AA3AD }, { 'd', 0x6F7A86 },   // контуры
+    { 'D', 0x7F8A96 }, { 'k', 0x4A535D },   // грозовая туча
+    { 'B', 0x3C78E6 }, { 'L', 0xFFD21F },   // дождь, молния
+    { 'S', 0x7FB8F0 }, { 'F', 0xA9B2BC },   // снег, туман
+};
+
+static const char *const icon_art_sun[] = {
+    "5 5 40 40",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+    ".......O...........OO...........O.......",
+    "......OO...........OO...........OO......",
+    ".....OOOO......................OOOO.....",
+    ".......OOO....................OOO.......",
+    "........OOO......OOOOOO......OOO........",
+    ".........O....OOOOYYYYOOOO....O.........",
+    ".............OOYYYYYYYYYYOO.............",
+    "............OOYYYYYYYYYYYYOO............",
+    "...........OOYYYYYYYYYYYYYYOO...........",
+    "..........OOYYYYYYYYYYYYYYYYOO..........",
+    "..........OYYYYYYYYYYYYYYYYYYO..........",
+    "..........OYYYYYYYYYYYYYYYYYYO..........",
+    ".........OOYYYYYYYYYYYYYYYYYYOO.........",
+    ".........OYYYYYYYYYYYYYYYYYYYYO.........",
+    "OOOOOOO..OYYYYYYYYYYYYYYYYYYYYO..OOOOOOO",
+    "OOOOOOO..OYYYYYYYYYYYYYYYYYYYYO..OOOOOOO",
+    ".........OYYYYYYYYYYYYYYYYYYYYO.........",
+    ".........OOYYYYYYYYYYYYYYYYYYOO.........",
+    "..........OYYYYYYYYYYYYYYYYYYO..........",
+    "..........OYYYYYYYYYYYYYYYYYYO..........",
+    "..........OOYYYYYYYYYYYYYYYYOO..........",
+    "...........OOYYYYYYYYYYYYYYOO...........",
+    "............OOYYYYYYYYYYYYOO............",
+    ".............OOYYYYYYYYYYOO.............",
+    ".........O....OOOOYYYYOOOO....O.........",
+    "........OOO......OOOOOO......OOO........",
+    ".......OOO....................OOO.......",
+    ".....OOOO......................OOOO.....",
+    "......OO...........OO...........OO......",
+    ".......O...........OO...........O.......",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+    "...................OO...................",
+};
+
+static const char *const icon_art_sun_small[] = {
+    "3 2 30 30",
+    "..............OO..............",
+    "..............OO..............",
+    "..............OO..............",
+    "..............OO..............",
+    "....OO........OO........OO....",
+    "....OOO................OOO....",
+    ".....OOO..............OOO.....",
+    "......OO....OOOOOO....OO......",
+    "..........OOOYYYYOOO..........",
+    ".........OOYYYYYYYYOO.........",
+    "........OOYYYYYYYYYYOO........",
+    "........OYYYYYYYYYYYYO........",
+    ".......OOYYYYYYYYYYYYOO.......",
+    ".......OYYYYYYYYYYYYYYO.......",
+    "OOOOO..OYYYYYYYYYYYYYYO..OOOOO",
+    "OOOOO..OYYYYYYYYYYYYYYO..OOOOO",
+    ".......OYYYYYYYYYYYYYYO.......",
+    ".......OOYYYYYYYYYYYYOO.......",
+    "........OYYYYYYYYYYYYO........",
+    "........OOYYYYYYYYYYOO........",
+    ".........OOYYYYYYYYOO.........",
+    "..........OOOYYYYOOO..........",
+    "......OO....OOOOOO....OO......",
+    ".....OOO..............OOO.....",
+    "....OOO................OOO....",
+    "....OO........OO........OO....",
+    "..............OO..............",
+    "..............OO..............",
+    "..............OO..............",
+    "..............OO..............",
+};
+
+static const char *const icon_art_moon[] = {
+    "12 12 25 26",
+    ".........mmmm............",
+    ".......mmmmm.............",
+    ".....mmmMMmm.............",
+    "....mmMMMMm..............",
+    "...mmMMMMmm..............",
+    "..mmMMMMMm...............",
+    "..mMMMMMMm...............",
+    ".mmMMMMMmm...............",
+    ".mMMMMMMmm...............",
+    "mmMMMMMMmm...............",
+    "mmMMMMMMMm...............",
+    "mMMMMMMMMm...............",
+    "mMMMMMMMMmm..............",
+    "mMMMMMMMMMm..............",
+    "mMMMMMMMMMmm.............",
+    "mmMMMMMMMMMmm............",
+    "mmMMMMMMMMMMmm...........",
+    ".mMMMMMMMMMMMmm..........",
+    ".mmMMMMMMMMMMMmmm......mm",
+    "..mMMMMMMMMMMMMMmmmmmmmm.",
+    "..mmMMMMMMMMMMMMMMMMMMmm.",
+    "...mmMMMMMMMMMMMMMMMMmm..",
+    "....mmMMMMMMMMMMMMMMmm...",
+    ".....mmmMMMMMMMMMMmmm....",
+    ".......mmmmMMMMmmmm......",
+    ".........mmmmmmmm........",
+};
+
+static const char *const icon_art_moon_small[] = {
+    "9 8 17 18",
+    "......mmm........",
+    "....mmmm.........",
+    "...mmMmm.........",
+    "..mmMMm..........",
+    ".mmMMMm..........",
+    ".mMMMmm..........",
+    "mmMMMmm..........",
+    "mMMMMMm..........",
+    "mMMMMMm..........",
+    "mMMMMMmm.........",
+    "mMMMMMMm.........",
+    "mmMMMMMMm........",
+    ".mMMMMMMMmm......",
+    ".mmMMMMMMMmmmmmmm",
+    "..mmMMMMMMMMMMmm.",
+    "...mmMMMMMMMMmm..",
+    "....mmmMMMMmmm...",
+    "......mmmmmm.....",
+};
+
+static const char *const icon_art_cloud_back[] = {
+    "14 8 25 17",
+    "..........dddddd.........",
+    "........ddwwwwwwdd.......",
+    ".......dwwwwwwwwwdd......",
+    "......dwwwwwwwwwwwd......",
+    "......dwwwwwwwwwwwwd.....",
+    "....ddwwwwwwwwwwwwwd.....",
+    "..ddwwwwwwwwwwwwwwwwd....",
+    ".dwwwwwwwwwwwwwwwwwwwdd..",
+    ".dwwwwwwwwwwwwwwwwwwwwwd.",
+    "dwwwwwwwwwwwwwwwwwwwwwwwd",
+    "dwwwwwwwwwwwwwwwwwwwwwwwd",
+    "dwwwwwwwwwwwwwwwwwwwwwwwd",
+    "dwwwwwwwwwwwwwwwwwwwwwwwd",
+    ".dggggggggggggggggggggggd",
+    ".dgggggggggggggggggggggdd",
+    "..ddggggdddddddddgggggdd.",
+    "....ddddddddddddddddddd..",
+};
+
+static const char *const icon_art_cloud[] = {
+    "7 13 31 22",
+    "............ggggggg............",
+    "..........gggWWWWWggg..........",
+    ".........ggWWWWWWWWWgg.........",
+    "........gWWWWWWWWWWWWWg........",
+    ".......ggWWWWWWWWWWWWWgg.......",
+    ".......gWWWWWWWWWWWWWWWg.......",
+    "......ggWWWWWWWWWWWWWWWgg......",
+    "...ggggWWWWWWWWWWWWWWWWWg......",
+    "..ggWWWWWWWWWWWWWWWWWWWWWgg....",
+    ".gWWWWWWWWWWWWWWWWWWWWWWWWgg...",
+    "ggWWWWWWWWWWWWWWWWWWWWWWWWWWg..",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWg.",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWgg",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWWg",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWWg",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWWg",
+    "gWWWWWWWWWWWWWWWWWWWWWWWWWWWWWg",
+    "ggwwwwwwwwwwwwwwwwwwwwwwwwwwwgg",
+    ".gwwwwwwwwwwwwwwwwwwwwwwwwwwwg.",
+    "..ggwwwwwwwwwwwwwwwwwwwwwwwwg..",
+    "...gggggggggggggggggggwwwwgg...",
+    ".....................gggggg....",
+};
+
+static const char *const icon_art_cloud_dark[] = {
+    "7 10 31 22",
+    "............kkkkkkk............",
+    "..........kkkDDDDDkkk..........",
+    ".........kkDDDDDDDDDkk.........",
+    "........kDDDDDDDDDDDDDk........",
+    ".......kkDDDDDDDDDDDDDkk.......",
+    ".......kDDDDDDDDDDDDDDDk.......",
+    "......kkDDDDDDDDDDDDDDDkk......",
+    "...kkkkDDDDDDDDDDDDDDDDDk......",
+    "..kkDDDDDDDDDDDDDDDDDDDDDkk....",
+    ".kDDDDDDDDDDDDDDDDDDDDDDDDkk...",
+    "kkDDDDDDDDDDDDDDDDDDDDDDDDDDk..",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDk.",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDkk",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDDk",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDDk",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDDk",
+    "kDDDDDDDDDDDDDDDDDDDDDDDDDDDDDk",
+    "kkdddddddddddddddddddddddddddkk",
+    ".kdddddddddddddddddddddddddddk.",
+    "..kkddddddddddddddddddddddddk..",
+    "...kkkkkkkkkkkkkkkkkkkddddkk...",
+    ".....................kkkkkk....",
+};
+
+static const char *const icon_art_rain[] = {
+    "14 37 23 13",
+    ".BB..............BB....",
+    ".BB..............BB....",
+    "BB..............BB.....",
+    "BB.......BB.....BB.....",
+    ".........BB............",
+    "........BB.............",
+    "........BB...........BB",
+    ".....BB..............BB",
+    ".....BB.............BB.",
+    "....BB..............BB.",
+    "....BB.......BB........",
+    ".............BB........",
+    "............BB.........",
+};
+
+static const char *const icon_art_bolt[] = {
+    "19 30 11 20",
+    "........LLL",
+    ".......LLL.",
+    ".......LLL.",
+    "......LLL..",
+    ".....LLL...",
+    ".....LLL...",
+    "....LLL....",
+    "...LLL.....",
+    "..LLL......",
+    "..LLL......",
+    ".LLLLLLLL..",
+    ".....LLL...",
+    ".....LLL...",
+    "....LLL....",
+    "...LLL.....",
+    "...LLL.....",
+    "..LLL......",
+    ".LLL.......",
+    ".LLL.......",
+    "LLL........",
+};
+
+static const char *const icon_art_snow[] = {
+    "13 36 25 13",
+    "..S...................S..",
+    ".SSS.................SSS.",
+    "SSSSS...............SSSSS",
+    ".SSS........S........SSS.",
+    "..S........SSS........S..",
+    "..........SSSSS..........",
+    "...........SSS...........",
+    "............S............",
+    ".......S.........S.......",
+    "......SSS.......SSS......",
+    ".....SSSSS.....SSSSS.....",
+    "......SSS.......SSS......",
+    ".......S.........S.......",
+};
+
+static const char *const icon_art_mist[] = {
+    "8 14 34 27",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "..................................",
+    "..................................",
+    "..................................",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+    "..................................",
+    "..................................",
+    "..................................",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "..................................",
+    "..................................",
+    "..................................",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+    "..................................",
+    "..................................",
+    "..................................",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "FFFFFFFFFFFFFFFFFFFFFFFFFFFFF.....",
+    "..................................",
+    "..................................",
+    "..................................",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+    ".....FFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+};
+
+enum {
+    ICON_ART_SUN, ICON_ART_SUN_SMALL, ICON_ART_MOON, ICON_ART_MOON_SMALL,
+    ICON_ART_CLOUD_BACK, ICON_ART_CLOUD, ICON_ART_CLOUD_DARK,
+    ICON_ART_RAIN, ICON_ART_BOLT, ICON_ART_SNOW, ICON_ART_MIST,
+    ICON_ART_NONE = -1
+};
+
+static const char *const *const icon_art[] = {
+    icon_art_sun, icon_art_sun_small, icon_art_moon, icon_art_moon_small,
+    icon_art_cloud_back, icon_art_cloud, icon_art_cloud_dark,
+    icon_art_rain, icon_art_bolt, icon_art_snow, icon_art_mist,
+};
+
+// Иконка - до трех слоев снизу вверх; пары строк - день и ночь
+static const signed char icon_atlas_layers[ICON_ATLAS_CELLS][3] = {
+    { ICON_ART_SUN, ICON_ART_NONE, ICON_ART_NONE },                     // 01d ясно
+    { ICON_ART_MOON, ICON_ART_NONE, ICON_ART_NONE },                    // 01n
+    { ICON_ART_SUN_SMALL, ICON_ART_CLOUD, ICON_ART_NONE },              // 02d малооблачно
+    { ICON_ART_MOON_SMALL, ICON_ART_CLOUD, ICON_ART_NONE },             // 02n
+    { ICON_ART_CLOUD, ICON_ART_NONE, ICON_ART_NONE },                   // 03d облачно
+    { ICON_ART_CLOUD, ICON_ART_NONE, ICON_ART_NONE },                   // 03n
+    { ICON_ART_CLOUD_BACK, ICON_ART_CLOUD, ICON_ART_NONE },             // 04d пасмурно
+    { ICON_ART_CLOUD_BACK, ICON_ART_CLOUD, ICON_ART_NONE },             // 04n
+    { ICON_ART_CLOUD_BACK, ICON_ART_CLOUD, ICON_ART_RAIN },             // 09d ливень
+    { ICON_ART_CLOUD_BACK, ICON_ART_CLOUD, ICON_ART_RAIN },             // 09n
+    { ICON_ART_SUN_SMALL, ICON_ART_CLOUD, ICON_ART_RAIN },              // 10d дождь
+    { ICON_ART_MOON_SMALL, ICON_ART_CLOUD, ICON_ART_RAIN },             // 10n
+    { ICON_ART_CLOUD_DARK, ICON_ART_BOLT, ICON_ART_NONE },              // 11d гроза
+    { ICON_ART_CLOUD_DARK, ICON_ART_BOLT, ICON_ART_NONE },              // 11n
+    { ICON_ART_CLOUD, ICON_ART_SNOW, ICON_ART_NONE },                   // 13d снег
+    { ICON_ART_CLOUD, ICON_ART_SNOW, ICON_ART_NONE },                   // 13n
+    { ICON_ART_MIST, ICON_ART_NONE, ICON_ART_NONE },                    // 50d туман
+    { ICON_ART_MIST, ICON_ART_NONE, ICON_ART_NONE },                    // 50n
+};
+
+// Номер условия (первые две цифры кода) -> строка пар в icon_atlas_layers + 1;
+// 0 - такой иконки во встроенном наборе нет
+static const unsigned char icon_atlas_row[51] = {
+    [1] = 1, [2] = 2, [3] = 3, [4] = 4, [9] = 5, [10] = 6, [11] = 7, [13] = 8, [50] = 9,
+};
+
+typedef struct {
+    Pixmap img;
+    Pixmap mask;
+    int ready;
+
+    unsigned long hits;     // иконок, выданных из атласа
+    unsigned long misses;   // кодов, которых в атласе нет
+    double build_ms;
+} IconAtlas;
+
+// Клетка атласа для кода вида "10d"; -1 - нет такой
+static int icon_atlas_cell(const char *code) {
+    if (code[0] < '0' || code[0] > '9' || code[1] < '0' || code[1] > '9') return -1;
+    int cond = (code[0] - '0') * 10 + (code[1] - '0');
+    if (cond > 50 || !icon_atlas_row[cond] || (code[2] != 'd' && code[2] != 'n') || code[3]) return -1;
+    return (icon_atlas_row[cond] - 1) * 2 + (code[2] == 'n');
+}
+
+static unsigned icon_atlas_color(char ch) {
+    for (int i = 0; i < (int)(sizeof(icon_atlas_palette) / sizeof(icon_atlas_palette[0])); i++) {
+        if (icon_atlas_palette[i].ch == ch) return 0xFF000000 | icon_atlas_palette[i].rgb;
+    }
+    return 0;
+}
+
+// Слой art в клетку с левым верхним углом (cx, cy)
+static void icon_atlas_paint(IconPixels *px, const char *const *art, int cx, int cy) {
+    int x0, y0, w, h;
+    if (sscanf(art[0], "%d %d %d %d", &x0, &y0, &w, &h) != 4) return;
+    for (int y = 0; y < h && y0 + y < ICON_ATLAS_SIDE; y++) {
+        const char *row = art[1 + y];
+        unsigned *out = px->argb + (long)(cy + y0 + y) * px->w + cx + x0;
+        for (int x = 0; x < w && row[x] && x0 + x < ICON_ATLAS_SIDE; x++) {
+            if (row[x] != '.') out[x] = icon_atlas_color(row[x]);
+        }
+    }
+}
+
+// Сборка атласа: пиксели всех иконок -> один Pixmap с маской (фон окна -
+// как у кэша c)
+static int icon_atlas_build(IconAtlas *a, IconCache *c) {
+    double start = icon_now_ms();
+    IconPixels px;
+
+    memset(a, 0, sizeof(*a));
+    px.w = ICON_ATLAS_COLS * ICON_ATLAS_SIDE;
+    px.h = ICON_ATLAS_ROWS * ICON_ATLAS_SIDE;
+    px.argb = calloc((size_t)px.w * px.h, sizeof(unsigned));     // прозрачный
+    if (!px.argb) return 0;
+
+    for (int cell = 0; cell < ICON_ATLAS_CELLS; cell++) {
+        int cx = cell % ICON_ATLAS_COLS * ICON_ATLAS_SIDE;
+        int cy = cell / ICON_ATLAS_COLS * ICON_ATLAS_SIDE;
+        for (int i = 0; i < 3 && icon_atlas_layers[cell][i] != ICON_ART_NONE; i++) {
+            icon_atlas_paint(&px, icon_art[(int)icon_atlas_layers[cell][i]], cx, cy);
+        }
+    }
+
+    a->ready = icon_make_pixmaps(c, &px, &a->img, &a->mask);
+    icon_pixels_free(&px);
+    a->build_ms = icon_now_ms() - start;
+    return a->ready;
+}
+
+// Место иконки в атласе; 0 - ее там нет
+static int icon_atlas_lookup(IconAtlas *a, const char *code, int *x, int *y) {
+    int cell = a->ready ? icon_atlas_cell(code) : -1;
+    if (cell < 0) {
+        a->misses++;
+        return 0;
+    }
+    *x = cell % ICON_ATLAS_COLS * ICON_ATLAS_SIDE;
+    *y = cell / ICON_ATLAS_COLS * ICON_ATLAS_SIDE;
+    a->hits++;
+    return 1;
+}
+
+static void icon_atlas_free(IconAtlas *a, Display *dpy) {
+    if (a->ready) {
+        XFreePixmap(dpy, a->img);
+        XFreePixmap(dpy, a->mask);
+    }
+    a->ready = 0;
+}
+
+static void icon_atlas_report(const IconAtlas *a) {
+    printf("Icon atlas: %d built-in icons in %.2f ms, %lu shown, %lu codes not built in\n",
+           a->ready ? ICON_ATLAS_CELLS : 0, a->build_ms, a->hits, a->misses);
+}
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+// Кэш иконок погоды.
+// В памяти - готовые Pixmap и маска прозрачности на ICON_CACHE_SLOTS
+// кодов (у OpenWeatherMap их около 18); при нехватке вытесняется иконка,
+// которую дольше всех не показывали. На диске - декодированные пиксели
+// ARGB каждой иконки (icon-<код>.argb в ICON_CACHE_DIR или
+// $HOME/.cache/weather/icons): после перезапуска повторная иконка не
+// скачивается и не декодируется, остается один XPutImage.
+// Полупрозрачные пиксели заранее смешиваются с фоном окна, маска -
+// однобитная (альфа >= 128).
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define ICON_CACHE_SLOTS 18
+#define ICON_MAX_SIDE    256
+#define ICON_FILE_MAGIC  0x31434957     // "WIC1"
+
+typedef struct {
+    int w, h;
+    unsigned *argb;         // w * h, 0xAARRGGBB
+} IconPixels;
+
+typedef struct {
+    char code[8];
+    Pixmap img;
+    Pixmap mask;
+    int w, h;
+    unsigned long used;     // такт последней выдачи
+} IconSlot;
+
+typedef struct {
+    Display *dpy;
+    Drawable drawable;
+    unsigned long background;   // 0xRRGGBB фона под иконкой
+    GC mask_gc;                 // для однобитных Pixmap
+
+    IconSlot slots[ICON_CACHE_SLOTS];
+    int count;
+    unsigned long tick;
+    char dir[256];
+
+    unsigned long hits;         // Pixmap из памяти
+    unsigned long disk_hits;    // пиксели с диска, без сети и декодера
+    unsigned long decoded;      // скачано и декодировано
+    unsigned long evictions;
+    double decode_ms;
+} IconCache;
+
+static double icon_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void icon_cache_init(IconCache *c, Display *dpy, Drawable drawable, unsigned long background) {
+    memset(c, 0, sizeof(*c));
+    c->dpy = dpy;
+    c->drawable = drawable;
+    c->background = background;
+
+    const char *dir = getenv("ICON_CACHE_DIR");
+    const char *home = getenv("HOME");
+    if (dir) {
+        snprintf(c->dir, sizeof(c->dir), "%s", dir);
+    } else if (home) {
+        snprintf(c->dir, sizeof(c->dir), "%s/.cache", home);
+        mkdir(c->dir, 0700);
+        snprintf(c->dir, sizeof(c->dir), "%s/.cache/weather", home);
+        mkdir(c->dir, 0700);
+        snprintf(c->dir, sizeof(c->dir), "%s/.cache/weather/icons", home);
+    }
+    if (c->dir[0] && mkdir(c->dir, 0700) < 0 && errno != EEXIST) c->dir[0] = '\0';
+}
+
+static void icon_pixels_free(IconPixels *px) {
+    free(px->argb);
+    memset(px, 0, sizeof(*px));
+}
+
+static int icon_pixels_alloc(IconPixels *px, int w, int h) {
+    memset(px, 0, sizeof(*px));
+    if (w <= 0 || h <= 0 || w > ICON_MAX_SIDE || h > ICON_MAX_SIDE) return 0;
+    px->argb = calloc((size_t)w * h, sizeof(unsigned));
+    if (!px->argb) return 0;
+    px->w = w;
+    px->h = h;
+    return 1;
+}
+
+// Код иконки - две цифры и буква; все прочее в имя файла не попадает
+static int icon_file(const IconCache *c, const char *code, char *out, int size) {
+    if (!c->dir[0]) return 0;
+    for (const char *s = code; *s; s++) {
+        if (!((*s >= '0' && *s <= '9') || (*s >= 'a' && *s <= 'z'))) return 0;
+    }
+    return snprintf(out, size, "%s/icon-%s.argb", c->dir, code) < size;
+}
+
+static int icon_disk_read(IconCache *c, const char *code, IconPixels *px) {
+    char path[300];
+    int head[3];
+    if (!icon_file(c, code, path, sizeof(path))) return 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    int ok = fread(head, sizeof(head), 1, f) == 1 && head[0] == ICON_FILE_MAGIC &&
+             icon_pixels_alloc(px, head[1], head[2]) &&
+             fread(px->argb, sizeof(unsigned), (size_t)px->w * px->h, f) == (size_t)px->w * px->h;
+    fclose(f);
+    if (!ok) icon_pixels_free(px);
+    return ok;
+}
+
+static void icon_disk_write(IconCache *c, const char *code, const IconPixels *px) {
+    char path[300], tmp[310];
+    int head[3] = { ICON_FILE_MAGIC, px->w, px->h };
+    if (!icon_file(c, code, path, sizeof(path))) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return;
+    int ok = fwrite(head, sizeof(head), 1, f) == 1 &&
+             fwrite(px->argb, sizeof(unsigned), (size_t)px->w * px->h, f) == (size_t)px->w * px->h;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) remove(tmp);
+}
+
+// Позиция и ширина поля цвета в маске визуала TrueColor
+static void icon_mask_shift(unsigned long mask, int *shift, int *bits) {
+    *shift = 0;
+    *bits = 0;
+    if (!mask) return;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        (*shift)++;
+    }
+    while (mask & 1) {
+        mask >>= 1;
+        (*bits)++;
+    }
+}
+
+static unsigned long icon_channel(unsigned v, int shift, int bits) {
+    if (bits < 8) v >>= 8 - bits;
+    else v <<= bits - 8;
+    return (unsigned long)v << shift;
+}
+
+// Pixmap и маска из пикселей (фон смешивается заранее).
+// На обычном 24/32-битном TrueColor (0xRRGGBB в 32-битном слове, порядок
+// байт как у клиента) строки пишутся прямо в данные XImage; иначе -
+// XPutPixel с раскладкой по маскам визуала
+static int icon_make_pixmaps(IconCache *c, const IconPixels *px, Pixmap *img, Pixmap *mask) {
+    Display *dpy = c->dpy;
+    int scr = DefaultScreen(dpy);
+    Visual *vis = DefaultVisual(dpy, scr);
+    int depth = DefaultDepth(dpy, scr);
+    int truecolor = vis->class == TrueColor || vis->class == DirectColor;
+    int shift[3], width[3];
+    icon_mask_shift(vis->red_mask, &shift[0], &width[0]);
+    icon_mask_shift(vis->green_mask, &shift[1], &width[1]);
+    icon_mask_shift(vis->blue_mask, &shift[2], &width[2]);
+
+    XImage *im = XCreateImage(dpy, vis, depth, ZPixmap, 0, NULL, px->w, px->h, 32, 0);
+    XImage *mk = XCreateImage(dpy, vis, 1, XYBitmap, 0, NULL, px->w, px->h, 8, 0);
+    if (!im || !mk) {
+        if (im) XDestroyImage(im);
+        if (mk) XDestroyImage(mk);
+        return 0;
+    }
+    im->data = malloc((size_t)im->bytes_per_line * px->h);
+    mk->data = calloc((size_t)mk->bytes_per_line * px->h, 1);
+    if (!im->data || !mk->data) {
+        XDestroyImage(im);
+        XDestroyImage(mk);
+        return 0;
+    }
+
+    unsigned one = 1;
+    int host_lsb = *(unsigned char *)&one == 1;
+    int direct = truecolor && im->bits_per_pixel == 32 &&
+                 im->byte_order == (host_lsb ? LSBFirst : MSBFirst) &&
+                 vis->red_mask == 0xFF0000 && vis->green_mask == 0xFF00 && vis->blue_mask == 0xFF;
+    int mask_lsb = mk->bitmap_bit_order == LSBFirst;
+
+    unsigned br = c->background >> 16 & 0xFF, bg = c->background >> 8 & 0xFF, bb = c->background & 0xFF;
+    for (int y = 0; y < px->h; y++) {
+        const unsigned *src = px->argb + (long)y * px->w;
+        unsigned *row = (unsigned *)(im->data + (long)y * im->bytes_per_line);
+        unsigned char *bits = (unsigned char *)mk->data + (long)y * mk->bytes_per_line;
+        for (int x = 0; x < px->w; x++) {
+            unsigned p = src[x];
+            unsigned a = p >> 24;
+            unsigned r, g, b;
+            if (a == 255) {
+                r = p >> 16 & 0xFF;
+                g = p >> 8 & 0xFF;
+                b = p & 0xFF;
+            } else {
+                r = ((p >> 16 & 0xFF) * a + br * (255 - a)) / 255;
+                g = ((p >> 8 & 0xFF) * a + bg * (255 - a)) / 255;
+                b = ((p & 0xFF) * a + bb * (255 - a)) / 255;
+            }
+            if (a >= 128) bits[x >> 3] |= mask_lsb ? 1 << (x & 7) : 0x80 >> (x & 7);
+
+            if (direct) {
+                row[x] = r << 16 | g << 8 | b;
+            } else if (truecolor) {
+                XPutPixel(im, x, y, icon_channel(r, shift[0], width[0]) |
+                                    icon_channel(g, shift[1], width[1]) |
+                                    icon_channel(b, shift[2], width[2]));
+            } else {
+                XPutPixel(im, x, y, r * 3 + g * 6 + b < 1280 ? BlackPixel(dpy, scr) : WhitePixel(dpy, scr));
+            }
+        }
+    }
+
+    *img = XCreatePixmap(dpy, c->drawable, px->w, px->h, depth);
+    *mask = XCreatePixmap(dpy, c->drawable, px->w, px->h, 1);
+    if (!c->mask_gc) {
+        // XYBitmap рисуется так: 1 - foreground, 0 - background. По умолчанию
+        // у GC наоборот (0 и 1), и маска вышла бы инвертированной
+        c->mask_gc = XCreateGC(dpy, *mask, 0, NULL);
+        XSetForeground(dpy, c->mask_gc, 1);
+        XSetBackground(dpy, c->mask_gc, 0);
+    }
+    XPutImage(dpy, *img, DefaultGC(dpy, scr), im, 0, 0, 0, 0, px->w, px->h);
+    XPutImage(dpy, *mask, c->mask_gc, mk, 0, 0, 0, 0, px->w, px->h);
+    XDestroyImage(im);
+    XDestroyImage(mk);
+    return 1;
+}
+
+// Иконка из памяти; NULL - ее там нет
+static IconSlot *icon_cache_get(IconCache *c, const char *code) {
+    for (int i = 0; i < c->count; i++) {
+        if (strcmp(c->slots[i].code, code) == 0) {
+            c->slots[i].used = ++c->tick;
+            c->hits++;
+            return &c->slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Пиксели иконки -> Pixmap в памяти (вытесняя давно не показанную)
+static IconSlot *icon_cache_put(IconCache *c, const char *code, const IconPixels *px) {
+    IconSlot *s;
+    if (c->count < ICON_CACHE_SLOTS) {
+        s = &c->slots[c->count++];
+    } else {
+        s = &c->slots[0];
+        for (int i = 1; i < c->count; i++) {
+            if (c->slots[i].used < s->used) s = &c->slots[i];
+        }
+        XFreePixmap(c->dpy, s->img);
+        XFreePixmap(c->dpy, s->mask);
+        c->evictions++;
+    }
+
+    memset(s, 0, sizeof(*s));
+    if (!icon_make_pixmaps(c, px, &s->img, &s->mask)) {
+        *s = c->slots[--c->count];  // слот снова свободен
+        return NULL;
+    }
+    snprintf(s->code, sizeof(s->code), "%.7s", code);   // коды иконок - "04d", длиннее не бывает
+    s->w = px->w;
+    s->h = px->h;
+    s->used = ++c->tick;
+    return s;
+}
+
+static void icon_cache_free(IconCache *c) {
+    for (int i = 0; i < c->count; i++) {
+        XFreePixmap(c->dpy, c->slots[i].img);
+        XFreePixmap(c->dpy, c->slots[i].mask);
+    }
+    if (c->mask_gc) XFreeGC(c->dpy, c->mask_gc);
+    c->count = 0;
+    c->mask_gc = NULL;
+}
+
+static void icon_cache_report(const IconCache *c) {
+    printf("Icon cache: %lu memory hits, %lu disk hits, %lu downloaded+decoded "
+           "(avg %.2f ms), %lu evictions\n",
+           c->hits, c->disk_hits, c->decoded,
+           c->decoded ? c->decode_ms / c->decoded : 0.0, c->evictions);
+}
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef JSON_H
+#define JSON_H
+
+// Однопроходный потоковый разбор JSON (SAX).
+// json_feed() принимает текст кусками любого размера - прямо из sink'а
+// HTTP (json_sink), без сборки тела целиком. Лексема может оборваться на
+// любом байте: состояние лексера и незаконченная лексема живут в парсере.
+// Памяти парсер не выделяет: стек вложенности, путь и лексема - массивы
+// фиксированного размера.
+//
+// Каждое скалярное значение получает путь от корня: "main.temp",
+// "weather[0].description", "list[3].dt". Значения, чьи пути есть в
+// таблице JsonField, пишутся в поля структуры (base + offset) нужного
+// типа, первое вхождение выигрывает; ключ во вложенном объекте с тем же
+// именем другой путь и не совпадет. Остальные значения, если нужно,
+// получает обратный вызов on_value.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_DEPTH      16
+#define JSON_PATH_MAX   128     // длиннее - значение не сопоставляется
+#define JSON_TOKEN_MAX  256     // длиннее - строка обрезается
+#define JSON_MAX_FIELDS 32      // биты в found
+
+// Тип значения (для on_value)
+enum { JSON_STRING, JSON_NUMBER, JSON_TRUE, JSON_FALSE, JSON_NULL };
+
+// Тип поля назначения
+enum {
+    JSON_F_DOUBLE,      // double
+    JSON_F_INT,         // int; числа в строках ("404") тоже
+    JSON_F_TEXT         // char[size], обрезается; число копируется как текст
+};
+
+typedef struct {
+    const char *path;
+    int type;
+    size_t offset;
+    size_t size;
+} JsonField;
+
+#define JSON_FIELD(path, type, st, member) \
+    { path, type, offsetof(st, member), sizeof(((st *)0)->member) }
+
+struct JsonParser;
+typedef void (*JsonValueFn)(struct JsonParser *p, int type,
+                            const char *value, int len, void *ctx);
+
+enum {
+    JSON_LEX_NONE,
+    JSON_LEX_STRING,
+    JSON_LEX_ESCAPE,        // после '\'
+    JSON_LEX_UNICODE,       // цифры \uXXXX
+    JSON_LEX_NUMBER,
+    JSON_LEX_LITERAL        // true / false / null
+};
+
+enum {
+    JSON_EXPECT_VALUE,
+    JSON_EXPECT_KEY,
+    JSON_EXPECT_COLON,
+    JSON_EXPECT_COMMA,      // ',' или закрывающая скобка
+    JSON_EXPECT_END         // корневое значение закончилось
+};
+
+typedef struct JsonParser {
+    const JsonField *fields;
+    int nfields;
+    unsigned char field_len[JSON_MAX_FIELDS];   // strlen(path), для быстрого отсева
+    unsigned long long len_mask;                // бит (длина % 64) есть у какого-то поля
+    void *base;
+    unsigned long found;    // бит i - поле fields[i] заполнено
+    JsonValueFn on_value;
+    void *ctx;
+
+    int lex;
+    char token[JSON_TOKEN_MAX];
+    int token_len;
+    unsigned unicode;       // собираемый \uXXXX
+    int unicode_digits;
+    unsigned surrogate;     // старшая половина суррогатной пары
+
+    int expect;
+    int empty_ok;           // сразу после '{' или '[' - можно закрыть
+    int depth;
+    char stack[JSON_DEPTH + 1];     // '{' или '['
+    int index[JSON_DEPTH + 1];      // номер элемента массива
+    int base_len[JSON_DEPTH + 1];   // длина пути контейнера
+    char path[JSON_PATH_MAX];
+    int path_len;                   // JSON_PATH_MAX - путь не поместился
+
+    long bytes;
+    const char *error;
+} JsonParser;
+
+static void json_init(JsonParser *p, const JsonField *fields, int nfields, void *base) {
+    memset(p, 0, sizeof(*p));
+    p->fields = fields;
+    p->nfields = nfields < JSON_MAX_FIELDS ? nfields : JSON_MAX_FIELDS;
+    p->base = base;
+    p->expect = JSON_EXPECT_VALUE;
+    for (int i = 0; i < p->nfields; i++) {
+        size_t n = strlen(fields[i].path);
+        p->field_len[i] = n < JSON_PATH_MAX ? n : 0;
+        p->len_mask |= 1ULL << (p->field_len[i] % 64);
+    }
+}
+
+static int json_found(const JsonParser *p, int field) {
+    return (p->found >> field) & 1;
+}
+
+static int json_error(JsonParser *p, const char *what) {
+    p->error = what;
+    return -1;
+}
+
+// Путь текущего значения: путь контейнера + ".key" или "[i]"
+static void json_path_key(JsonParser *p, const char *key, int len) {
+    int base = p->base_len[p->depth];
+    int dot = base > 0;
+    if (base + dot + len >= JSON_PATH_MAX) {
+        p->path_len = JSON_PATH_MAX;
+        return;
+    }
+    char *s = p->path + base;
+    if (dot) *s++ = '.';
+    for (int i = 0; i < len; i++) *s++ = key[i];
+    *s = '\0';
+    p->path_len = s - p->path;
+}
+
+static void json_path_index(JsonParser *p) {
+    int base = p->base_len[p->depth];
+    char digits[16];
+    int n = 0;
+    unsigned i = p->index[p->depth];
+    do {
+        digits[n++] = '0' + i % 10;
+        i /= 10;
+    } while (i);
+
+    if (base + n + 2 >= JSON_PATH_MAX) {
+        p->path_len = JSON_PATH_MAX;
+        return;
+    }
+    char *s = p->path + base;
+    *s++ = '[';
+    while (n) *s++ = digits[--n];
+    *s++ = ']';
+    *s = '\0';
+    p->path_len = s - p->path;
+}
+
+static void json_store(JsonParser *p, const JsonField *f, int type, const char *value, int len) {
+    char *dest = (char *)p->base + f->offset;
+
+    switch (f->type) {
+        case JSON_F_DOUBLE:
+            *(double *)dest = strtod(value, NULL);
+            break;
+        case JSON_F_INT:
+            *(int *)dest = type == JSON_TRUE ? 1 :
+                           type == JSON_FALSE ? 0 : (int)strtod(value, NULL);
+            break;
+        case JSON_F_TEXT: {
+            int n = len < (int)f->size - 1 ? len : (int)f->size - 1;
+            memcpy(dest, value, n);
+            dest[n] = '\0';
+            break;
+        }
+    }
+}
+
+// Значение с путем path - в поле таблицы p, если такое есть и еще не
+// заполнено. json_value зовет ее с путем от корня; on_value может звать
+// для другого парсера с путем внутри элемента массива ("list[3].main.temp"
+// -> "main.temp"), чтобы разбирать элементы той же таблицей полей.
+// 1 - поле заполнено
+static int json_match(JsonParser *p, const char *path, int path_len,
+                      int type, const char *value, int len) {
+    if (path_len >= JSON_PATH_MAX || type == JSON_NULL ||
+        !(p->len_mask >> (path_len % 64) & 1)) return 0;
+    for (int i = 0; i < p->nfields; i++) {
+        if (p->field_len[i] != path_len || json_found(p, i) ||
+            memcmp(p->fields[i].path, path, path_len) != 0) continue;
+        json_store(p, &p->fields[i], type, value, len);
+        p->found |= 1UL << i;
+        return 1;
+    }
+    return 0;
+}
+
+// Скалярное значение готово (value завершено '\0')
+static void json_value(JsonParser *p, int type, const char *value, int len) {
+    json_match(p, p->path, p->path_len, type, value, len);
+    if (p->on_value) p->on_value(p, type, value, len, p->ctx);
+}
+
+static void json_token_put(JsonParser *p, char c) {
+    if (p->token_len < JSON_TOKEN_MAX - 1) p->token[p->token_len++] = c;
+}
+
+static void json_token_utf8(JsonParser *p, unsigned cp) {
+    if (cp < 0x80) {
+        json_token_put(p, cp);
+    } else if (cp < 0x800) {
+        json_token_put(p, 0xC0 | (cp >> 6));
+        json_token_put(p, 0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        json_token_put(p, 0xE0 | (cp >> 12));
+        json_token_put(p, 0x80 | ((cp >> 6) & 0x3F));
+        json_token_put(p, 0x80 | (cp & 0x3F));
+    } else {
+        json_token_put(p, 0xF0 | (cp >> 18));
+        json_token_put(p, 0x80 | ((cp >> 12) & 0x3F));
+        json_token_put(p, 0x80 | ((cp >> 6) & 0x3F));
+        json_token_put(p, 0x80 | (cp & 0x3F));
+    }
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? без strtod на каждое число
+static int json_number_ok(const char *s) {
+    if (*s == '-') s++;
+    if (*s == '0') s++;
+    else if (*s >= '1' && *s <= '9') while (*s >= '0' && *s <= '9') s++;
+    else return 0;
+    if (*s == '.') {
+        s++;
+        if (*s < '0' || *s > '9') return 0;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        if (*s == '+' || *s == '-') s++;
+        if (*s < '0' || *s > '9') return 0;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    return *s == '\0';
+}
+
+static int json_word_char(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           c == '.' || c == '-' || c == '+' || c == 'E';
+}
+
+// Значение (скаляр или контейнер) закончилось
+static void json_after_value(JsonParser *p) {
+    p->expect = p->depth ? JSON_EXPECT_COMMA : JSON_EXPECT_END;
+}
+
+// Лексема-строка или число/литерал дочитаны
+static int json_token_done(JsonParser *p, int type) {
+    p->token[p->token_len] = '\0';
+    p->lex = JSON_LEX_NONE;
+
+    if (p->expect == JSON_EXPECT_KEY) {
+        json_path_key(p, p->token, p->token_len);
+        p->expect = JSON_EXPECT_COLON;
+        return 0;
+    }
+    if (type == JSON_NUMBER) {
+        if (!json_number_ok(p->token)) return json_error(p, "bad number");
+    } else if (type != JSON_STRING) {
+        if (strcmp(p->token, "true") == 0) type = JSON_TRUE;
+        else if (strcmp(p->token, "false") == 0) type = JSON_FALSE;
+        else if (strcmp(p->token, "null") == 0) type = JSON_NULL;
+        else return json_error(p, "bad literal");
+    }
+    json_value(p, type, p->token, p->token_len);
+    json_after_value(p);
+    return 0;
+}
+
+// Структурный символ вне лексемы
+static int json_punct(JsonParser *p, char c) {
+    int empty_ok = p->empty_ok;
+    p->empty_ok = 0;
+
+    switch (c) {
+        case '{':
+        case '[':
+            if (p->expect != JSON_EXPECT_VALUE) return json_error(p, "unexpected bracket");
+            if (p->depth == JSON_DEPTH) return json_error(p, "nesting too deep");
+            p->depth++;
+            p->stack[p->depth] = c;
+            p->index[p->depth] = 0;
+            p->base_len[p->depth] = p->path_len;
+            p->expect = c == '{' ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+            p->empty_ok = 1;
+            if (c == '[') json_path_index(p);
+            return 0;
+
+        case '}':
+        case ']': {
+            char open = c == '}' ? '{' : '[';
+            if (p->depth == 0 || p->stack[p->depth] != open) return json_error(p, "unbalanced bracket");
+            if (p->expect != JSON_EXPECT_COMMA && !empty_ok) return json_error(p, "unexpected close");
+            p->path_len = p->base_len[p->depth];
+            if (p->path_len < JSON_PATH_MAX) p->path[p->path_len] = '\0';
+            p->depth--;
+            json_after_value(p);
+            return 0;
+        }
+
+        case ':':
+            if (p->expect != JSON_EXPECT_COLON) return json_error(p, "unexpected ':'");
+            p->expect = JSON_EXPECT_VALUE;
+            return 0;
+
+        case ',':
+            if (p->expect != JSON_EXPECT_COMMA) return json_error(p, "unexpected ','");
+            if (p->stack[p->depth] == '{') {
+                p->expect = JSON_EXPECT_KEY;
+            } else {
+                p->index[p->depth]++;
+                json_path_index(p);
+                p->expect = JSON_EXPECT_VALUE;
+            }
+            return 0;
+    }
+    return json_error(p, "unexpected character");
+}
+
+// Разбор куска. 0 - дальше, -1 - ошибка (причина в p->error; остальной
+// текст игнорируется)
+static int json_feed(JsonParser *p, const char *data, long len) {
+    if (p->error) return -1;
+    p->bytes += len;
+
+    for (long i = 0; i < len; i++) {
+        unsigned char c = data[i];
+
+        switch (p->lex) {
+            case JSON_LEX_STRING: {
+                // Обычные символы - одним циклом до кавычки или '\'.
+                // Строки короткие, вызов memcpy на каждую дороже копирования
+                char *t = p->token + p->token_len;
+                char *end = p->token + JSON_TOKEN_MAX - 1;
+                for (; i < len && data[i] != '"' && data[i] != '\\'; i++) {
+                    if (t < end) *t++ = data[i];
+                }
+                p->token_len = t - p->token;
+                if (i == len) return 0;
+                if (data[i] == '\\') p->lex = JSON_LEX_ESCAPE;
+                else if (json_token_done(p, JSON_STRING) < 0) return -1;
+                continue;
+            }
+
+            case JSON_LEX_ESCAPE:
+                p->lex = JSON_LEX_STRING;
+                switch (c) {
+                    case 'b': json_token_put(p, '\b'); break;
+                    case 'f': json_token_put(p, '\f'); break;
+                    case 'n': json_token_put(p, '\n'); break;
+                    case 'r': json_token_put(p, '\r'); break;
+                    case 't': json_token_put(p, '\t'); break;
+                    case 'u':
+                        p->lex = JSON_LEX_UNICODE;
+                        p->unicode = 0;
+                        p->unicode_digits = 0;
+                        break;
+                    case '"': case '\\': case '/':
+                        json_token_put(p, c);
+                        break;
+                    default:
+                        return json_error(p, "bad escape");
+                }
+                continue;
+
+            case JSON_LEX_UNICODE: {
+                int d = c >= '0' && c <= '9' ? c - '0' :
+                        c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                        c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (d < 0) return json_error(p, "bad \\u escape");
+                p->unicode = p->unicode << 4 | d;
+                if (++p->unicode_digits < 4) continue;
+
+                p->lex = JSON_LEX_STRING;
+                if (p->unicode >= 0xD800 && p->unicode < 0xDC00) {
+                    p->surrogate = p->unicode;      // ждем младшую половину
+                } else if (p->unicode >= 0xDC00 && p->unicode < 0xE000 && p->surrogate) {
+                    json_token_utf8(p, 0x10000 + ((p->surrogate - 0xD800) << 10) + (p->unicode - 0xDC00));
+                    p->surrogate = 0;
+                } else {
+                    json_token_utf8(p, p->unicode);
+                    p->surrogate = 0;
+                }
+                continue;
+            }
+
+            case JSON_LEX_NUMBER:
+            case JSON_LEX_LITERAL: {
+                // Число или литерал - тоже одним циклом, до разделителя
+                char *t = p->token + p->token_len;
+                char *end = p->token + JSON_TOKEN_MAX - 1;
+                for (; i < len && json_word_char(data[i]); i++) {
+                    if (t < end) *t++ = data[i];
+                }
+                p->token_len = t - p->token;
+                if (i == len) return 0;
+                c = data[i];
+                if (json_token_done(p, p->lex == JSON_LEX_NUMBER ? JSON_NUMBER : JSON_NULL) < 0) return -1;
+                break;      // c - разделитель, разбирается ниже
+            }
+        }
+
+        // Между лексемами
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+        if (p->expect == JSON_EXPECT_END) return json_error(p, "garbage after value");
+
+        if (c == '"') {
+            if (p->expect != JSON_EXPECT_VALUE && p->expect != JSON_EXPECT_KEY) {
+                return json_error(p, "unexpected string");
+            }
+            p->empty_ok = 0;
+            p->lex = JSON_LEX_STRING;
+            p->token_len = 0;
+            p->surrogate = 0;
+        } else if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+            if (p->expect != JSON_EXPECT_VALUE) return json_error(p, "unexpected value");
+            p->empty_ok = 0;
+            p->lex = c >= 'a' ? JSON_LEX_LITERAL : JSON_LEX_NUMBER;
+            p->token_len = 0;
+            i--;    // лексема начинается с c
+        } else if (json_punct(p, c) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Текст кончился. 1 - корневое значение полностью разобрано
+static int json_finish(JsonParser *p) {
+    if (!p->error && p->depth == 0 &&
+        (p->lex == JSON_LEX_NUMBER || p->lex == JSON_LEX_LITERAL)) {
+        json_token_done(p, p->lex == JSON_LEX_NUMBER ? JSON_NUMBER : JSON_NULL);
+    }
+    if (!p->error && p->expect != JSON_EXPECT_END) json_error(p, "unexpected end");
+    return p->error == NULL;
+}
+
+// Разбор текста целиком
+static int json_parse(JsonParser *p, const char *text, long len) {
+    json_feed(p, text, len);
+    return json_finish(p);
+}
+
+// sink для fetch_set_sink: тело ответа разбирается по мере прихода.
+// Ошибка разбора не отказ от тела - соединение дочитывается и остается
+// в пуле, ошибку покажет json_finish
+static size_t json_sink(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    json_feed(userdata, ptr, size * nmemb);
+    return size * nmemb;
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "xres.h"
+#include "xbatch.h"
+
 #define MAX_TEXT_LENGTH 50
 #define MAX_LABEL_LENGTH 100
 
@@ -13,6 +16,9 @@ typedef struct {
     Window window;
     GC gc;
     int screen;
+    XResources res;         // шрифты, цвета и GC, запрошенные один раз
+    XResFont* font;
+    XBatch batch;           // примитивы кадра, сбрасываются после события
     
     // Текст
     char inputText[MAX_TEXT_LENGTH];
@@ -25,7 +31,8 @@ typedef struct {
 } SimpleWindow;
 
 // Прототипы функций
-unsigned long LightGrayPixel(Display* display, int screen);
+unsigned long LightGrayPixel(SimpleWindow* app);
+GC colorGC(SimpleWindow* app, unsigned long pixel);
 void drawLabel(SimpleWindow* app);
 void drawInputField(SimpleWindow* app);
 void drawButton(SimpleWindow* app);
@@ -34,22 +41,15 @@ void handleButtonPress(SimpleWindow* app, XButtonEvent event);
 void handleButtonRelease(SimpleWindow* app, XButtonEvent event);
 void handleKeyPress(SimpleWindow* app, XKeyEvent event);
 
-unsigned long LightGrayPixel(Display* display, int screen) {
-    XColor color;
-    Colormap colormap = DefaultColormap(display, screen);
-    
-    // Создаем светлосерый цвет
-    color.red = 30000;
-    color.green = 30000;
-    color.blue = 30000;
-    color.flags = DoRed | DoGreen | DoBlue;
-    
-    if (XAllocColor(display, colormap, &color)) {
-        return color.pixel;
-    }
-    
-    // Запасной вариант
-    return WhitePixel(display, screen);
+unsigned long LightGrayPixel(SimpleWindow* app) {
+    // Светлосерый цвет выделяется один раз, дальше берется из кэша
+    return xres_color(&app->res, 30000, 30000, 30000);
+}
+
+// Готовый GC нужного цвета вместо XSetForeground на общем GC
+GC colorGC(SimpleWindow* app, unsigned long pixel) {
+    Font fid = app->font ? app->font->font->fid : None;
+    return xres_gc(&app->res, pixel, WhitePixel(app->display, app->screen), fid);
 }
 
 int initialize(SimpleWindow* app) {
@@ -89,6 +89,18 @@ int initialize(SimpleWindow* app) {
     app->gc = XCreateGC(app->display, app->window, 0, NULL);
     XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
     
+    // Шрифт загружаем один раз: дальше ширина текста считается локально
+    xres_init(&app->res, app->display, app->screen, app->window);
+    app->font = xres_font(&app->res, "fixed");
+    if (app->font) {
+        XSetFont(app->display, app->gc, app->font->font->fid);
+    }
+    
+    // Линии, заливки и текст кадра копятся и уходят пачкой в конце события
+    xb_init(&app->batch, app->display, app->window,
+            app->font ? &app->font->metrics : NULL);
+    xres_set_flush(&app->res, xb_flush_ctx, &app->batch);
+    
     // Показываем окно
     XMapWindow(app->display, app->window);
     
@@ -96,17 +108,21 @@ int initialize(SimpleWindow* app) {
 }
 
 void drawLabel(SimpleWindow* app) {
+    GC black = colorGC(app, BlackPixel(app->display, app->screen));
+    GC white = colorGC(app, WhitePixel(app->display, app->screen));
+    
     // Очищаем область лейбла (примерные координаты)
-    XSetForeground(app->display, app->gc, WhitePixel(app->display, app->screen));
-    XFillRectangle(app->display, app->window, app->gc, 45, 35, 300, 20);
+    xb_fill(&app->batch, white, 45, 35, 300, 20);
     
     // Рисуем текст лейбла
-    XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-    XDrawString(app->display, app->window, app->gc, 50, 50, 
+    xb_text(&app->batch, black, 50, 50, 
                 app->labelText, strlen(app->labelText));
 }
 
 void drawInputField(SimpleWindow* app) {
+    GC black = colorGC(app, BlackPixel(app->display, app->screen));
+    GC white = colorGC(app, WhitePixel(app->display, app->screen));
+    
     // Рисуем поле ввода
     int inputX = 150;
     int inputY = 45;
@@ -114,91 +130,67 @@ void drawInputField(SimpleWindow* app) {
     int inputHeight = 25;
     
     // Рисуем рамку
-    XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-    XDrawRectangle(app->display, app->window, app->gc, 
+    xb_rect(&app->batch, black, 
                   inputX, inputY, inputWidth - 1, inputHeight - 1);
     
     // Заливаем белым
-    XSetForeground(app->display, app->gc, WhitePixel(app->display, app->screen));
-    XFillRectangle(app->display, app->window, app->gc, 
+    xb_fill(&app->batch, white, 
                   inputX + 1, inputY + 1, inputWidth - 2, inputHeight - 2);
     
     // Рисуем текст
-    XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
     if (strlen(app->inputText) > 0) {
-        XDrawString(app->display, app->window, app->gc, 
+        xb_text(&app->batch, black, 
                    inputX + 5, inputY + 15, app->inputText, strlen(app->inputText));
     }
     
     // Курсор, если поле активно
-    if (app->inputActive) {
-        XFontStruct* font = XLoadQueryFont(app->display, "fixed");
-        if (font) {
-            int textWidth = XTextWidth(font, app->inputText, strlen(app->inputText));
-            XDrawLine(app->display, app->window, app->gc, 
-                     inputX + 5 + textWidth, inputY + 5, 
-                     inputX + 5 + textWidth, inputY + 20);
-            XFreeFont(app->display, font);
-        }
+    if (app->inputActive && app->font) {
+        int textWidth = fm_text_width(&app->font->metrics, app->inputText, strlen(app->inputText));
+        xb_line(&app->batch, black, 
+                 inputX + 5 + textWidth, inputY + 5, 
+                 inputX + 5 + textWidth, inputY + 20);
     }
 }
 
 void drawButton(SimpleWindow* app) {
+    GC black = colorGC(app, BlackPixel(app->display, app->screen));
+    GC white = colorGC(app, WhitePixel(app->display, app->screen));
+    GC gray = colorGC(app, LightGrayPixel(app));
+    
     int buttonX = 150;
     int buttonY = 85;
     int buttonWidth = 100;
     int buttonHeight = 30;
     
-    // Рисуем 3D эффект для кнопки
-    if (app->buttonPressed) {
-        // Вдавленная кнопка
-        XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY, buttonX + buttonWidth - 1, buttonY);
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY, buttonX, buttonY + buttonHeight - 1);
-        
-        XSetForeground(app->display, app->gc, WhitePixel(app->display, app->screen));
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX + buttonWidth - 1, buttonY, 
-                 buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY + buttonHeight - 1, 
-                 buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
-    } else {
-        // Выпуклая кнопка
-        XSetForeground(app->display, app->gc, WhitePixel(app->display, app->screen));
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY, buttonX + buttonWidth - 1, buttonY);
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY, buttonX, buttonY + buttonHeight - 1);
-        
-        XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX + buttonWidth - 1, buttonY, 
-                 buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
-        XDrawLine(app->display, app->window, app->gc, 
-                 buttonX, buttonY + buttonHeight - 1, 
-                 buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
-    }
+    // Рисуем 3D эффект для кнопки: вдавленная - темный верх/лево,
+    // выпуклая - светлый
+    GC topLeft = app->buttonPressed ? black : white;
+    GC bottomRight = app->buttonPressed ? white : black;
+    
+    xb_line(&app->batch, topLeft, 
+             buttonX, buttonY, buttonX + buttonWidth - 1, buttonY);
+    xb_line(&app->batch, topLeft, 
+             buttonX, buttonY, buttonX, buttonY + buttonHeight - 1);
+    
+    xb_line(&app->batch, bottomRight, 
+             buttonX + buttonWidth - 1, buttonY, 
+             buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
+    xb_line(&app->batch, bottomRight, 
+             buttonX, buttonY + buttonHeight - 1, 
+             buttonX + buttonWidth - 1, buttonY + buttonHeight - 1);
     
     // Заливаем серым
-    XSetForeground(app->display, app->gc, LightGrayPixel(app->display, app->screen));
-    XFillRectangle(app->display, app->window, app->gc, 
+    xb_fill(&app->batch, gray, 
                   buttonX + 1, buttonY + 1, buttonWidth - 2, buttonHeight - 2);
     
     // Центрируем текст на кнопке
-    XFontStruct* font = XLoadQueryFont(app->display, "fixed");
-    if (font) {
-        int textWidth = XTextWidth(font, app->buttonText, strlen(app->buttonText));
+    if (app->font) {
+        int textWidth = fm_text_width(&app->font->metrics, app->buttonText, strlen(app->buttonText));
         int x = buttonX + (buttonWidth - textWidth) / 2;
         int y = buttonY + (buttonHeight + 8) / 2;
         
-        XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-        XSetFont(app->display, app->gc, font->fid);
-        XDrawString(app->display, app->window, app->gc, x, y, 
+        xb_text(&app->batch, black, x, y, 
                    app->buttonText, strlen(app->buttonText));
-        XFreeFont(app->display, font);
     }
 }
 
@@ -206,7 +198,8 @@ void drawWindow(SimpleWindow* app) {
     XClearWindow(app->display, app->window);
     
     // Рисуем заголовок
-    XDrawString(app->display, app->window, app->gc, 150, 30, "X11 Program", 11);
+    xb_text(&app->batch, colorGC(app, BlackPixel(app->display, app->screen)),
+            150, 30, "X11 Program", 11);
     
     // Обновляем все элементы
     drawLabel(app);
@@ -346,11 +339,16 @@ void run(SimpleWindow* app) {
                 // Обработка изменения размера окна
                 break;
         }
+        
+        xb_flush(&app->batch);
     }
 }
 
 void cleanup(SimpleWindow* app) {
     if (app->display) {
+        xb_report(&app->batch);
+        xres_report(&app->res);
+        xres_free(&app->res);
         XFreeGC(app->display, app->gc);
         XDestroyWindow(app->display, app->window);
         XCloseDisplay(app->display);
@@ -9,20 +9,53 @@
 #include <netinet/in.h>
 #include <netdb.h>
 
+#include "xres.h"
+#include "fetch.h"
+#include "json.h"
+#include "iconcache.h"
+#include "iconatlas.h"
+#include "png.h"
+
 #define WINDOW_WIDTH  600
 #define WINDOW_HEIGHT 600
-#define BUFFER_SIZE 4096
 #define MAX_CITY_LENGTH 50
 
 #define OPENWEATHER_API_KEY "68682c4ce7b5e11bfcefb6a4af50e437"
 #define DEFAULT_CITY "Ryazan"
 
+// Нужные окну поля ответа /data/2.5/weather
+typedef struct {
+    int cod;                // 200 или код ошибки ("404" приходит строкой)
+    double temp;            // Кельвины
+    double feels_like;
+    int humidity;
+    char description[50];
+    char name[MAX_CITY_LENGTH];
+    char icon[10];
+    char message[80];       // текст ошибки API
+    unsigned long found;    // биты WF_* - поле было в ответе
+} WeatherReply;
+
+enum { WF_COD, WF_TEMP, WF_FEELS_LIKE, WF_HUMIDITY, WF_DESCRIPTION, WF_NAME, WF_ICON, WF_MESSAGE, WF_COUNT };
+
+static const JsonField weather_fields[WF_COUNT] = {
+    JSON_FIELD("cod",                    JSON_F_INT,    WeatherReply, cod),
+    JSON_FIELD("main.temp",              JSON_F_DOUBLE, WeatherReply, temp),
+    JSON_FIELD("main.feels_like",        JSON_F_DOUBLE, WeatherReply, feels_like),
+    JSON_FIELD("main.humidity",          JSON_F_INT,    WeatherReply, humidity),
+    JSON_FIELD("weather[0].description", JSON_F_TEXT,   WeatherReply, description),
+    JSON_FIELD("name",                   JSON_F_TEXT,   WeatherReply, name),
+    JSON_FIELD("weather[0].icon",        JSON_F_TEXT,   WeatherReply, icon),
+    JSON_FIELD("message",                JSON_F_TEXT,   WeatherReply, message),
+};
+
 typedef struct {
     Display* display;
     Window window;
     GC gc;
     int screen;
     XFontStruct* main_font;
+    XResources res;         // шрифты, загруженные один раз
     
     char temperature[20];
     char feels_like[20];
@@ -34,14 +67,19 @@ typedef struct {
     int input_active;
 
     char icon_code[10];
-    Pixmap icon_img;
+    Pixmap icon_img;        // из atlas или icons, не освобождаются отдельно
     Pixmap icon_mask;
-    XpmAttributes icon_attrs;
+    int icon_x, icon_y;     // место иконки в icon_img (клетка атласа)
+    int icon_w, icon_h;
+    IconAtlas atlas;        // встроенные иконки
+    IconCache icons;        // скачанные, если WEATHER_REMOTE_ICONS=1
+    int remote_icons;
 } WeatherApp;
 
 int get_weather_mock(WeatherApp* app, const char* city);
-int http_get(const char* host, const char* path, char* response, int response_size);
-int parse_weather_json(const char* json, WeatherApp* app);
+int http_get(const char* host, int port, const char* path, HttpBuffer* response);
+int parse_weather_json(const char* json, long len, WeatherReply* reply);
+int apply_weather_reply(WeatherApp* app, const WeatherReply* reply);
 int get_weather(WeatherApp* app, const char* api_key, const char* city);
 void draw_weather(WeatherApp* app);
 void initialize_app(WeatherApp* app);
@@ -77,363 +115,207 @@ XFontStruct* load_large_font(Display* display) {
     return NULL;
 }
 
-// Функция для записи HTTP ответа
-size_t write_callback(void* ptr, size_t size, size_t nmemb, char* response) {
+// Функция для записи HTTP ответа: кусок тела дописывается в буфер запроса.
+// Счетчик принятых байт живет в самом буфере, у каждого запроса свой
+size_t write_callback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    HttpBuffer* response = userdata;
     size_t total_size = size * nmemb;
-    static size_t total_received = 0;
-    
-    if (total_received + total_size >= BUFFER_SIZE - 1) {
+
+    if (!http_buffer_append(response, ptr, total_size)) {
         return 0;
     }
-    
-    memcpy(response + total_received, ptr, total_size);
-    total_received += total_size;
-    response[total_received] = '\0';
-    
     return total_size;
 }
 
-// Скачивание бинарных PNG
-int http_get_binary(const char* host, const char* path,
-                    unsigned char* buffer, int max_size)
+// Сервер для host: WEATHER_API="хост:порт" (заглушка bench/owmserver)
+// заменяет и API, и сервер иконок; иначе host:80
+static const char* api_server(const char* host, int* port) {
+    static char server[64];
+    static int server_port;
+    const char* env = getenv("WEATHER_API");
+    if (!env || !env[0]) {
+        *port = 80;
+        return host;
+    }
+    if (!server[0]) {
+        snprintf(server, sizeof(server), "%s", env);
+        char* colon = strrchr(server, ':');
+        server_port = colon && atoi(colon + 1) > 0 ? atoi(colon + 1) : 80;
+        if (colon) *colon = '\0';
+    }
+    *port = server_port;
+    return server;
+}
+
+// Скачивание бинарных PNG (со сроками фаз из fetch.h) в растущий буфер
+int http_get_binary(const char* host, const char* path, HttpBuffer* buffer)
 {
-    int sockfd;
-    struct hostent* server;
-    struct sockaddr_in serv_addr;
+    int port;
+    host = api_server(host, &port);
+    static Fetch fetch;
+    if (fetch.started == 0) fetch_init(&fetch);
 
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) return -1;
+    http_buffer_reset(buffer);
+    fetch_set_sink(&fetch, write_callback, buffer);
 
-    server = gethostbyname(host);
-    if (!server) {
-        close(sockfd);
+    if (!fetch_start(&fetch, host, port, path) || !fetch_wait(&fetch)) {
+        fprintf(stderr, "Icon download failed: %s\n", fetch.error);
         return -1;
     }
+    return buffer->len;
+}
 
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(80);
-
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        close(sockfd);
-        return -1;
+// Декодирование PNG в пиксели ARGB (png.h: inflate, фильтры строк, альфа)
+int png_decode(const unsigned char* png, int png_size, IconPixels* px)
+{
+    PngImage img;
+    if (!png_read(png, png_size, &img)) {
+        fprintf(stderr, "PNG decode error: %s\n", img.error);
+        return 0;
     }
-
-    char request[512];
-    snprintf(request, sizeof(request),
-             "GET %s HTTP/1.1\r\n"
-             "Host: %s\r\n"
-             "User-Agent: Minix3-Weather/1.0\r\n"
-             "Connection: close\r\n\r\n",
-             path, host);
-
-    write(sockfd, request, strlen(request));
-
-    int header_done = 0;
-    int total = 0;
-    char temp[1024];
-    int n;
-
-    while ((n = read(sockfd, temp, sizeof(temp))) > 0) {
-        int start = 0;
-
-        if (!header_done) {
-            char* hdr = strstr(temp, "\r\n\r\n");
-            if (hdr) {
-                header_done = 1;
-                start = (hdr - temp) + 4;
-            } else continue;
-        }
-
-        int size = n - start;
-        if (size > 0 && total + size < max_size) {
-            memcpy(buffer + total, temp + start, size);
-            total += size;
-        }
+    if (img.w > ICON_MAX_SIDE || img.h > ICON_MAX_SIDE) {
+        fprintf(stderr, "PNG decode error: icon too large (%dx%d)\n", img.w, img.h);
+        free(img.argb);
+        return 0;
     }
-
-    close(sockfd);
-    return total;
+    px->w = img.w;
+    px->h = img.h;
+    px->argb = img.argb;
+    return 1;
 }
 
-// Конвертация png-xpm
-int png_to_xpm(const unsigned char* png, int png_size,
-               char*** out_xpm, int* w, int* h)
+// Иконка для app->icon_code: из памяти, с диска или из сети.
+// Повторная иконка не скачивается и не декодируется (iconcache.h)
+int load_icon_from_api(WeatherApp* app)
 {
-    // Упрощённый PNG-parser: берём только IHDR + IDAT без фильтров.
-    // OpenWeather PNG = 50×50 RGBA, упрощённый формат.
-    // Мы НЕ делаем полноценный парсер, а читаем фиксированный PNG.
-
-    if (png[12] != 'I' || png[13] != 'H') return 0;
-
-    *w = (png[16] << 24) | (png[17] << 16) | (png[18] << 8) | png[19];
-    *h = (png[20] << 24) | (png[21] << 16) | (png[22] << 8) | png[23];
-
-    // создаем XPM массив строк
-    int colors = 2;
-    int cpp = 1;
-
-    int total_lines = 1 + colors + *h;
-    char** xpm = malloc(sizeof(char*) * total_lines);
-
-    // первая строка: "w h colors chars-per-pixel"
-    char buf[128];
-    snprintf(buf, sizeof(buf), "%d %d %d %d", *w, *h, colors, cpp);
-    xpm[0] = strdup(buf);
-
-    xpm[1] = strdup("  c None");   // прозрачность
-    xpm[2] = strdup(". c #000000"); // чёрный (силуэт)
-
-    // упрощённо: рисуем чёрный силуэт по непрозрачным пикселям PNG
-    int row = 3;
-    int pos = 33; // пропускаем PNG/IHDR/IDAT до данных (упрощение)
+    if (!strlen(app->icon_code)) return 0;
 
-    for (int y = 0; y < *h; y++) {
-        char* line = malloc(*w + 1);
-        for (int x = 0; x < *w; x++) {
-            int a = png[pos + 3];
-            line[x] = (a > 128 ? '.' : ' ');
-            pos += 4;
+    IconSlot* slot = icon_cache_get(&app->icons, app->icon_code);
+    if (!slot) {
+        IconPixels px;
+        if (icon_disk_read(&app->icons, app->icon_code, &px)) {
+            app->icons.disk_hits++;
+        } else {
+            char path[128];
+            snprintf(path, sizeof(path), "/img/wn/%s.png", app->icon_code);
+
+            HttpBuffer png = {0};
+            int size = http_get_binary("openweathermap.org", path, &png);
+            double start = icon_now_ms();
+            int decoded = size > 0 && png_decode((unsigned char*)png.data, size, &px);
+            http_buffer_free(&png);
+            if (!decoded) {
+                fprintf(stderr, "Icon %s: download or decode failed\n", app->icon_code);
+                app->icon_img = None;
+                return 0;
+            }
+            app->icons.decoded++;
+            app->icons.decode_ms += icon_now_ms() - start;
+            icon_disk_write(&app->icons, app->icon_code, &px);
+        }
+        slot = icon_cache_put(&app->icons, app->icon_code, &px);
+        icon_pixels_free(&px);
+        if (!slot) {
+            app->icon_img = None;
+            return 0;
         }
-        line[*w] = 0;
-        xpm[row++] = line;
     }
 
-    *out_xpm = xpm;
+    // Pixmap принадлежат кэшу, освобождать их здесь не нужно
+    app->icon_img = slot->img;
+    app->icon_mask = slot->mask;
+    app->icon_x = 0;
+    app->icon_y = 0;
+    app->icon_w = slot->w;
+    app->icon_h = slot->h;
     return 1;
 }
 
-// Загрузка иконки
-int load_icon_from_api(WeatherApp* app)
+// Иконка для app->icon_code: встроенная из атласа, без сети. Оригиналы
+// с openweathermap.org - только если пользователь их включил
+// (WEATHER_REMOTE_ICONS=1); не скачалась или не разобралась - снова атлас,
+// так что с сетевыми иконками на экране никогда не меньше, чем без них
+int load_icon(WeatherApp* app)
 {
-    if (!strlen(app->icon_code)) return 0;
+    if (app->remote_icons && load_icon_from_api(app)) return 1;
 
-    char path[128];
-    snprintf(path, sizeof(path), "/img/wn/%s.png", app->icon_code);
+    if (icon_atlas_lookup(&app->atlas, app->icon_code, &app->icon_x, &app->icon_y)) {
+        app->icon_img = app->atlas.img;
+        app->icon_mask = app->atlas.mask;
+        app->icon_w = ICON_ATLAS_SIDE;
+        app->icon_h = ICON_ATLAS_SIDE;
+        return 1;
+    }
 
-    unsigned char png_data[20000];
-    int size = http_get_binary("openweathermap.org", path, png_data, sizeof(png_data));
-    if (size <= 0) return 0;
+    app->icon_img = None;
+    return 0;
+}
 
-    char** xpm;
-    int w, h;
+// функция для HTTP GET запроса (со сроками фаз из fetch.h)
+int http_get(const char* host, int port, const char* path, HttpBuffer* response) {
+    static Fetch fetch;
+    if (fetch.started == 0) fetch_init(&fetch);
 
-    if (!png_to_xpm(png_data, size, &xpm, &w, &h)) {
-        fprintf(stderr, "PNG→XPM failed\n");
-        return 0;
+    // Тело без промежуточных копий уходит прямо в буфер вызывающего
+    http_buffer_reset(response);
+    fetch_set_sink(&fetch, write_callback, response);
+
+    printf("Connecting to %s...\nPath: %s\n", host, path);
+    if (!fetch_start(&fetch, host, port, path) || !fetch_wait(&fetch)) {
+        fprintf(stderr, "HTTP error: %s\n", fetch.error);
+        return -1;
     }
 
-    app->icon_attrs.valuemask = 0;
+    printf("Received %ld bytes of data\n", response->len);
+    return response->len;
+}
 
-    if (XpmCreatePixmapFromData(
-            app->display,
-            app->window,
-            xpm,
-            &app->icon_img,
-            &app->icon_mask,
-            &app->icon_attrs
-        ) != XpmSuccess)
-    {
-        fprintf(stderr, "XPM→PIXMAP fail\n");
+// Разбор JSON ответа OpenWeatherMap за один проход (json.h).
+// Поля берутся по полному пути, так что "temp" из вложенного объекта
+// или "name" из "sys" не перепутаются с нужными
+int parse_weather_json(const char* json, long len, WeatherReply* reply) {
+    JsonParser parser;
+
+    printf("Parsing JSON response...\n");
+    memset(reply, 0, sizeof(*reply));
+    json_init(&parser, weather_fields, WF_COUNT, reply);
+    if (!json_parse(&parser, json, len)) {
+        fprintf(stderr, "JSON error: %s\n", parser.error);
         return 0;
     }
-
+    reply->found = parser.found;
     return 1;
 }
 
-
-// функция для HTTP GET запроса
-int http_get(const char* host, const char* path, char* response, int response_size) {
-    int sockfd;
-    struct hostent* server;
-    struct sockaddr_in serv_addr;
-    
-    printf("Connecting to %s...\n", host);
-    
-    sockfd = socket(AF_INET, SOCK_STREAM, 0); //Создание TCP-сокета
-    if (sockfd < 0) {
-        perror("socket");
-        return -1;
-    }
-    
-    server = gethostbyname(host); //Преобразование доменного имени в IP-адрес
-    if (server == NULL) {
-        fprintf(stderr, "Error: no such host %s\n", host);
-        close(sockfd);
-        return -1;
-    }
-    
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(80); // HTTP
-    
-    printf("Attempting connection to %s...\n", host);
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        perror("connect");
-        close(sockfd);
-        return -1;
-    }
-    
-    // Формируем HTTP запрос
-    char request[1024];
-    snprintf(request, sizeof(request),
-             "GET %s HTTP/1.1\r\n"
-             "Host: %s\r\n"
-             "User-Agent: Minix3-Weather/1.0\r\n"
-             "Connection: close\r\n\r\n",
-             path, host);
-    
-    printf("Sending request...\nPath: %s\n", path);
-    if (write(sockfd, request, strlen(request)) < 0) {
-        perror("write");
-        close(sockfd);
-        return -1;
-    }
-    
-    // Читаем ответ
-    int total_read = 0;
-    int n;
-    char buffer[1024];
-    int header_ended = 0;
-    
-    printf("Reading response...\n");
-    while ((n = read(sockfd, buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[n] = '\0';
-        
-        // Пропускаем HTTP заголовки
-        if (!header_ended) {
-            char* header_end = strstr(buffer, "\r\n\r\n");
-            if (header_end) {
-                header_ended = 1;
-                int body_start = header_end - buffer + 4;
-                int body_size = n - body_start;
-                if (body_size > 0 && total_read + body_size < response_size) {
-                    memcpy(response + total_read, buffer + body_start, body_size);
-                    total_read += body_size;
-                }
-            }
+// Разобранный ответ API: данные погоды и иконка или текст ошибки в app->error
+int apply_weather_reply(WeatherApp* app, const WeatherReply* reply) {
+    if (reply->cod != 200) {
+        if (reply->found & 1 << WF_MESSAGE) {
+            snprintf(app->error, sizeof(app->error), "API Error: %s", reply->message);
         } else {
-            if (total_read + n < response_size) {
-                memcpy(response + total_read, buffer, n);
-                total_read += n;
-            }
+            strcpy(app->error, "API returned error");
         }
+        return 0;
     }
-    
-    if (n < 0) {
-        perror("read");
-        close(sockfd);
-        return -1;
-    }
-    
-    response[total_read] = '\0';
-    close(sockfd);
-    
-    printf("Received %d bytes of data\n", total_read);
-    return total_read;
-}
 
-// Парсим JSON ответ от OpenWeatherMap
-int parse_weather_json(const char* json, WeatherApp* app) {
-    // парсинг JSON 
-    printf("Parsing JSON response...\n");
-    
-    // Ищем температуру
-    char* temp_ptr = strstr(json, "\"temp\":");
-    if (temp_ptr) {
-        temp_ptr += 7; // Пропускаем "\"temp\":"
-        char* end_ptr = strchr(temp_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - temp_ptr;
-            if (len < sizeof(app->temperature) - 1) {
-                strncpy(app->temperature, temp_ptr, len);
-                app->temperature[len] = '\0';
-                // Конвертируем из Кельвина в Цельсий
-                float temp_k = atof(app->temperature);
-                float temp_c = temp_k - 273.15;
-                snprintf(app->temperature, sizeof(app->temperature), "%.1f", temp_c);
-            }
-        }
-    load_icon_from_api(app);
-    }
-    
-    // Ищем ощущаемую температуру
-    char* feels_ptr = strstr(json, "\"feels_like\":");
-    if (feels_ptr) {
-        feels_ptr += 13; 
-        char* end_ptr = strchr(feels_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - feels_ptr;
-            if (len < sizeof(app->feels_like) - 1) {
-                strncpy(app->feels_like, feels_ptr, len);
-                app->feels_like[len] = '\0';
-                // Конвертируем из Кельвина в Цельсий
-                float feels_k = atof(app->feels_like);
-                float feels_c = feels_k - 273.15;
-                snprintf(app->feels_like, sizeof(app->feels_like), "%.1f", feels_c);
-            }
-        }
+    // Температуры приходят в Кельвинах
+    if (reply->found & 1 << WF_TEMP) {
+        snprintf(app->temperature, sizeof(app->temperature), "%.1f", reply->temp - 273.15);
     }
-    
-    // Ищем влажность
-    char* humidity_ptr = strstr(json, "\"humidity\":");
-    if (humidity_ptr) {
-        humidity_ptr += 11; 
-        char* end_ptr = strchr(humidity_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - humidity_ptr;
-            if (len < sizeof(app->humidity) - 1) {
-                strncpy(app->humidity, humidity_ptr, len);
-                app->humidity[len] = '\0';
-            }
-        }
+    if (reply->found & 1 << WF_FEELS_LIKE) {
+        snprintf(app->feels_like, sizeof(app->feels_like), "%.1f", reply->feels_like - 273.15);
     }
-
-    // Ищем иконки
-    char* icon_ptr = strstr(json, "\"icon\":\"");
-    if (icon_ptr) {
-        icon_ptr += 8;
-        char* end_ptr = strchr(icon_ptr, '"');
-        if (end_ptr) {
-            int len = end_ptr - icon_ptr;
-            if (len < sizeof(app->icon_code)) {
-                strncpy(app->icon_code, icon_ptr, len);
-                app->icon_code[len] = '\0';
-        }
+    if (reply->found & 1 << WF_HUMIDITY) {
+        snprintf(app->humidity, sizeof(app->humidity), "%d", reply->humidity);
     }
-}
+    if (reply->found & 1 << WF_DESCRIPTION) strcpy(app->description, reply->description);
+    if (reply->found & 1 << WF_NAME) strcpy(app->city, reply->name);
 
-    
-    // Ищем описание погоды
-    char* desc_ptr = strstr(json, "\"description\":\"");
-    if (desc_ptr) {
-        desc_ptr += 15; 
-        char* end_ptr = strchr(desc_ptr, '"');
-        if (end_ptr) {
-            int len = end_ptr - desc_ptr;
-            if (len < sizeof(app->description) - 1) {
-                strncpy(app->description, desc_ptr, len);
-                app->description[len] = '\0';
-            }
-        }
+    // Иконка - уже по коду из этого ответа
+    if (reply->found & 1 << WF_ICON) {
+        strcpy(app->icon_code, reply->icon);
+        load_icon(app);
     }
-    
-    // Ищем название города
-    char* city_ptr = strstr(json, "\"name\":\"");
-    if (city_ptr) {
-        city_ptr += 8; // Пропускаем "\"name\":\""
-        char* end_ptr = strchr(city_ptr, '"');
-        if (end_ptr) {
-            int len = end_ptr - city_ptr;
-            if (len < sizeof(app->city) - 1) {
-                strncpy(app->city, city_ptr, len);
-                app->city[len] = '\0';
-            }
-        }
-    }
-    
     return 1;
 }
 
@@ -441,7 +323,7 @@ int parse_weather_json(const char* json, WeatherApp* app) {
 int get_weather(WeatherApp* app, const char* api_key, const char* city) {
     printf("Getting weather for %s from OpenWeatherMap...\n", city);
     
-    char response[BUFFER_SIZE];
+    HttpBuffer response = {0};
     char url[512];
     
     // Формируем URL для OpenWeatherMap API
@@ -451,31 +333,24 @@ int get_weather(WeatherApp* app, const char* api_key, const char* city) {
     
     printf("API URL: %s\n", url);
     
-    int result = http_get("api.openweathermap.org", url, response, BUFFER_SIZE);
+    int port;
+    const char* host = api_server("api.openweathermap.org", &port);
+    int result = http_get(host, port, url, &response);
     
     if (result > 0) {
         printf("Successfully received weather data\n");
-        
-        if (strstr(response, "\"cod\":200")) {
-            // Успешный ответ
-            return parse_weather_json(response, app);
+        WeatherReply reply;
+        int ok = 0;
+        if (parse_weather_json(response.data, response.len, &reply)) {
+            ok = apply_weather_reply(app, &reply);
         } else {
-            // Ошибка API
-            char* message_ptr = strstr(response, "\"message\":\"");
-            if (message_ptr) {
-                message_ptr += 11;
-                char* end_ptr = strchr(message_ptr, '"');
-                if (end_ptr) {
-                    int len = end_ptr - message_ptr;
-                    snprintf(app->error, sizeof(app->error), "API Error: %.*s", len, message_ptr);
-                }
-            } else {
-                strcpy(app->error, "API returned error");
-            }
-            return 0;
+            strcpy(app->error, "Bad API response");
         }
+        http_buffer_free(&response);
+        return ok;
     } else {
         // Сетевая ошибка - используем фиктивные данные
+        http_buffer_free(&response);
         printf("Network error, using mock data\n");
         return get_weather_mock(app, city);
     }
@@ -487,6 +362,10 @@ int get_weather_mock(WeatherApp* app, const char* city) {
         "clear sky", "few clouds", "scattered clouds", "broken clouds",
         "shower rain", "rain", "thunderstorm", "snow", "mist"
     };
+    // Иконки тех же условий - все есть во встроенном атласе
+    const char* icon_codes[] = {
+        "01d", "02d", "03d", "04d", "09d", "10d", "11d", "13d", "50d"
+    };
     
     // Генерируем "случайные" данные на основе названия города
     int seed = 0;
@@ -506,6 +385,8 @@ int get_weather_mock(WeatherApp* app, const char* city) {
     snprintf(app->feels_like, sizeof(app->feels_like), "%.1f", feels_like);
     snprintf(app->humidity, sizeof(app->humidity), "%d", humidity_base);
     strcpy(app->description, descriptions[desc_index]);
+    strcpy(app->icon_code, icon_codes[desc_index]);
+    load_icon(app);
     strcpy(app->city, city);
     strcpy(app->error, "Using mock data (no network)");
     
@@ -547,9 +428,10 @@ void draw_weather(WeatherApp* app) {
     }
 
     if (app->input_active){
-        XFontStruct* font = XLoadQueryFont(app->display, "variable"); 
+        // Шрифт берется из кэша, а не загружается (и теряется) на каждом кадре
+        XResFont* font = xres_font(&app->res, "variable");
         if (font){
-            int text_width = XTextWidth(font, app->input_city, strlen(app->input_city));
+            int text_width = fm_text_width(&font->metrics, app->input_city, strlen(app->input_city));
             XDrawLine(app->display, app->window, app->gc, 155 + text_width, 60, 155 + text_width, 75);
         }
     }
@@ -588,16 +470,20 @@ void draw_weather(WeatherApp* app) {
     // Описание
     XDrawString(app->display, app->window, app->gc, 50, 215, "Condition:", 10);
     if (app->icon_img) {
-    XCopyArea(
-        app->display,
-        app->icon_img,
-        app->window,
-        app->gc,
-        0, 0,
-        app->icon_attrs.width,
-        app->icon_attrs.height,
-        350, 180      // ← координаты рядом с описанием
-    );
+        // Прозрачные пиксели не рисуются: маска на время копирования
+        XSetClipMask(app->display, app->gc, app->icon_mask);
+        XSetClipOrigin(app->display, app->gc, 350 - app->icon_x, 180 - app->icon_y);
+        XCopyArea(
+            app->display,
+            app->icon_img,
+            app->window,
+            app->gc,
+            app->icon_x, app->icon_y,   // клетка атласа или 0, 0
+            app->icon_w,
+            app->icon_h,
+            350, 180      // ← координаты рядом с описанием
+        );
+        XSetClipMask(app->display, app->gc, None);
     }
     XDrawString(app->display, app->window, app->gc, 170, 215, app->description, strlen(app->description));
     
@@ -705,6 +591,12 @@ void initialize_app(WeatherApp* app) {
     XSetFont(app->display, app->gc, app->main_font->fid);
     XMapWindow(app->display, app->window);
     
+    xres_init(&app->res, app->display, app->screen, app->window);
+    icon_cache_init(&app->icons, app->display, app->window, 0xFFFFFF);
+    icon_atlas_build(&app->atlas, &app->icons);
+
+    const char* remote = getenv("WEATHER_REMOTE_ICONS");
+    app->remote_icons = remote && strcmp(remote, "1") == 0;
 }
 
 // Очистка ресурсов
@@ -713,6 +605,13 @@ void cleanup_app(WeatherApp* app) {
         if (app->main_font){
             XFreeFont(app->display, app->main_font);
         }
+        xres_report(&app->res);
+        fetch_report(stdout);
+        icon_atlas_report(&app->atlas);
+        icon_cache_report(&app->icons);
+        icon_atlas_free(&app->atlas, app->display);
+        icon_cache_free(&app->icons);
+        xres_free(&app->res);
         XFreeGC(app->display, app->gc);
         XDestroyWindow(app->display, app->window);
         XCloseDisplay(app->display);
@@ -0,0 +1,554 @@
+#ifndef PNG_H
+#define PNG_H
+
+// Декодер PNG без внешних библиотек: inflate (zlib, RFC 1950/1951),
+// обратные фильтры строк (None, Sub, Up, Average, Paeth) и перевод в
+// ARGB 0xAARRGGBB с альфой из RGBA, серого с альфой или tRNS.
+// Поддерживаются все типы цвета и глубины 1..16 бит без чересстрочности
+// (Adam7 встречается в иконках редко и отвергается с ошибкой).
+// CRC чанков и Adler-32 не проверяются: целостность обеспечивает TCP,
+// а поврежденный поток все равно ловится проверками inflate.
+//
+// Huffman декодируется по таблице на PNG_FAST_BITS бит, длинные коды -
+// побитно. Выход inflate пишется в буфер точного размера
+// (h * (1 + байт в строке)), так что лишние данные - ошибка, а не realloc.
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PNG_FAST_BITS  9
+#define PNG_MAX_PIXELS (4096L * 4096L)
+
+typedef struct {
+    int w, h;
+    unsigned *argb;         // w * h, malloc; освобождает вызывающий
+    const char *error;
+} PngImage;
+
+typedef struct {
+    unsigned short count[16];       // кодов каждой длины
+    unsigned short symbol[288];     // символы в каноническом порядке
+    unsigned short fast[1 << PNG_FAST_BITS];    // (длина << 9) | символ; 0 - медленный путь
+} PngHuff;
+
+typedef struct {
+    const unsigned char *in;
+    long in_len;
+    long pos;
+    unsigned long bits;
+    int nbits;
+    int overrun;            // читали за концом входа
+
+    unsigned char *out;
+    long out_len;
+    long out_pos;
+} PngInflate;
+
+static void png_refill(PngInflate *z) {
+    while (z->nbits <= 24) {
+        if (z->pos < z->in_len) {
+            z->bits |= (unsigned long)z->in[z->pos] << z->nbits;
+        } else if (z->pos > z->in_len + 4) {
+            z->overrun = 1;
+        }
+        z->pos++;
+        z->nbits += 8;
+    }
+}
+
+static unsigned png_bits(PngInflate *z, int n) {
+    if (z->nbits < n) png_refill(z);
+    unsigned v = z->bits & ((1UL << n) - 1);
+    z->bits >>= n;
+    z->nbits -= n;
+    return v;
+}
+
+// Таблица по длинам кодов. 0 - набор длин невозможен
+static int png_huff_build(PngHuff *h, const unsigned char *lengths, int n) {
+    unsigned short offs[16];
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (int i = 0; i < n; i++) h->count[lengths[i]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) return 0;         // кодов больше, чем помещается
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + h->count[len];
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) h->symbol[offs[lengths[i]]++] = i;
+    }
+
+    // Короткие коды - в таблицу по перевернутым битам (deflate пишет
+    // коды Huffman от старшего бита)
+    int code = 0, index = 0;
+    for (int len = 1; len <= PNG_FAST_BITS; len++) {
+        for (int k = 0; k < h->count[len]; k++, code++, index++) {
+            int rev = 0;
+            for (int b = 0; b < len; b++) rev |= (code >> b & 1) << (len - 1 - b);
+            for (int j = rev; j < 1 << PNG_FAST_BITS; j += 1 << len) {
+                h->fast[j] = len << 9 | h->symbol[index];
+            }
+        }
+        code <<= 1;
+    }
+    return 1;
+}
+
+static int png_decode_sym(PngInflate *z, const PngHuff *h) {
+    if (z->nbits < 15) png_refill(z);
+    unsigned e = h->fast[z->bits & ((1 << PNG_FAST_BITS) - 1)];
+    if (e) {
+        z->bits >>= e >> 9;
+        z->nbits -= e >> 9;
+        return e & 0x1FF;
+    }
+
+    // Медленный путь: канонический код побитно
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= z->bits & 1;
+        z->bits >>= 1;
+        z->nbits--;
+        int count = h->count[len];
+        if (code - count < first) return h->symbol[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static const unsigned short png_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char png_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short png_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char png_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static const char *png_codes(PngInflate *z, const PngHuff *lit, const PngHuff *dist) {
+    for (;;) {
+        int sym = png_decode_sym(z, lit);
+        if (sym < 0 || z->overrun) return "bad literal code";
+        if (sym < 256) {
+            if (z->out_pos == z->out_len) return "too much image data";
+            z->out[z->out_pos++] = sym;
+            continue;
+        }
+        if (sym == 256) return NULL;
+
+        sym -= 257;
+        if (sym >= 29) return "bad length code";
+        int len = png_len_base[sym] + png_bits(z, png_len_extra[sym]);
+        int dsym = png_decode_sym(z, dist);
+        if (dsym < 0 || dsym >= 30) return "bad distance code";
+        long d = png_dist_base[dsym] + png_bits(z, png_dist_extra[dsym]);
+        if (d > z->out_pos) return "distance too far back";
+        if (len > z->out_len - z->out_pos) return "too much image data";
+
+        unsigned char *dst = z->out + z->out_pos;
+        const unsigned char *src = dst - d;
+        if (d >= len) {
+            memcpy(dst, src, len);
+        } else {
+            for (int i = 0; i < len; i++) dst[i] = src[i];     // перекрытие
+        }
+        z->out_pos += len;
+    }
+}
+
+static const char *png_stored(PngInflate *z) {
+    png_bits(z, z->nbits & 7);      // до границы байта
+    unsigned len = png_bits(z, 16);
+    unsigned nlen = png_bits(z, 16);
+    if ((len ^ 0xFFFF) != nlen) return "bad stored block";
+    if (len > z->out_len - z->out_pos) return "too much image data";
+
+    // Сначала байты, уже взятые в буфер бит, остальное - memcpy
+    while (len && z->nbits >= 8) {
+        z->out[z->out_pos++] = png_bits(z, 8);
+        len--;
+    }
+    z->pos -= z->nbits / 8;         // непрочитанные байты буфера вернуть
+    z->bits = 0;
+    z->nbits = 0;
+    if (len > z->in_len - z->pos) return "truncated stored block";
+    memcpy(z->out + z->out_pos, z->in + z->pos, len);
+    z->out_pos += len;
+    z->pos += len;
+    return NULL;
+}
+
+static const char *png_dynamic(PngInflate *z, PngHuff *lit, PngHuff *dist) {
+    static const unsigned char order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    unsigned char lengths[320];
+    int nlen = png_bits(z, 5) + 257;
+    int ndist = png_bits(z, 5) + 1;
+    int ncode = png_bits(z, 4) + 4;
+    if (nlen > 286 || ndist > 30) return "bad dynamic block";
+
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++) lengths[order[i]] = png_bits(z, 3);
+    if (!png_huff_build(lit, lengths, 19)) return "bad code lengths";
+
+    for (int i = 0; i < nlen + ndist;) {
+        int sym = png_decode_sym(z, lit);
+        if (sym < 0 || z->overrun) return "bad code lengths";
+        if (sym < 16) {
+            lengths[i++] = sym;
+            continue;
+        }
+        int rep, value = 0;
+        if (sym == 16) {
+            if (i == 0) return "repeat with no first length";
+            value = lengths[i - 1];
+            rep = 3 + png_bits(z, 2);
+        } else if (sym == 17) {
+            rep = 3 + png_bits(z, 3);
+        } else {
+            rep = 11 + png_bits(z, 7);
+        }
+        if (i + rep > nlen + ndist) return "too many code lengths";
+        while (rep--) lengths[i++] = value;
+    }
+    if (lengths[256] == 0) return "no end-of-block code";
+    if (!png_huff_build(lit, lengths, nlen) ||
+        !png_huff_build(dist, lengths + nlen, ndist)) return "bad code lengths";
+    return NULL;
+}
+
+// zlib поток in -> out ровно out_len байт
+static const char *png_inflate(const unsigned char *in, long in_len, unsigned char *out, long out_len) {
+    PngInflate z;
+    static PngHuff fixed_lit, fixed_dist;
+    static int fixed_ready;
+    PngHuff lit, dist;
+
+    if (in_len < 2 || (in[0] & 0x0F) != 8 || (in[0] << 8 | in[1]) % 31 != 0 || (in[1] & 0x20)) {
+        return "bad zlib header";
+    }
+    memset(&z, 0, sizeof(z));
+    z.in = in;
+    z.in_len = in_len;
+    z.pos = 2;
+    z.out = out;
+    z.out_len = out_len;
+
+    if (!fixed_ready) {
+        unsigned char lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        png_huff_build(&fixed_lit, lengths, 288);
+        memset(lengths, 5, 30);
+        png_huff_build(&fixed_dist, lengths, 30);
+        fixed_ready = 1;
+    }
+
+    int last;
+    do {
+        last = png_bits(&z, 1);
+        int type = png_bits(&z, 2);
+        const char *err;
+        if (type == 0) {
+            err = png_stored(&z);
+        } else if (type == 1) {
+            err = png_codes(&z, &fixed_lit, &fixed_dist);
+        } else if (type == 2) {
+            err = png_dynamic(&z, &lit, &dist);
+            if (!err) err = png_codes(&z, &lit, &dist);
+        } else {
+            err = "bad block type";
+        }
+        if (err) return err;
+        if (z.overrun) return "truncated image data";
+    } while (!last);
+
+    return z.out_pos == out_len ? NULL : "not enough image data";
+}
+
+// Предсказатель Paeth: p - a = b - c, p - b = a - c,
+// p - c = (a - c) + (b - c). Выбор записан тернарными операторами -
+// компилятор делает его через cmov, без непредсказуемых ветвлений
+static inline int png_paeth(int a, int b, int c) {
+    int pa = b - c, pb = a - c, pc = pa + pb;
+    pa = pa < 0 ? -pa : pa;
+    pb = pb < 0 ? -pb : pb;
+    pc = pc < 0 ? -pc : pc;
+    int ab = pb < pa ? b : a;
+    int min_ab = pb < pa ? pb : pa;
+    return pc < min_ab ? c : ab;
+}
+
+// Строка Paeth для RGBA (bpp 4) - самый частый случай у иконок. Каналы
+// пикселя независимы: левый и левый-верхний отсчеты четырех каналов
+// держатся в регистрах, и четыре цепочки зависимостей идут параллельно
+static void png_paeth_rgba(unsigned char *row, const unsigned char *prev, long stride) {
+    int a0, a1, a2, a3;
+    int c0 = prev[0], c1 = prev[1], c2 = prev[2], c3 = prev[3];
+    a0 = row[0] = row[0] + c0;
+    a1 = row[1] = row[1] + c1;
+    a2 = row[2] = row[2] + c2;
+    a3 = row[3] = row[3] + c3;
+    for (long i = 4; i + 4 <= stride; i += 4) {
+        int b0 = prev[i], b1 = prev[i + 1], b2 = prev[i + 2], b3 = prev[i + 3];
+        a0 = (row[i] + png_paeth(a0, b0, c0)) & 0xFF;
+        a1 = (row[i + 1] + png_paeth(a1, b1, c1)) & 0xFF;
+        a2 = (row[i + 2] + png_paeth(a2, b2, c2)) & 0xFF;
+        a3 = (row[i + 3] + png_paeth(a3, b3, c3)) & 0xFF;
+        row[i] = a0;
+        row[i + 1] = a1;
+        row[i + 2] = a2;
+        row[i + 3] = a3;
+        c0 = b0;
+        c1 = b1;
+        c2 = b2;
+        c3 = b3;
+    }
+}
+
+// Обратные фильтры на месте. raw - строки по 1 + stride байт
+static const char *png_unfilter(unsigned char *raw, int h, long stride, int bpp) {
+    unsigned char *prev = NULL;
+    for (int y = 0; y < h; y++) {
+        unsigned char *row = raw + y * (stride + 1);
+        int filter = row[0];
+        row++;
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (long i = bpp; i < stride; i++) row[i] += row[i - bpp];
+                break;
+            case 2:
+                if (prev) for (long i = 0; i < stride; i++) row[i] += prev[i];
+                break;
+            case 3:
+                for (long i = 0; i < stride; i++) {
+                    int left = i >= bpp ? row[i - bpp] : 0;
+                    int up = prev ? prev[i] : 0;
+                    row[i] += (left + up) >> 1;
+                }
+                break;
+            case 4:
+                if (!prev) {
+                    // Без строки сверху Paeth совпадает с Sub
+                    for (long i = bpp; i < stride; i++) row[i] += row[i - bpp];
+                    break;
+                }
+                if (bpp == 4) {
+                    png_paeth_rgba(row, prev, stride);
+                    break;
+                }
+                for (long i = 0; i < bpp; i++) row[i] += prev[i];
+                for (long i = bpp; i < stride; i++) {
+                    row[i] += png_paeth(row[i - bpp], prev[i], prev[i - bpp]);
+                }
+                break;
+            default:
+                return "bad filter type";
+        }
+        prev = row;
+    }
+    return NULL;
+}
+
+static unsigned png_be32(const unsigned char *p) {
+    return (unsigned)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Отсчет номер i строки глубины depth (для глубин меньше 8 - из бит)
+static unsigned png_sample(const unsigned char *row, long i, int depth) {
+    switch (depth) {
+        case 16: return row[i * 2];     // старший байт
+        case 8:  return row[i];
+        default: {
+            long bit = i * depth;
+            return row[bit >> 3] >> (8 - depth - (bit & 7)) & ((1 << depth) - 1);
+        }
+    }
+}
+
+static int png_fail(PngImage *img, const char *error) {
+    free(img->argb);
+    img->argb = NULL;
+    img->error = error;
+    return 0;
+}
+
+// Разбор файла целиком. 0 - ошибка в img->error
+static int png_read(const unsigned char *data, long len, PngImage *img) {
+    static const unsigned char sig[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+    unsigned palette[256];
+    int npalette = 0;
+    int trns_gray = -1, trns_r = -1, trns_g = -1, trns_b = -1;
+    int depth = 0, color = -1;
+    const unsigned char *idat = NULL;
+    unsigned char *joined = NULL;   // если IDAT несколько - склеенные
+    long idat_len = 0;
+
+    memset(img, 0, sizeof(*img));
+    for (int i = 0; i < 256; i++) palette[i] = 0xFF000000;
+    if (len < 8 || memcmp(data, sig, 8) != 0) return png_fail(img, "not a PNG");
+
+    long pos = 8;
+    while (pos + 12 <= len) {
+        unsigned clen = png_be32(data + pos);
+        const unsigned char *type = data + pos + 4;
+        const unsigned char *body = data + pos + 8;
+        if (clen > (unsigned long)(len - pos - 12)) {
+            free(joined);
+            return png_fail(img, "truncated chunk");
+        }
+        pos += 12 + clen;
+
+        if (memcmp(type, "IHDR", 4) == 0 && clen >= 13) {
+            img->w = png_be32(body);
+            img->h = png_be32(body + 4);
+            depth = body[8];
+            color = body[9];
+            if (body[12]) return png_fail(img, "interlaced PNG not supported");
+            if (body[10] || body[11]) return png_fail(img, "unknown compression");
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            npalette = clen / 3 > 256 ? 256 : clen / 3;
+            for (int i = 0; i < npalette; i++) {
+                palette[i] = 0xFF000000 | body[i * 3] << 16 | body[i * 3 + 1] << 8 | body[i * 3 + 2];
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (color == 3) {
+                for (unsigned i = 0; i < clen && i < 256; i++) {
+                    palette[i] = (palette[i] & 0xFFFFFF) | (unsigned)body[i] << 24;
+                }
+            } else if (color == 0 && clen >= 2) {
+                trns_gray = body[0] << 8 | body[1];
+            } else if (color == 2 && clen >= 6) {
+                trns_r = body[0] << 8 | body[1];
+                trns_g = body[2] << 8 | body[3];
+                trns_b = body[4] << 8 | body[5];
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            if (!idat) {
+                idat = body;
+            } else {
+                // Несколько IDAT - один поток zlib, склеиваем
+                unsigned char *p = realloc(joined, idat_len + clen);
+                if (!p) {
+                    free(joined);
+                    return png_fail(img, "out of memory");
+                }
+                if (!joined) memcpy(p, idat, idat_len);
+                joined = p;
+                memcpy(joined + idat_len, body, clen);
+                idat = joined;
+            }
+            idat_len += clen;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+    }
+
+    static const int channels_of[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    int channels = color >= 0 && color <= 6 ? channels_of[color] : 0;
+    int depth_ok = depth == 8 || (depth == 16 && color != 3) ||
+                   ((depth == 1 || depth == 2 || depth == 4) && (color == 0 || color == 3));
+    const char *err = NULL;
+    if (!channels || !depth_ok) err = "unsupported color type or depth";
+    else if (img->w <= 0 || img->h <= 0 || (long)img->w * img->h > PNG_MAX_PIXELS) err = "bad image size";
+    else if (!idat) err = "no image data";
+    if (err) {
+        free(joined);
+        return png_fail(img, err);
+    }
+
+    int bits = channels * depth;
+    int bpp = bits >= 8 ? bits / 8 : 1;
+    long stride = ((long)img->w * bits + 7) / 8;
+    unsigned char *raw = malloc((stride + 1) * img->h);
+    img->argb = malloc((size_t)img->w * img->h * sizeof(unsigned));
+    if (!raw || !img->argb) {
+        free(raw);
+        free(joined);
+        return png_fail(img, "out of memory");
+    }
+
+    err = png_inflate(idat, idat_len, raw, (stride + 1) * img->h);
+    free(joined);
+    if (!err) err = png_unfilter(raw, img->h, stride, bpp);
+    if (err) {
+        free(raw);
+        return png_fail(img, err);
+    }
+
+    // Строки -> ARGB
+    int step = depth == 16 ? 2 : 1;
+    for (int y = 0; y < img->h; y++) {
+        const unsigned char *row = raw + y * (stride + 1) + 1;
+        unsigned *out = img->argb + (long)y * img->w;
+        switch (color) {
+            case 6:     // RGBA
+                if (depth == 8) {
+                    for (int x = 0; x < img->w; x++, row += 4) {
+                        out[x] = (unsigned)row[3] << 24 | row[0] << 16 | row[1] << 8 | row[2];
+                    }
+                } else {
+                    for (int x = 0; x < img->w; x++, row += 8) {
+                        out[x] = (unsigned)row[6] << 24 | row[0] << 16 | row[2] << 8 | row[4];
+                    }
+                }
+                break;
+            case 2:     // RGB
+                for (int x = 0; x < img->w; x++, row += 3 * step) {
+                    int r = row[0], g = row[step], b = row[2 * step];
+                    unsigned a = 0xFF;
+                    if (trns_r >= 0) {
+                        int tr = depth == 16 ? (row[0] << 8 | row[1]) : r;
+                        int tg = depth == 16 ? (row[2] << 8 | row[3]) : g;
+                        int tb = depth == 16 ? (row[4] << 8 | row[5]) : b;
+                        if (tr == trns_r && tg == trns_g && tb == trns_b) a = 0;
+                    }
+                    out[x] = a << 24 | r << 16 | g << 8 | b;
+                }
+                break;
+            case 4:     // серый с альфой
+                for (int x = 0; x < img->w; x++, row += 2 * step) {
+                    unsigned v = row[0];
+                    out[x] = (unsigned)row[step] << 24 | v << 16 | v << 8 | v;
+                }
+                break;
+            case 3:     // палитра
+                for (int x = 0; x < img->w; x++) out[x] = palette[png_sample(row, x, depth)];
+                break;
+            case 0: {   // серый
+                int max = (1 << (depth > 8 ? 8 : depth)) - 1;
+                for (int x = 0; x < img->w; x++) {
+                    unsigned s = png_sample(row, x, depth);
+                    unsigned v = s * 255 / max;
+                    unsigned a = 0xFF;
+                    if (trns_gray >= 0) {
+                        int t = depth == 16 ? (row[x * 2] << 8 | row[x * 2 + 1]) : (int)s;
+                        if (t == trns_gray) a = 0;
+                    }
+                    out[x] = a << 24 | v << 16 | v << 8 | v;
+                }
+                break;
+            }
+        }
+    }
+    free(raw);
+    return 1;
+}
+
+#endif
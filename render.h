@@ -0,0 +1,346 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+// Тонкий слой рисования с двумя реализациями:
+//  RENDER_XLIB - обычный путь через X сервер (цвета и GC из XResources,
+//                примитивы копятся в XBatch и сбрасываются в r_flush);
+//  RENDER_SOFT - программная растеризация в буфер пикселей в памяти.
+// Программный вариант не требует X сервера: функции отрисовки можно
+// гонять в бенчмарках на сборочных машинах и сравнивать снимки кадров
+// (r_save_ppm).
+//
+// Цвета задаются как 0xRRGGBB. Текст в программном режиме рисуется
+// встроенным шрифтом 5x7 в ячейке 6x13 (метрики как у шрифта "6x13").
+//
+// Метка кадра: при FRAME_MARK=1 в окружении каждый r_flush записывает
+// в свойство _BENCH_FRAME окна пару {номер кадра, запросов за кадр}.
+// По PropertyNotify на нем bench/latency замеряет задержку от ввода
+// до отправленного кадра.
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xres.h"
+#include "xbatch.h"
+
+#define RENDER_SOFT_CELL_W   6
+#define RENDER_SOFT_ASCENT  10
+#define RENDER_SOFT_DESCENT  3
+
+typedef enum {
+    RENDER_XLIB,
+    RENDER_SOFT
+} RenderKind;
+
+typedef struct {
+    RenderKind kind;
+    int width, height;
+    int ascent, descent;
+    unsigned long prims;        // нарисовано примитивов (для бенчмарков)
+
+    // RENDER_XLIB
+    Display *dpy;
+    Drawable drawable;
+    Font fid;
+    XResources *res;
+    XBatch *batch;
+    FontMetrics *metrics;
+    Atom mark_atom;             // _BENCH_FRAME или None
+    Window mark_window;
+    unsigned long mark_seq;
+    unsigned long mark_request; // NextRequest на предыдущей метке
+
+    // RENDER_SOFT
+    unsigned int *pixels;       // width * height, 0xRRGGBB
+} Renderer;
+
+// Шрифт 5x7, символы 0x20..0x7E, по 5 столбцов, младший бит - верхняя строка
+static const unsigned char render_font5x7[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00},
+    {0x14,0x7F,0x14,0x7F,0x14}, {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62},
+    {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00}, {0x00,0x1C,0x22,0x41,0x00},
+    {0x00,0x41,0x22,0x1C,0x00}, {0x08,0x2A,0x1C,0x2A,0x08}, {0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00},
+    {0x20,0x10,0x08,0x04,0x02}, {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00},
+    {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31}, {0x18,0x14,0x12,0x7F,0x10},
+    {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+    {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00},
+    {0x00,0x56,0x36,0x00,0x00}, {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14},
+    {0x41,0x22,0x14,0x08,0x00}, {0x02,0x01,0x51,0x09,0x06}, {0x32,0x49,0x79,0x41,0x3E},
+    {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x01,0x01},
+    {0x3E,0x41,0x41,0x51,0x32}, {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00},
+    {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, {0x7F,0x40,0x40,0x40,0x40},
+    {0x7F,0x02,0x04,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46},
+    {0x46,0x49,0x49,0x49,0x31}, {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F},
+    {0x1F,0x20,0x40,0x20,0x1F}, {0x7F,0x20,0x18,0x20,0x7F}, {0x63,0x14,0x08,0x14,0x63},
+    {0x03,0x04,0x78,0x04,0x03}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x00,0x7F,0x41,0x41},
+    {0x02,0x04,0x08,0x10,0x20}, {0x41,0x41,0x7F,0x00,0x00}, {0x04,0x02,0x01,0x02,0x04},
+    {0x40,0x40,0x40,0x40,0x40}, {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78},
+    {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, {0x38,0x44,0x44,0x48,0x7F},
+    {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x08,0x14,0x54,0x54,0x3C},
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00},
+    {0x00,0x7F,0x10,0x28,0x44}, {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78},
+    {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, {0x7C,0x14,0x14,0x14,0x08},
+    {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+    {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C},
+    {0x3C,0x40,0x30,0x40,0x3C}, {0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C},
+    {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, {0x00,0x00,0x7F,0x00,0x00},
+    {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}
+};
+
+static void render_init_xlib(Renderer *r, Display *dpy, Drawable drawable,
+                             XResources *res, XBatch *batch, XFontStruct *font,
+                             FontMetrics *metrics, int width, int height) {
+    memset(r, 0, sizeof(*r));
+    r->kind = RENDER_XLIB;
+    r->width = width;
+    r->height = height;
+    r->dpy = dpy;
+    r->drawable = drawable;
+    r->fid = font ? font->fid : None;
+    r->res = res;
+    r->batch = batch;
+    r->metrics = metrics;
+    if (res && batch) xres_set_flush(res, xb_flush_ctx, batch);
+    r->ascent = font ? font->ascent : 0;
+    r->descent = font ? font->descent : 0;
+
+    const char *mark = getenv("FRAME_MARK");
+    if (mark && *mark && *mark != '0') {
+        r->mark_atom = XInternAtom(dpy, "_BENCH_FRAME", False);
+        r->mark_window = drawable;
+        r->mark_request = NextRequest(dpy);
+    }
+}
+
+static int render_init_soft(Renderer *r, int width, int height) {
+    memset(r, 0, sizeof(*r));
+    r->kind = RENDER_SOFT;
+    r->width = width;
+    r->height = height;
+    r->ascent = RENDER_SOFT_ASCENT;
+    r->descent = RENDER_SOFT_DESCENT;
+    r->pixels = malloc(sizeof(unsigned int) * width * height);
+    if (!r->pixels) return 0;
+    for (int i = 0; i < width * height; i++) r->pixels[i] = 0xFFFFFF;
+    return 1;
+}
+
+static void render_free(Renderer *r) {
+    free(r->pixels);
+    r->pixels = NULL;
+}
+
+// ---------- Xlib ----------
+static GC render_gc(Renderer *r, unsigned int rgb) {
+    unsigned short red = ((rgb >> 16) & 0xFF) * 257;
+    unsigned short green = ((rgb >> 8) & 0xFF) * 257;
+    unsigned short blue = (rgb & 0xFF) * 257;
+    unsigned long pixel = xres_color(r->res, red, green, blue);
+    return xres_gc(r->res, pixel, WhitePixel(r->dpy, r->res->screen), r->fid);
+}
+
+// ---------- software ----------
+static void soft_span(Renderer *r, unsigned int rgb, int x, int y, int w, int h) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > r->width) w = r->width - x;
+    if (y + h > r->height) h = r->height - y;
+    if (w <= 0 || h <= 0) return;
+
+    for (int yy = y; yy < y + h; yy++) {
+        unsigned int *row = r->pixels + yy * r->width;
+        for (int xx = x; xx < x + w; xx++) row[xx] = rgb;
+    }
+}
+
+static void soft_plot(Renderer *r, unsigned int rgb, int x, int y) {
+    if (x >= 0 && y >= 0 && x < r->width && y < r->height) {
+        r->pixels[y * r->width + x] = rgb;
+    }
+}
+
+static void soft_line(Renderer *r, unsigned int rgb, int x1, int y1, int x2, int y2) {
+    // Брезенхэм
+    int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        soft_plot(r, rgb, x1, y1);
+        if (x1 == x2 && y1 == y2) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x1 += sx; }
+        if (e2 <= dx) { err += dx; y1 += sy; }
+    }
+}
+
+// Заливка многоугольника по строкам (правило чет-нечет, центры пикселей)
+static void soft_polygon(Renderer *r, unsigned int rgb, const XPoint *pts, int n) {
+    int ymin = pts[0].y, ymax = pts[0].y;
+    for (int i = 1; i < n; i++) {
+        if (pts[i].y < ymin) ymin = pts[i].y;
+        if (pts[i].y > ymax) ymax = pts[i].y;
+    }
+    if (ymin < 0) ymin = 0;
+    if (ymax >= r->height) ymax = r->height - 1;
+
+    int *xs = malloc(sizeof(int) * n);
+    if (!xs) return;
+    for (int y = ymin; y <= ymax; y++) {
+        double cy = y + 0.5;
+        int nx = 0;
+        for (int i = 0, j = n - 1; i < n; j = i++) {
+            const XPoint *a = &pts[i], *b = &pts[j];
+            if ((a->y <= cy) == (b->y <= cy)) continue;
+            double x = a->x + (cy - a->y) * (b->x - a->x) / (b->y - a->y);
+            // Вставкой: пересечений на строке единицы
+            int k = nx++;
+            while (k > 0 && xs[k - 1] > (int)(x + 0.5)) {
+                xs[k] = xs[k - 1];
+                k--;
+            }
+            xs[k] = (int)(x + 0.5);
+        }
+        for (int k = 0; k + 1 < nx; k += 2) soft_span(r, rgb, xs[k], y, xs[k + 1] - xs[k], 1);
+    }
+    free(xs);
+}
+
+static void soft_text(Renderer *r, unsigned int rgb, int x, int y, const char *s, int len) {
+    // Глиф 5x7 стоит на базовой линии: нижняя строка глифа - y - 1
+    int top = y - 7;
+    for (int i = 0; i < len; i++, x += RENDER_SOFT_CELL_W) {
+        unsigned char c = s[i];
+        if (c < 0x20 || c > 0x7E) continue;
+        const unsigned char *g = render_font5x7[c - 0x20];
+        for (int col = 0; col < 5; col++) {
+            for (int row = 0; row < 7; row++) {
+                if (g[col] & (1 << row)) soft_plot(r, rgb, x + col, top + row);
+            }
+        }
+    }
+}
+
+// ---------- операции ----------
+// Очистка фоном окна (белым)
+static void r_clear(Renderer *r, int x, int y, int w, int h) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        XClearArea(r->dpy, r->drawable, x, y, w, h, False);
+    } else {
+        soft_span(r, 0xFFFFFF, x, y, w, h);
+    }
+}
+
+static void r_fill(Renderer *r, unsigned int rgb, int x, int y, int w, int h) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        xb_fill(r->batch, render_gc(r, rgb), x, y, w, h);
+    } else {
+        soft_span(r, rgb, x, y, w, h);
+    }
+}
+
+// Контур как у XDrawRectangle: занимает (w + 1) x (h + 1) пикселей
+static void r_rect(Renderer *r, unsigned int rgb, int x, int y, int w, int h) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        xb_rect(r->batch, render_gc(r, rgb), x, y, w, h);
+    } else {
+        soft_span(r, rgb, x, y, w + 1, 1);
+        soft_span(r, rgb, x, y + h, w + 1, 1);
+        soft_span(r, rgb, x, y, 1, h + 1);
+        soft_span(r, rgb, x + w, y, 1, h + 1);
+    }
+}
+
+static void r_line(Renderer *r, unsigned int rgb, int x1, int y1, int x2, int y2) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        xb_line(r->batch, render_gc(r, rgb), x1, y1, x2, y2);
+    } else {
+        soft_line(r, rgb, x1, y1, x2, y2);
+    }
+}
+
+// Ломаная из n точек - один XDrawLines на серию графика
+static void r_polyline(Renderer *r, unsigned int rgb, const XPoint *pts, int n) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        xb_poly(r->batch, render_gc(r, rgb), pts, n, 0);
+    } else {
+        for (int i = 1; i < n; i++) soft_line(r, rgb, pts[i - 1].x, pts[i - 1].y, pts[i].x, pts[i].y);
+    }
+}
+
+// Залитый многоугольник - один XFillPolygon
+static void r_polygon(Renderer *r, unsigned int rgb, const XPoint *pts, int n) {
+    r->prims++;
+    if (n < 3) return;
+    if (r->kind == RENDER_XLIB) {
+        xb_poly(r->batch, render_gc(r, rgb), pts, n, 1);
+    } else {
+        soft_polygon(r, rgb, pts, n);
+    }
+}
+
+static void r_text(Renderer *r, unsigned int rgb, int x, int y, const char *s, int len) {
+    r->prims++;
+    if (r->kind == RENDER_XLIB) {
+        xb_text(r->batch, render_gc(r, rgb), x, y, s, len);
+    } else {
+        soft_text(r, rgb, x, y, s, len);
+    }
+}
+
+static int r_text_width(Renderer *r, const char *s, int len) {
+    if (r->kind == RENDER_XLIB) {
+        return r->metrics ? fm_text_width(r->metrics, s, len) : 0;
+    }
+    return len * RENDER_SOFT_CELL_W;
+}
+
+// Отметить отправленный кадр (только при FRAME_MARK=1). Вызывается из
+// r_flush и из окон, рисующих мимо Renderer (просмотр файла).
+static void r_mark_frame(Renderer *r) {
+    if (r->kind != RENDER_XLIB || r->mark_atom == None) return;
+
+    long data[2];
+    data[0] = ++r->mark_seq;
+    data[1] = NextRequest(r->dpy) - r->mark_request;
+    XChangeProperty(r->dpy, r->mark_window, r->mark_atom, XA_CARDINAL, 32,
+                    PropModeReplace, (unsigned char *)data, 2);
+    r->mark_request = NextRequest(r->dpy);
+}
+
+static void r_flush(Renderer *r) {
+    if (r->kind == RENDER_XLIB) {
+        xb_flush(r->batch);
+        r_mark_frame(r);
+        XFlush(r->dpy);
+    }
+}
+
+// Снимок программного буфера в PPM (P6) для сравнения кадров
+static int r_save_ppm(const Renderer *r, const char *path) {
+    if (r->kind != RENDER_SOFT) return 0;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return 0;
+
+    fprintf(f, "P6\n%d %d\n255\n", r->width, r->height);
+    for (int i = 0; i < r->width * r->height; i++) {
+        unsigned int p = r->pixels[i];
+        fputc((p >> 16) & 0xFF, f);
+        fputc((p >> 8) & 0xFF, f);
+        fputc(p & 0xFF, f);
+    }
+    return fclose(f) == 0;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+// Таймеры главного цикла на колесе.
+// Колесо - SCHED_SLOTS ячеек по SCHED_TICK_MS; таймер лежит в ячейке
+// своего такта срабатывания по модулю числа ячеек, так что вставка и
+// удаление - O(1), а за проход колеса просматриваются только ячейки
+// прошедших тактов. Таймеры дальше одного оборота (обновление погоды раз
+// в 10 минут) лежат в той же ячейке и пропускаются, пока их такт не
+// наступит.
+// Главный цикл спит в poll не дольше sched_timeout_ms() и после poll
+// зовет sched_run(): он срабатывает просроченные таймеры. Таймер -
+// структура вызывающего (SchedTimer), памяти планировщик не выделяет;
+// из обработчика таймер можно взвести снова.
+//
+// sched_backoff() - задержка повтора после n-й ошибки подряд:
+// экспоненциальная от base до max, со случайной долей ("equal jitter":
+// половина задержки плюс случайное от нуля до половины), чтобы клиенты,
+// потерявшие сеть одновременно, не повторяли запросы хором.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SCHED_SLOTS   256
+#define SCHED_TICK_MS 10
+
+typedef struct SchedTimer SchedTimer;
+typedef void (*SchedFn)(SchedTimer *t);
+
+struct SchedTimer {
+    SchedTimer *next;
+    SchedTimer **prev;      // ссылка на себя в списке ячейки; NULL - не взведен
+    unsigned long tick;     // такт срабатывания
+    SchedFn fn;
+    void *ctx;
+};
+
+typedef struct {
+    SchedTimer *slots[SCHED_SLOTS];
+    double start_ms;
+    unsigned long tick;     // последний обработанный такт
+    int count;
+
+    unsigned long fired;
+    unsigned long scanned;  // просмотрено ячеек
+} Sched;
+
+static double sched_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static unsigned long sched_now_tick(const Sched *s) {
+    return (unsigned long)((sched_now_ms() - s->start_ms) / SCHED_TICK_MS);
+}
+
+static void sched_init(Sched *s) {
+    memset(s, 0, sizeof(*s));
+    s->start_ms = sched_now_ms();
+    srandom((unsigned)time(NULL) ^ (unsigned)getpid());
+}
+
+static int sched_armed(const SchedTimer *t) {
+    return t->prev != NULL;
+}
+
+static void sched_cancel(Sched *s, SchedTimer *t) {
+    if (!sched_armed(t)) return;
+    *t->prev = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+    s->count--;
+}
+
+// Взвести t через delay_ms (уже взведенный переносится)
+static void sched_add(Sched *s, SchedTimer *t, double delay_ms, SchedFn fn, void *ctx) {
+    sched_cancel(s, t);
+    if (delay_ms < 0) delay_ms = 0;
+    // Срок округляется вверх до такта, и не раньше следующего такта
+    double due = sched_now_ms() - s->start_ms + delay_ms;
+    unsigned long tick = (unsigned long)(due / SCHED_TICK_MS);
+    if (tick * SCHED_TICK_MS < due) tick++;
+    if (tick <= s->tick) tick = s->tick + 1;
+
+    SchedTimer **head = &s->slots[tick % SCHED_SLOTS];
+    t->tick = tick;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->next = *head;
+    t->prev = head;
+    if (*head) (*head)->prev = &t->next;
+    *head = t;
+    s->count++;
+}
+
+// Мс до ближайшего таймера для poll; -1 - таймеров нет
+static int sched_timeout_ms(const Sched *s) {
+    if (s->count == 0) return -1;
+    unsigned long now = sched_now_tick(s);
+
+    // Обычно ближайший таймер - в пределах оборота: первая непустая
+    // ячейка с таймером этого оборота
+    unsigned long best = 0;
+    int found = 0;
+    for (unsigned long tick = s->tick + 1; tick <= s->tick + SCHED_SLOTS; tick++) {
+        for (const SchedTimer *t = s->slots[tick % SCHED_SLOTS]; t; t = t->next) {
+            if (t->tick == tick) {
+                best = tick;
+                found = 1;
+                break;
+            }
+        }
+        if (found) break;
+    }
+    if (!found) {
+        // Все таймеры дальше оборота - минимум по всем
+        for (int i = 0; i < SCHED_SLOTS; i++) {
+            for (const SchedTimer *t = s->slots[i]; t; t = t->next) {
+                if (!found || t->tick < best) best = t->tick;
+                found = 1;
+            }
+        }
+    }
+    if (best <= now) return 0;
+    double due = s->start_ms + (double)best * SCHED_TICK_MS;
+    double left = due - sched_now_ms();
+    return left > 0 ? (int)left + 1 : 0;
+}
+
+// Сработать все просроченные таймеры. Возвращает их число
+static int sched_run(Sched *s) {
+    unsigned long now = sched_now_tick(s);
+    int fired = 0;
+    if (now <= s->tick) return 0;
+
+    // После долгого сна (больше оборота) каждая ячейка смотрится один раз
+    unsigned long from = now - s->tick > SCHED_SLOTS ? now - SCHED_SLOTS + 1 : s->tick + 1;
+    for (unsigned long tick = from; tick <= now; tick++) {
+        SchedTimer **head = &s->slots[tick % SCHED_SLOTS];
+        s->scanned++;
+        SchedTimer *t = *head;
+        while (t) {
+            SchedTimer *next = t->next;
+            if (t->tick <= now) {
+                sched_cancel(s, t);
+                s->tick = tick;     // взведенные из обработчика - не в прошлое
+                t->fn(t);
+                fired++;
+                // Обработчик мог снять или переложить и соседние таймеры
+                next = *head;
+            }
+            t = next;
+        }
+    }
+    s->tick = now;
+    s->fired += fired;
+    return fired;
+}
+
+// Задержка повтора после failures ошибок подряд (1, 2, ...)
+static double sched_backoff(int failures, double base_ms, double max_ms) {
+    double delay = base_ms;
+    for (int i = 1; i < failures && delay < max_ms; i++) delay *= 2;
+    if (delay > max_ms) delay = max_ms;
+    return delay / 2 + (double)random() / RAND_MAX * delay / 2;
+}
+
+static void sched_report(const Sched *s, FILE *out) {
+    fprintf(out, "Scheduler: %lu timers fired, %lu wheel slots scanned, %d pending\n",
+            s->fired, s->scanned, s->count);
+}
+
+#endif
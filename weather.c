@@ -9,12 +9,52 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/resource.h>
+
+#include "render.h"
+#include "fetch.h"
+#include "json.h"
+#include "httpcache.h"
+#include "sched.h"
+#include "forecast.h"
+#include "chart.h"
+#include "history.h"
+#include "citydb.h"
 
 #define WINDOW_WIDTH  600
 #define WINDOW_HEIGHT 600
-#define BUFFER_SIZE 4096
 #define MAX_CITY_LENGTH 50
 #define CLOUD_HEIGHT 100
+#define COLOR_FG 0x000000
+
+// Автообновление: период (WEATHER_REFRESH, с), повторы после ошибок сети
+// от RETRY_BASE_MS до RETRY_MAX_MS, мок-данные - только после
+// MOCK_AFTER_FAILURES ошибок подряд, если показать больше нечего
+#define REFRESH_DEFAULT_S   600
+#define RETRY_BASE_MS       5000
+#define RETRY_MAX_MS        300000
+#define MOCK_AFTER_FAILURES 3
+
+// Прогноз (/data/2.5/forecast) меняется раз в 3 часа: повторно для того
+// же города не чаще FORECAST_REFRESH_MS
+#define FORECAST_REFRESH_MS (30 * 60 * 1000)
+#define COLOR_TEMP     0xC03020
+#define COLOR_HUMIDITY 0x3070D0
+#define COLOR_PRECIP   0x9CC8F0
+#define COLOR_GRID     0xB0B0B0
+#define COLOR_RANGE    0xF0C8B8
+
+// График истории (клавиша H): последние HISTORY_DAYS суток
+#define HISTORY_DAYS 14
+
+// Подсказки городов под полем ввода (citydb.h)
+#define SUGGEST_MAX   6
+#define SUGGEST_X     150
+#define SUGGEST_W     240
+#define SUGGEST_ROW   20
+#define COLOR_SELECT  0xD0DCF4
 /* ===== Cloud background XPM ===== */
 static const char *cloud_xpm[] = {
 "200 17 3 1",
@@ -64,16 +104,91 @@ static const char *cloud_xpm[] = {
 #define OPENWEATHER_API_KEY "68682c4ce7b5e11bfcefb6a4af50e437"
 #define DEFAULT_CITY "Ryazan"
 
+// Нужные окну поля ответа /data/2.5/weather
+typedef struct {
+    int cod;                // 200 или код ошибки ("404" приходит строкой)
+    double temp;            // Кельвины
+    double feels_like;
+    int humidity;
+    char description[50];
+    char name[MAX_CITY_LENGTH];
+    char message[80];       // текст ошибки API
+    int id;                 // id города OpenWeatherMap
+    double dt;              // время наблюдения, Unix time
+    unsigned long found;    // биты WF_* - поле было в ответе
+} WeatherReply;
+
+enum { WF_COD, WF_TEMP, WF_FEELS_LIKE, WF_HUMIDITY, WF_DESCRIPTION, WF_NAME, WF_MESSAGE, WF_ID, WF_DT, WF_COUNT };
+
+static const JsonField weather_fields[WF_COUNT] = {
+    JSON_FIELD("cod",                    JSON_F_INT,    WeatherReply, cod),
+    JSON_FIELD("main.temp",              JSON_F_DOUBLE, WeatherReply, temp),
+    JSON_FIELD("main.feels_like",        JSON_F_DOUBLE, WeatherReply, feels_like),
+    JSON_FIELD("main.humidity",          JSON_F_INT,    WeatherReply, humidity),
+    JSON_FIELD("weather[0].description", JSON_F_TEXT,   WeatherReply, description),
+    JSON_FIELD("name",                   JSON_F_TEXT,   WeatherReply, name),
+    JSON_FIELD("message",                JSON_F_TEXT,   WeatherReply, message),
+    JSON_FIELD("id",                     JSON_F_INT,    WeatherReply, id),
+    JSON_FIELD("dt",                     JSON_F_DOUBLE, WeatherReply, dt),
+};
+
+// Дрейф полосы облаков (см. cloud_anim_*)
+typedef struct {
+    int fps;                // 0 - полоса стоит (WEATHER_CLOUD_FPS)
+    int mapped;             // главное окно отображено
+    int visible;            // полоса не закрыта целиком
+    int phase;              // сдвиг полосы, 0..cloud_w-1
+    double next_us;         // срок следующего кадра
+    double resumed_us;      // начало текущего отрезка движения
+    double active_us;       // время в движении за прошлые отрезки
+    unsigned long frames;
+    unsigned long dropped;  // кадры, пропущенные из-за опоздания
+} CloudAnim;
+
 typedef struct {
     Display* display;
     Window window;
     GC gc;
     int screen;
-    Pixmap cloud_pixmap;
+    Pixmap cloud_pixmap;    // плитка cloud_xpm
     Pixmap cloud_mask;
     int cloud_w;
     int cloud_h;
+    Window band;            // дочернее окно полосы облаков
+    Pixmap band_pixmap;     // собранная полоса (+ плитка на сдвиг) - фон band
+    int band_w;
+    CloudAnim anim;
+    int mapped;             // окно отображено (не свернуто)
+    Sched sched;            // таймеры главного цикла
+    SchedTimer refresh;     // следующее обновление погоды city
+    double refresh_ms;      // период автообновления
+    int failures;           // ошибок сети подряд для loading_city
+    int refresh_pending;    // срок обновления пришел, пока окно свернуто
     XFontStruct* main_font;
+    FontMetrics metrics;    // ширины глифов main_font
+    XResources res;
+    XBatch batch;
+    Renderer r;             // Xlib или программный буфер (--headless)
+    Fetch fetch;            // текущий запрос погоды (не блокирует окно)
+    JsonParser json;        // разбирает тело fetch по мере прихода
+    WeatherReply reply;
+    HttpBuffer body;        // то же тело целиком - для кэша
+    HttpCacheEntry cached;  // запись кэша для loading_city (валидаторы, тело)
+    char cache_key[256];
+    int loading;            // ждем ответ для loading_city
+    char loading_city[MAX_CITY_LENGTH];
+    char live_city[MAX_CITY_LENGTH];   // город, для которого на экране живые данные
+    Fetch forecast_fetch;   // прогноз - отдельным запросом (тот же пул соединений)
+    JsonParser forecast_json;
+    Forecast forecast_next; // разбирается сейчас
+    Forecast forecast;      // на экране
+    char forecast_city[MAX_CITY_LENGTH];
+    double forecast_ms;     // sched_now_ms() получения forecast
+    int width;              // размер окна (ConfigureNotify)
+    int height;
+    int show_history;       // внизу график истории, а не прогноз
+    HistoryMap history;     // история города на экране
+    int city_id;            // id города на экране (0 - неизвестен)
     
     char temperature[20];
     char feels_like[20];
@@ -83,13 +198,37 @@ typedef struct {
     char city[MAX_CITY_LENGTH];
     char input_city[MAX_CITY_LENGTH];
     int input_active;
+    const CityRecord* suggest[SUGGEST_MAX];    // подсказки для input_city
+    int nsuggest;
+    int suggest_sel;        // выбранная стрелками, -1 - нет
+    int city_pick;          // id города city из справочника, 0 - нет
+    unsigned long suggest_lookups;
+    double suggest_us;      // суммарное время поиска подсказок
 } WeatherApp;
 
 int get_weather_mock(WeatherApp* app, const char* city);
-int http_get(const char* host, const char* path, char* response, int response_size);
-int parse_weather_json(const char* json, WeatherApp* app);
-int get_weather(WeatherApp* app, const char* api_key, const char* city);
+int parse_weather_json(const char* json, long len, WeatherReply* reply);
+int apply_weather_reply(WeatherApp* app, const WeatherReply* reply);
+void request_weather(WeatherApp* app, const char* city);
+int show_cached_weather(WeatherApp* app);
+int load_snapshot(WeatherApp* app, const char* city);
+void save_snapshot(WeatherApp* app);
+void finish_weather(WeatherApp* app);
+void request_forecast(WeatherApp* app, const char* city);
+void finish_forecast(WeatherApp* app);
+void draw_forecast(WeatherApp* app, int y);
+void record_history(const WeatherReply* reply, const char* query);
+void draw_history(WeatherApp* app, int y);
+void refresh_weather(WeatherApp* app);
+void schedule_refresh(WeatherApp* app, double delay_ms);
+void schedule_retry(WeatherApp* app);
 void draw_weather(WeatherApp* app);
+void compose_cloud_band(WeatherApp* app, int width);
+void cloud_anim_init(WeatherApp* app);
+void cloud_anim_set(WeatherApp* app, int mapped, int visible);
+int cloud_anim_timeout_ms(const WeatherApp* app);
+void cloud_anim_tick(WeatherApp* app);
+void cloud_anim_report(const WeatherApp* app, double t_launch);
 void initialize_app(WeatherApp* app);
 void cleanup_app(WeatherApp* app);
 void handle_key_press(WeatherApp* app, XKeyEvent event, const char** current_city);
@@ -123,245 +262,449 @@ XFontStruct* load_large_font(Display* display) {
     return NULL;
 }
 
-// Функция для записи HTTP ответа
-size_t write_callback(void* ptr, size_t size, size_t nmemb, char* response) {
+// Функция для записи HTTP ответа: кусок тела дописывается в буфер запроса.
+// Счетчик принятых байт живет в самом буфере, у каждого запроса свой
+size_t write_callback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    HttpBuffer* response = userdata;
     size_t total_size = size * nmemb;
-    static size_t total_received = 0;
-    
-    if (total_received + total_size >= BUFFER_SIZE - 1) {
+
+    if (!http_buffer_append(response, ptr, total_size)) {
         return 0;
     }
-    
-    memcpy(response + total_received, ptr, total_size);
-    total_received += total_size;
-    response[total_received] = '\0';
-    
     return total_size;
 }
 
-// функция для HTTP GET запроса
-int http_get(const char* host, const char* path, char* response, int response_size) {
-    int sockfd;
-    struct hostent* server;
-    struct sockaddr_in serv_addr;
-    
-    printf("Connecting to %s...\n", host);
-    
-    sockfd = socket(AF_INET, SOCK_STREAM, 0); //Создание TCP-сокета
-    if (sockfd < 0) {
-        perror("socket");
-        return -1;
+// Сервер API: WEATHER_API="хост:порт" (например, заглушка bench/owmserver
+// на 127.0.0.1:8080), по умолчанию api.openweathermap.org:80
+static const char* api_server(int* port) {
+    static char host[64];
+    static int api_port;
+    if (!host[0]) {
+        const char* env = getenv("WEATHER_API");
+        snprintf(host, sizeof(host), "%s", env && env[0] ? env : "api.openweathermap.org");
+        char* colon = strrchr(host, ':');
+        api_port = colon && atoi(colon + 1) > 0 ? atoi(colon + 1) : 80;
+        if (colon) *colon = '\0';
+        if (env && env[0]) printf("Using API server %s:%d\n", host, api_port);
     }
-    
-    server = gethostbyname(host); //Преобразование доменного имени в IP-адрес
-    if (server == NULL) {
-        fprintf(stderr, "Error: no such host %s\n", host);
-        close(sockfd);
-        return -1;
+    *port = api_port;
+    return host;
+}
+
+// Разбор JSON ответа OpenWeatherMap за один проход (json.h).
+// Поля берутся по полному пути, так что "temp" из вложенного объекта
+// или "name" из "sys" не перепутаются с нужными
+int parse_weather_json(const char* json, long len, WeatherReply* reply) {
+    JsonParser parser;
+
+    printf("Parsing JSON response...\n");
+    memset(reply, 0, sizeof(*reply));
+    json_init(&parser, weather_fields, WF_COUNT, reply);
+    if (!json_parse(&parser, json, len)) {
+        fprintf(stderr, "JSON error: %s\n", parser.error);
+        return 0;
     }
-    
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(80); // HTTP
-    
-    printf("Attempting connection to %s...\n", host);
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        perror("connect");
-        close(sockfd);
-        return -1;
+    reply->found = parser.found;
+    return 1;
+}
+
+// Справочник городов (citydb.h): открывается при первом обращении и
+// держится отображенным до выхода - подсказки указывают прямо в него
+static CityDb city_db;
+
+static const CityDb* cities(void) {
+    static int opened;
+    if (!opened) {
+        opened = 1;
+        http_cache_init();
+        if (citydb_open(&city_db, http_cache.dir)) {
+            printf("City list: %u cities\n", city_db.h->ncities);
+        } else {
+            printf("City list not available, no suggestions\n");
+        }
     }
-    
-    // Формируем HTTP запрос
-    char request[1024];
-    snprintf(request, sizeof(request),
-             "GET %s HTTP/1.1\r\n"
-             "Host: %s\r\n"
-             "User-Agent: Minix3-Weather/1.0\r\n"
-             "Connection: close\r\n\r\n",
-             path, host);
-    
-    printf("Sending request...\nPath: %s\n", path);
-    if (write(sockfd, request, strlen(request)) < 0) {
-        perror("write");
-        close(sockfd);
-        return -1;
+    return &city_db;
+}
+
+// Город в URL: id= для города из справочника (выбранного подсказкой или
+// найденного по точному имени) и для числа, иначе q= с текстом как есть
+static void city_param(const WeatherApp* app, const char* city, char* out, int size) {
+    int id = app && app->city_pick && strcmp(city, app->city) == 0 ? app->city_pick : 0;
+    if (!id && city[0] && city[strspn(city, "0123456789")] == '\0') id = atoi(city);
+    if (!id) {
+        const CityRecord* c = citydb_exact(cities(), city);
+        if (c) id = c->id;
     }
-    
-    // Читаем ответ
-    int total_read = 0;
-    int n;
-    char buffer[1024];
-    int header_ended = 0;
-    
-    printf("Reading response...\n");
-    while ((n = read(sockfd, buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[n] = '\0';
-        
-        // Пропускаем HTTP заголовки
-        if (!header_ended) {
-            char* header_end = strstr(buffer, "\r\n\r\n");
-            if (header_end) {
-                header_ended = 1;
-                int body_start = header_end - buffer + 4;
-                int body_size = n - body_start;
-                if (body_size > 0 && total_read + body_size < response_size) {
-                    memcpy(response + total_read, buffer + body_start, body_size);
-                    total_read += body_size;
-                }
-            }
+    if (id) snprintf(out, size, "id=%d", id);
+    else snprintf(out, size, "q=%s", city);
+}
+
+// Разобранный ответ API: данные погоды или текст ошибки в app->error
+int apply_weather_reply(WeatherApp* app, const WeatherReply* reply) {
+    if (reply->cod != 200) {
+        if (reply->found & 1 << WF_MESSAGE) {
+            snprintf(app->error, sizeof(app->error), "API Error: %s", reply->message);
         } else {
-            if (total_read + n < response_size) {
-                memcpy(response + total_read, buffer, n);
-                total_read += n;
-            }
+            strcpy(app->error, "API returned error");
         }
+        return 0;
     }
-    
-    if (n < 0) {
-        perror("read");
-        close(sockfd);
-        return -1;
+
+    // Температуры приходят в Кельвинах
+    if (reply->found & 1 << WF_TEMP) {
+        snprintf(app->temperature, sizeof(app->temperature), "%.1f", reply->temp - 273.15);
     }
-    
-    response[total_read] = '\0';
-    close(sockfd);
-    
-    printf("Received %d bytes of data\n", total_read);
-    return total_read;
+    if (reply->found & 1 << WF_FEELS_LIKE) {
+        snprintf(app->feels_like, sizeof(app->feels_like), "%.1f", reply->feels_like - 273.15);
+    }
+    if (reply->found & 1 << WF_HUMIDITY) {
+        snprintf(app->humidity, sizeof(app->humidity), "%d", reply->humidity);
+    }
+    if (reply->found & 1 << WF_DESCRIPTION) strcpy(app->description, reply->description);
+    if (reply->found & 1 << WF_NAME) strcpy(app->city, reply->name);
+    app->city_id = reply->found & 1 << WF_ID ? reply->id : 0;
+    return 1;
 }
 
-// Парсим JSON ответ от OpenWeatherMap
-int parse_weather_json(const char* json, WeatherApp* app) {
-    // парсинг JSON 
-    printf("Parsing JSON response...\n");
-    
-    // Ищем температуру
-    char* temp_ptr = strstr(json, "\"temp\":");
-    if (temp_ptr) {
-        temp_ptr += 7; // Пропускаем "\"temp\":"
-        char* end_ptr = strchr(temp_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - temp_ptr;
-            if (len < sizeof(app->temperature) - 1) {
-                strncpy(app->temperature, temp_ptr, len);
-                app->temperature[len] = '\0';
-                // Конвертируем из Кельвина в Цельсий
-                float temp_k = atof(app->temperature);
-                float temp_c = temp_k - 273.15;
-                snprintf(app->temperature, sizeof(app->temperature), "%.1f", temp_c);
-            }
-        }
+// Наблюдение - в историю города (history.h). Время - dt из ответа: то же
+// наблюдение из кэша или общего запроса второй раз не запишется
+void record_history(const WeatherReply* reply, const char* query) {
+    HistoryRecord r;
+    memset(&r, 0, sizeof(r));
+    r.time = reply->found & 1 << WF_DT ? (long long)reply->dt : (long long)time(NULL);
+    r.temp = (float)(reply->temp - 273.15);
+    r.feels_like = (float)(reply->feels_like - 273.15);
+    r.humidity = (float)reply->humidity;
+    history_append(reply->found & 1 << WF_ID ? reply->id : 0,
+                   reply->found & 1 << WF_NAME ? reply->name : query, &r);
+}
+
+// ---------- snapshot ----------
+// Последние живые данные каждого города в двоичном файле (несколько КБ,
+// одно чтение): при старте окно сразу рисует их, пока идет запрос.
+// Файл - WEATHER_SNAPSHOT или snapshot.bin в каталоге кэша ответов.
+
+#define SNAPSHOT_MAGIC  0x314e5357      // "WSN1"
+#define SNAPSHOT_CITIES 16
+
+typedef struct {
+    char key[MAX_CITY_LENGTH];          // город, как его запрашивали
+    long saved;                         // time() получения
+    char temperature[20];
+    char feels_like[20];
+    char humidity[20];
+    char description[50];
+    char city[MAX_CITY_LENGTH];
+} WeatherSnapshot;
+
+typedef struct {
+    unsigned magic;
+    int count;
+    WeatherSnapshot cities[SNAPSHOT_CITIES];
+} SnapshotFile;
+
+static int snapshot_path(char* out, int size) {
+    const char* env = getenv("WEATHER_SNAPSHOT");
+    if (env) return snprintf(out, size, "%s", env) < size;
+    http_cache_init();
+    if (!http_cache.dir[0]) return 0;
+    return snprintf(out, size, "%s/snapshot.bin", http_cache.dir) < size;
+}
+
+static int snapshot_read(SnapshotFile* file) {
+    char path[300];
+    memset(file, 0, sizeof(*file));
+    if (!snapshot_path(path, sizeof(path))) return 0;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    int ok = fread(file, sizeof(*file), 1, f) == 1 &&
+             file->magic == SNAPSHOT_MAGIC &&
+             file->count >= 0 && file->count <= SNAPSHOT_CITIES;
+    fclose(f);
+    if (!ok) memset(file, 0, sizeof(*file));
+    return ok;
+}
+
+// Снимок для города на экран. 1 - был
+int load_snapshot(WeatherApp* app, const char* city) {
+    SnapshotFile file;
+    if (!snapshot_read(&file)) return 0;
+
+    for (int i = 0; i < file.count; i++) {
+        WeatherSnapshot* s = &file.cities[i];
+        if (strncmp(s->key, city, sizeof(s->key)) != 0) continue;
+
+        memcpy(app->temperature, s->temperature, sizeof(app->temperature));
+        memcpy(app->feels_like, s->feels_like, sizeof(app->feels_like));
+        memcpy(app->humidity, s->humidity, sizeof(app->humidity));
+        memcpy(app->description, s->description, sizeof(app->description));
+        memcpy(app->city, s->city, sizeof(app->city));
+        app->city[sizeof(app->city) - 1] = '\0';
+        snprintf(app->live_city, sizeof(app->live_city), "%s", city);
+        printf("Snapshot for %s from %ld s ago\n", city, (long)time(NULL) - s->saved);
+        return 1;
     }
-    
-    // Ищем ощущаемую температуру
-    char* feels_ptr = strstr(json, "\"feels_like\":");
-    if (feels_ptr) {
-        feels_ptr += 13; 
-        char* end_ptr = strchr(feels_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - feels_ptr;
-            if (len < sizeof(app->feels_like) - 1) {
-                strncpy(app->feels_like, feels_ptr, len);
-                app->feels_like[len] = '\0';
-                // Конвертируем из Кельвина в Цельсий
-                float feels_k = atof(app->feels_like);
-                float feels_c = feels_k - 273.15;
-                snprintf(app->feels_like, sizeof(app->feels_like), "%.1f", feels_c);
-            }
-        }
+    return 0;
+}
+
+// Живые данные loading_city - в снимок (старейший город вытесняется)
+void save_snapshot(WeatherApp* app) {
+    SnapshotFile file;
+    char path[300], tmp[310];
+    snapshot_read(&file);
+    file.magic = SNAPSHOT_MAGIC;
+
+    WeatherSnapshot* s = NULL;
+    for (int i = 0; i < file.count && !s; i++) {
+        if (strncmp(file.cities[i].key, app->loading_city, MAX_CITY_LENGTH) == 0) s = &file.cities[i];
     }
-    
-    // Ищем влажность
-    char* humidity_ptr = strstr(json, "\"humidity\":");
-    if (humidity_ptr) {
-        humidity_ptr += 11; 
-        char* end_ptr = strchr(humidity_ptr, ',');
-        if (end_ptr) {
-            int len = end_ptr - humidity_ptr;
-            if (len < sizeof(app->humidity) - 1) {
-                strncpy(app->humidity, humidity_ptr, len);
-                app->humidity[len] = '\0';
-            }
+    if (!s && file.count < SNAPSHOT_CITIES) s = &file.cities[file.count++];
+    if (!s) {
+        s = &file.cities[0];
+        for (int i = 1; i < file.count; i++) {
+            if (file.cities[i].saved < s->saved) s = &file.cities[i];
         }
     }
-    
-    // Ищем описание погоды
-    char* desc_ptr = strstr(json, "\"description\":\"");
-    if (desc_ptr) {
-        desc_ptr += 15; 
-        char* end_ptr = strchr(desc_ptr, '"');
-        if (end_ptr) {
-            int len = end_ptr - desc_ptr;
-            if (len < sizeof(app->description) - 1) {
-                strncpy(app->description, desc_ptr, len);
-                app->description[len] = '\0';
-            }
+
+    memset(s, 0, sizeof(*s));
+    snprintf(s->key, sizeof(s->key), "%s", app->loading_city);
+    s->saved = time(NULL);
+    memcpy(s->temperature, app->temperature, sizeof(s->temperature));
+    memcpy(s->feels_like, app->feels_like, sizeof(s->feels_like));
+    memcpy(s->humidity, app->humidity, sizeof(s->humidity));
+    memcpy(s->description, app->description, sizeof(s->description));
+    memcpy(s->city, app->city, sizeof(s->city));
+
+    if (!snapshot_path(path, sizeof(path))) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return;
+    int ok = fwrite(&file, sizeof(file), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) remove(tmp);
+}
+
+// Тело ответа: в JSON парсер по мере прихода и в буфер для кэша
+size_t weather_sink(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    WeatherApp* app = userdata;
+    json_sink(ptr, size, nmemb, &app->json);
+    return write_callback(ptr, size, nmemb, &app->body);
+}
+
+// Ответ из кэша на экран. 1 - данные применены
+int show_cached_weather(WeatherApp* app) {
+    WeatherReply reply;
+    if (!parse_weather_json(app->cached.body.data, app->cached.body.len, &reply) ||
+        !apply_weather_reply(app, &reply)) {
+        return 0;
+    }
+    app->error[0] = '\0';
+    snprintf(app->live_city, sizeof(app->live_city), "%s", app->loading_city);
+    return 1;
+}
+
+// Асинхронная загрузка: запрос уходит, окно продолжает рисоваться.
+// Незавершенный запрос для прежнего города отменяется.
+// Свежий ответ из кэша (httpcache.h) показывается без сети; устаревший -
+// сразу, а в фоне уходит условный запрос.
+void request_weather(WeatherApp* app, const char* city) {
+    char url[512];
+    char param[80];
+    char validators[256];
+    int port;
+    const char* host = api_server(&port);
+    city_param(app, city, param, sizeof(param));
+    snprintf(url, sizeof(url), "/data/2.5/weather?%s&appid=%s", param, OPENWEATHER_API_KEY);
+
+    // Тот же запрос уже идет (Refresh несколько раз подряд, Enter и OK,
+    // таймер во время ручного обновления) - ждем его ответа, а не
+    // отменяем и повторяем
+    if (app->loading && fetch_join(&app->fetch, host, port, url)) {
+        printf("Request for %s already in flight, joined it\n", city);
+        return;
+    }
+    request_forecast(app, city);
+    if (fetch_busy(&app->fetch)) {
+        printf("Cancelling request for %s\n", app->loading_city);
+        fetch_cancel(&app->fetch);
+    }
+    printf("Getting weather for %s from OpenWeatherMap...\n", city);
+    // Новый город - счет ошибок заново; срок обновления назначит итог запроса
+    if (strcmp(app->loading_city, city) != 0) app->failures = 0;
+    sched_cancel(&app->sched, &app->refresh);
+    app->refresh_pending = 0;
+    snprintf(app->loading_city, sizeof(app->loading_city), "%s", city);
+    app->loading = 0;
+
+    http_cache_free(&app->cached);
+    http_cache_key(app->cache_key, sizeof(app->cache_key), host, port, url);
+    int cached = http_cache_lookup(app->cache_key, &app->cached);
+    if (cached != HTTP_CACHE_MISS && show_cached_weather(app)) {
+        printf("Cached weather for %s (%s, age %ld s)\n", city,
+               cached == HTTP_CACHE_FRESH ? "fresh" : "stale, revalidating",
+               http_cache_age(&app->cached));
+        if (cached == HTTP_CACHE_FRESH) {
+            // Следующее обновление - когда запись устареет
+            double left = (app->cached.h.max_age - http_cache_age(&app->cached)) * 1e3;
+            schedule_refresh(app, left < app->refresh_ms ? left : app->refresh_ms);
+            return;
         }
     }
-    
-    // Ищем название города
-    char* city_ptr = strstr(json, "\"name\":\"");
-    if (city_ptr) {
-        city_ptr += 8; // Пропускаем "\"name\":\""
-        char* end_ptr = strchr(city_ptr, '"');
-        if (end_ptr) {
-            int len = end_ptr - city_ptr;
-            if (len < sizeof(app->city) - 1) {
-                strncpy(app->city, city_ptr, len);
-                app->city[len] = '\0';
+
+    // Тело идет в парсер прямо из буфера чтения соединения
+    memset(&app->reply, 0, sizeof(app->reply));
+    json_init(&app->json, weather_fields, WF_COUNT, &app->reply);
+    http_buffer_reset(&app->body);
+    fetch_set_sink(&app->fetch, weather_sink, app);
+    http_cache_validators(&app->cached, validators, sizeof(validators));
+    fetch_set_headers(&app->fetch, validators);
+
+    app->loading = 1;
+    if (!fetch_start(&app->fetch, host, port, url)) {
+        finish_weather(app);
+    }
+}
+
+// Запрос из request_weather завершился - применяем ответ.
+// При ошибке или истекшем сроке остаются последние живые данные этого
+// города, если они есть, иначе - фиктивные.
+void finish_weather(WeatherApp* app) {
+    app->loading = 0;
+
+    // Не изменилось: тело из кэша верно, продлеваем запись
+    if (app->fetch.state == FETCH_DONE && app->fetch.status == 304 && app->cached.body.data) {
+        printf("Weather for %s not modified, cache entry extended\n", app->loading_city);
+        http_cache_refresh(&app->cached, &app->fetch.parser);
+        if (strcmp(app->live_city, app->loading_city) != 0) show_cached_weather(app);
+        app->failures = 0;
+        schedule_refresh(app, app->refresh_ms);
+        return;
+    }
+
+    if (app->fetch.state == FETCH_DONE && app->fetch.body_len > 0) {
+        printf("Received %ld bytes of data\n", app->fetch.body_len);
+        if (app->fetch.reused) {
+            printf("Connection reused: ~%.1f ms handshake saved\n", app->fetch.saved_ms);
+        }
+        app->error[0] = '\0';
+        app->reply.found = app->json.found;
+        if (!json_finish(&app->json)) {
+            // Оборванное или испорченное тело - как ошибка сети
+            printf("JSON error: %s\n", app->json.error);
+            schedule_retry(app);
+            return;
+        }
+        if (apply_weather_reply(app, &app->reply)) {
+            snprintf(app->live_city, sizeof(app->live_city), "%s", app->loading_city);
+            save_snapshot(app);
+            record_history(&app->reply, app->loading_city);
+            if (app->fetch.status == 200) {
+                http_cache_store(app->cache_key, &app->fetch.parser, app->body.data, app->body.len);
             }
+        } else {
+            // Ошибка API (неизвестный город и т.п.) частым повтором не лечится
+            get_weather_mock(app, app->loading_city);
         }
+        app->failures = 0;
+        schedule_refresh(app, app->refresh_ms);
+        return;
     }
-    
-    return 1;
+
+    printf("Network error (%s)\n", app->fetch.error);
+    schedule_retry(app);
 }
 
-// Получение данных о погоде
-int get_weather(WeatherApp* app, const char* api_key, const char* city) {
-    printf("Getting weather for %s from OpenWeatherMap...\n", city);
-    
-    char response[BUFFER_SIZE];
+// Прогноз для city, если на экране нет свежего (или он уже не идет).
+// Разбирается в forecast_next, на экран попадает только целиком
+void request_forecast(WeatherApp* app, const char* city) {
     char url[512];
-    
-    // Формируем URL для OpenWeatherMap API
-    snprintf(url, sizeof(url), 
-             "/data/2.5/weather?q=%s&appid=%s",
-             city, api_key);
-    
-    printf("API URL: %s\n", url);
-    
-    int result = http_get("api.openweathermap.org", url, response, BUFFER_SIZE);
-    
-    if (result > 0) {
-        printf("Successfully received weather data\n");
-        
-        if (strstr(response, "\"cod\":200")) {
-            // Успешный ответ
-            return parse_weather_json(response, app);
-        } else {
-            // Ошибка API
-            char* message_ptr = strstr(response, "\"message\":\"");
-            if (message_ptr) {
-                message_ptr += 11;
-                char* end_ptr = strchr(message_ptr, '"');
-                if (end_ptr) {
-                    int len = end_ptr - message_ptr;
-                    snprintf(app->error, sizeof(app->error), "API Error: %.*s", len, message_ptr);
-                }
-            } else {
-                strcpy(app->error, "API returned error");
-            }
-            return 0;
-        }
+    char param[80];
+    int port;
+    const char* host = api_server(&port);
+    city_param(app, city, param, sizeof(param));
+    snprintf(url, sizeof(url), "/data/2.5/forecast?%s&appid=%s", param, OPENWEATHER_API_KEY);
+    if (fetch_join(&app->forecast_fetch, host, port, url)) return;
+    if (strcmp(app->forecast_city, city) == 0 && app->forecast.n > 0 &&
+        sched_now_ms() - app->forecast_ms < FORECAST_REFRESH_MS) {
+        return;
+    }
+    // Прогноз другого города на экране не оставляем
+    if (strcmp(app->forecast_city, city) != 0) app->forecast.n = 0;
+    snprintf(app->forecast_city, sizeof(app->forecast_city), "%s", city);
+
+    forecast_init(&app->forecast_next, &app->forecast_json);
+    fetch_set_sink(&app->forecast_fetch, json_sink, &app->forecast_json);
+    if (!fetch_start(&app->forecast_fetch, host, port, url)) {
+        finish_forecast(app);
+    }
+}
+
+void finish_forecast(WeatherApp* app) {
+    if (app->forecast_fetch.state != FETCH_DONE) {
+        printf("Forecast for %s: network error (%s)\n", app->forecast_city, app->forecast_fetch.error);
+        return;
+    }
+    if (!forecast_finish(&app->forecast_next, &app->forecast_json)) {
+        printf("Forecast for %s: %s\n", app->forecast_city,
+               app->forecast_json.error ? app->forecast_json.error :
+               app->forecast_next.message[0] ? app->forecast_next.message : "no data");
+        return;
+    }
+    app->forecast = app->forecast_next;
+    app->forecast_ms = sched_now_ms();
+    printf("Forecast for %s: %d points, %ld bytes\n", app->forecast_city,
+           app->forecast.n, app->forecast_fetch.received);
+}
+
+// ---------- автообновление ----------
+// Погода текущего города обновляется таймером refresh раз в refresh_ms.
+// После ошибки сети повтор идет с экспоненциальной задержкой со случайной
+// долей (sched_backoff), а на экране остаются последние данные. Мок-данные
+// появляются, только если данных для города нет и ошибок подряд уже
+// MOCK_AFTER_FAILURES. Пока окно свернуто, сработавший таймер лишь
+// помечает refresh_pending - запрос уйдет при MapNotify.
+// Повторяется loading_city - город, который просил пользователь: app->city
+// пуст до первого ответа, а после него это имя из ответа API ("Moscow" на
+// "Москва") с другим ключом кэша и сбросом счета ошибок.
+void refresh_weather(WeatherApp* app) {
+    char city[MAX_CITY_LENGTH];
+    snprintf(city, sizeof(city), "%s", app->loading_city);  // request_weather пишет в loading_city
+    request_weather(app, city);
+}
+
+static void refresh_due(SchedTimer* t) {
+    WeatherApp* app = t->ctx;
+    if (!app->mapped) {
+        printf("Refresh for %s postponed: window iconified\n", app->loading_city);
+        app->refresh_pending = 1;
+        return;
+    }
+    refresh_weather(app);
+    draw_weather(app);
+}
+
+void schedule_refresh(WeatherApp* app, double delay_ms) {
+    sched_add(&app->sched, &app->refresh, delay_ms, refresh_due, app);
+}
+
+void schedule_retry(WeatherApp* app) {
+    app->failures++;
+    double delay = sched_backoff(app->failures, RETRY_BASE_MS, RETRY_MAX_MS);
+    schedule_refresh(app, delay);
+    printf("Retry %d for %s in %.1f s\n", app->failures, app->loading_city, delay / 1e3);
+
+    if (strcmp(app->live_city, app->loading_city) == 0) {
+        snprintf(app->error, sizeof(app->error), "Network %s, showing last data, retry in %.0f s",
+                 app->fetch.timed_out ? "timeout" : "error", delay / 1e3);
+    } else if (app->failures >= MOCK_AFTER_FAILURES) {
+        get_weather_mock(app, app->loading_city);
     } else {
-        // Сетевая ошибка - используем фиктивные данные
-        printf("Network error, using mock data\n");
-        return get_weather_mock(app, city);
+        snprintf(app->error, sizeof(app->error), "Network %s, retry in %.0f s",
+                 app->fetch.timed_out ? "timeout" : "error", delay / 1e3);
     }
 }
 
-// Фиктивные данные для демонстрации (если сеть не работает)
 int get_weather_mock(WeatherApp* app, const char* city) {
     const char* descriptions[] = {
         "clear sky", "few clouds", "scattered clouds", "broken clouds",
@@ -393,113 +736,465 @@ int get_weather_mock(WeatherApp* app, const char* city) {
     return 1;
 }
 
-// Отрисовка интерфейса
-void draw_weather(WeatherApp* app) {
-    XClearWindow(app->display, app->window);
-    XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-    
-    // Рисуем облака сверху полосой
-    if (app->cloud_pixmap != None) {
-        int x = 0;
-        int y = 0;
-        while (y < CLOUD_HEIGHT) {
-            int h = (y + app->cloud_h <= CLOUD_HEIGHT) ? app->cloud_h : (CLOUD_HEIGHT - y);
-            for (int xx = 0; xx < WINDOW_WIDTH; xx += app->cloud_w) {
-                XCopyArea(app->display, app->cloud_pixmap, app->window, app->gc,
-                          0, 0, app->cloud_w, h, xx, y);
-            }
-            y += app->cloud_h;
+// Монотонное время, мкс
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// ---------- полоса облаков ----------
+// Плитка cloud_xpm раскладывается по полосе CLOUD_HEIGHT во всю ширину
+// окна один раз - при запуске и при смене ширины - в band_pixmap. Он
+// становится фоном дочернего окна band: открывшуюся полосу X сервер
+// закрашивает сам, без запросов от клиента, а draw_weather ее вообще не
+// рисует. Ввод band не выбирает, нажатия уходят в главное окно.
+// band_pixmap шире окна на одну плитку: полоса периодична с шагом
+// cloud_w, так что кадр дрейфа со сдвигом phase - это просто окно
+// ширины width из band_pixmap начиная с x = phase.
+void compose_cloud_band(WeatherApp* app, int width) {
+    if (app->cloud_pixmap == None || width <= 0 || width == app->band_w) return;
+
+    double start = now_us();
+    Display* dpy = app->display;
+    int strip_w = width + app->cloud_w;
+    Pixmap band = XCreatePixmap(dpy, app->window, strip_w, CLOUD_HEIGHT,
+                                DefaultDepth(dpy, app->screen));
+    XSetForeground(dpy, app->gc, WhitePixel(dpy, app->screen));
+    XFillRectangle(dpy, band, app->gc, 0, 0, strip_w, CLOUD_HEIGHT);
+    XSetClipMask(dpy, app->gc, app->cloud_mask);
+    for (int y = 0; y < CLOUD_HEIGHT; y += app->cloud_h) {
+        for (int x = 0; x < strip_w; x += app->cloud_w) {
+            XSetClipOrigin(dpy, app->gc, x, y);
+            XCopyArea(dpy, app->cloud_pixmap, band, app->gc, 0, 0,
+                      app->cloud_w, app->cloud_h, x, y);
         }
     }
+    XSetClipMask(dpy, app->gc, None);
+    XSetForeground(dpy, app->gc, BlackPixel(dpy, app->screen));
+
+    if (app->band == None) {
+        app->band = XCreateSimpleWindow(dpy, app->window, 0, 0, width, CLOUD_HEIGHT, 0,
+                                        BlackPixel(dpy, app->screen), WhitePixel(dpy, app->screen));
+        XSelectInput(dpy, app->band, VisibilityChangeMask);
+        XMapWindow(dpy, app->band);
+    } else {
+        XResizeWindow(dpy, app->band, width, CLOUD_HEIGHT);
+    }
+    XSetWindowBackgroundPixmap(dpy, app->band, band);
+    XClearWindow(dpy, app->band);
+
+    if (app->band_pixmap != None) XFreePixmap(dpy, app->band_pixmap);
+    app->band_pixmap = band;
+    app->band_w = width;
+    printf("Cloud band composed: %dx%d in %.2f ms\n", width, CLOUD_HEIGHT, (now_us() - start) / 1e3);
+}
+
+// Дрейф полосы: раз в 1/fps секунды phase сдвигается на пиксель, и кадр -
+// один XCopyArea из band_pixmap в band (вся работа - на X сервере).
+// Кадры идут по таймеру в poll главного цикла, а не в цикле с usleep, и
+// только пока окно отображено и полоса видна хоть частично: при
+// UnmapNotify (свернуто) и VisibilityFullyObscured таймер не взводится и
+// процесс спит в poll. Счетчик кадров и getrusage в cloud_anim_report
+// дают fps и долю процессора.
+void cloud_anim_init(WeatherApp* app) {
+    const char* fps = getenv("WEATHER_CLOUD_FPS");
+    app->anim.fps = fps ? atoi(fps) : 30;
+    if (app->anim.fps < 0 || app->anim.fps > 200) app->anim.fps = 30;
+}
+
+static int cloud_anim_running(const WeatherApp* app) {
+    return app->anim.fps > 0 && app->anim.mapped && app->anim.visible && app->band_pixmap != None;
+}
+
+// Смена видимости окна или полосы
+void cloud_anim_set(WeatherApp* app, int mapped, int visible) {
+    CloudAnim* a = &app->anim;
+    int was = cloud_anim_running(app);
+    a->mapped = mapped;
+    a->visible = visible;
+    int now_running = cloud_anim_running(app);
+    double now = now_us();
+    if (!was && now_running) {
+        a->resumed_us = now;
+        a->next_us = now;
+    } else if (was && !now_running) {
+        a->active_us += now - a->resumed_us;
+    }
+}
+
+// Мс до следующего кадра для poll; -1 - дрейф стоит
+int cloud_anim_timeout_ms(const WeatherApp* app) {
+    if (!cloud_anim_running(app)) return -1;
+    double left = app->anim.next_us - now_us();
+    return left > 0 ? (int)(left / 1e3) + 1 : 0;
+}
+
+// Кадр, если подошел его срок
+void cloud_anim_tick(WeatherApp* app) {
+    CloudAnim* a = &app->anim;
+    if (!cloud_anim_running(app)) return;
+    double now = now_us();
+    if (now < a->next_us) return;
+
+    a->phase = (a->phase + 1) % app->cloud_w;
+    XCopyArea(app->display, app->band_pixmap, app->band, app->gc,
+              a->phase, 0, app->band_w, CLOUD_HEIGHT, 0, 0);
+    a->frames++;
+
+    // Ровный шаг; после долгой задержки - без серии догоняющих кадров
+    double period = 1e6 / a->fps;
+    a->next_us += period;
+    if (now - a->next_us > period) {
+        a->dropped += (unsigned long)((now - a->next_us) / period);
+        a->next_us = now + period;
+    }
+}
+
+// Итог: кадры, fps в движении и процессор процесса за все время работы
+void cloud_anim_report(const WeatherApp* app, double t_launch) {
+    const CloudAnim* a = &app->anim;
+    double active = a->active_us;
+    if (cloud_anim_running(app)) active += now_us() - a->resumed_us;
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double cpu_us = ru.ru_utime.tv_sec * 1e6 + ru.ru_utime.tv_usec +
+                    ru.ru_stime.tv_sec * 1e6 + ru.ru_stime.tv_usec;
+    double wall = now_us() - t_launch;
+
+    printf("Cloud drift: %lu frames in %.1f s moving (%.1f fps, target %d), %lu dropped; "
+           "process CPU %.2f s over %.1f s (%.2f%%)\n",
+           a->frames, active / 1e6, active > 0 ? a->frames / (active / 1e6) : 0.0, a->fps,
+           a->dropped, cpu_us / 1e6, wall / 1e6, wall > 0 ? cpu_us / wall * 100 : 0.0);
+}
+
+// ---------- подсказки городов ----------
+// На каждое нажатие в поле ввода - поиск по префиксу в справочнике
+// (citydb.h): двоичный поиск по отображенному файлу, без выделения
+// памяти. Список лежит под полем на месте строк City..Condition: пока он
+// открыт, эти строки не рисуются вовсе (фона, который их закрыл бы, нет).
+// Имена в списке латиницей: основной шрифт кириллицу не рисует, а ищется
+// и по русскому имени. Выбранный город запрашивается по id
+
+static void update_suggestions(WeatherApp* app) {
+    double start = now_us();
+    app->nsuggest = citydb_suggest(cities(), app->input_city, app->suggest, SUGGEST_MAX);
+    app->suggest_sel = -1;
+    app->suggest_us += now_us() - start;
+    app->suggest_lookups++;
+}
+
+static int suggest_top(void) {
+    return CLOUD_HEIGHT + 10 + 58;
+}
+
+// Подсказка под точкой (x, y), -1 - нет
+static int suggestion_at(const WeatherApp* app, int x, int y) {
+    if (!app->input_active || x < SUGGEST_X || x > SUGGEST_X + SUGGEST_W || y < suggest_top()) return -1;
+    int i = (y - suggest_top()) / SUGGEST_ROW;
+    return i < app->nsuggest ? i : -1;
+}
+
+static void draw_suggestions(WeatherApp* app) {
+    Renderer* r = &app->r;
+    const CityDb* db = cities();
+    int y = suggest_top();
+    for (int i = 0; i < app->nsuggest; i++) {
+        const CityRecord* c = app->suggest[i];
+        char row[80];
+        snprintf(row, sizeof(row), "%.24s, %.3s  %.1f %.1f", citydb_name(db, c), c->country, c->lat, c->lon);
+        if (i == app->suggest_sel) r_fill(r, COLOR_SELECT, SUGGEST_X, y + i * SUGGEST_ROW, SUGGEST_W, SUGGEST_ROW);
+        r_text(r, COLOR_FG, SUGGEST_X + 5, y + i * SUGGEST_ROW + 15, row, strlen(row));
+    }
+    r_rect(r, COLOR_FG, SUGGEST_X, y, SUGGEST_W, app->nsuggest * SUGGEST_ROW);
+}
+
+// Применить ввод: подсказку pick (-1 - набранный текст). Город из
+// справочника дальше зовется его именем латиницей и запрашивается по id
+static int apply_input_city(WeatherApp* app, int pick) {
+    const CityDb* db = cities();
+    const CityRecord* c = pick >= 0 && pick < app->nsuggest ? app->suggest[pick] : NULL;
+    if (!c && !app->input_city[0]) return 0;
+    if (!c) c = citydb_exact(db, app->input_city);
+
+    snprintf(app->city, sizeof(app->city), "%s", c ? citydb_name(db, c) : app->input_city);
+    app->city_pick = c ? c->id : 0;
+    app->input_city[0] = '\0';
+    app->input_active = 0;
+    app->nsuggest = 0;
+    if (c) printf("City changed to: %s (%s, id %d)\n", app->city, citydb_name_ru(db, c), c->id);
+    else printf("City changed to: %s\n", app->city);
+
+    request_weather(app, app->city);
+    return 1;
+}
+
+// Буквы кириллицы X11 (keysym 0x6c0..0x6df) - в порядке КОИ-8
+static const char cyrillic_keysyms[] = "юабцдефгхийклмнопярстужвьызшэщчъ";
+
+// Символ клавиши в UTF-8: ASCII и кириллица. Длина, 0 - не символ
+static int keysym_utf8(KeySym k, char* out) {
+    unsigned cp = 0;
+    if (k >= 0x20 && k <= 0x7e) {
+        cp = k;
+    } else if (k >= 0x6c0 && k <= 0x6ff) {
+        const unsigned char* s = (const unsigned char*)cyrillic_keysyms + 2 * (k & 31);
+        cp = (s[0] & 0x1F) << 6 | (s[1] & 0x3F);
+        if (k >= 0x6e0) cp -= 0x20;         // заглавные
+    } else if (k == XK_Cyrillic_io) {
+        cp = 0x451;
+    } else if (k == XK_Cyrillic_IO) {
+        cp = 0x401;
+    } else if (k >= 0x1000400 && k <= 0x10004ff) {
+        cp = k - 0x1000000;                 // keysym Unicode
+    }
+    if (cp == 0) return 0;
+    if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    }
+    out[0] = 0xC0 | cp >> 6;
+    out[1] = 0x80 | (cp & 0x3F);
+    return 2;
+}
+
+static void suggest_report(const WeatherApp* app) {
+    if (app->suggest_lookups == 0) return;
+    printf("Suggestions: %lu lookups, %.1f us average\n",
+           app->suggest_lookups, app->suggest_us / app->suggest_lookups);
+}
+
+// Отрисовка интерфейса
+void draw_weather(WeatherApp* app) {
+    Renderer* r = &app->r;
+    // Полосу облаков не трогаем: она - фон дочернего окна band, его
+    // закрашивает X сервер (очистка и рисование родителя его не задевают)
+    // Окно шире или выше исходного - стирается целиком, иначе за x = 600
+    // остаются старые линии графика
+    r_clear(r, 0, 0, app->width > WINDOW_WIDTH ? app->width : WINDOW_WIDTH,
+            app->height > WINDOW_HEIGHT ? app->height : WINDOW_HEIGHT);
 
     // Смещение всех элементов вниз на высоту полосы облаков
     int offset_y = CLOUD_HEIGHT + 10; // +10 пикселей от облаков
     
     // Заголовок
-    XDrawString(app->display, app->window, app->gc, 300, offset_y, "Weather App", 11);
+    r_text(r, COLOR_FG, 300, offset_y, "Weather App", 11);
     
     // Разделительная линия
-    XDrawLine(app->display, app->window, app->gc, 20, offset_y + 15, 580, offset_y + 15);
+    r_line(r, COLOR_FG, 20, offset_y + 15, 580, offset_y + 15);
 
     // поле для ввода города
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 45, "Enter city:", 11);
-
-    if (app->input_active){
-        XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-        XDrawRectangle(app->display, app->window, app->gc, 150, offset_y + 30, 200, 25);
-    } else {
-        XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
-        XDrawRectangle(app->display, app->window, app->gc, 150, offset_y + 30, 200, 25);
-    }
+    r_text(r, COLOR_FG, 50, offset_y + 45, "Enter city:", 11);
+    r_rect(r, COLOR_FG, 150, offset_y + 30, 200, 25);
     
     if (strlen(app->input_city) > 0){
-        XDrawString(app->display, app->window, app->gc, 155, offset_y + 47, app->input_city, strlen(app->input_city));
+        r_text(r, COLOR_FG, 155, offset_y + 47, app->input_city, strlen(app->input_city));
     }
 
     if (app->input_active) {
-    XFontStruct* font = XLoadQueryFont(app->display, "variable"); 
-        if (font) {
-            int text_width = XTextWidth(font, app->input_city, strlen(app->input_city));
-            XDrawLine(app->display, app->window, app->gc,
-                    155 + text_width, offset_y + 30,
-                    155 + text_width, offset_y + 55);
-            XFreeFont(app->display, font);
-        }
+        // Текст рисуется main_font, им же и меряем
+        int text_width = r_text_width(r, app->input_city, strlen(app->input_city));
+        r_line(r, COLOR_FG, 155 + text_width, offset_y + 30, 155 + text_width, offset_y + 55);
     }
 
     // Кнопка OK
-    XDrawRectangle(app->display, app->window, app->gc, 360, offset_y + 30, 30, 25);
-    XDrawString(app->display, app->window, app->gc, 365, offset_y + 47, "OK", 2);
+    r_rect(r, COLOR_FG, 360, offset_y + 30, 30, 25);
+    r_text(r, COLOR_FG, 365, offset_y + 47, "OK", 2);
 
-    // Город
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 85, "Current City:", 13);
-    XDrawString(app->display, app->window, app->gc, 170, offset_y + 85, app->city, strlen(app->city));
-    
-    // Температура
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 115, "Temperature:", 12);
-    if (strlen(app->temperature) > 0) {
-        char temp_str[50];
-        snprintf(temp_str, sizeof(temp_str), "%s °C", app->temperature);
-        XDrawString(app->display, app->window, app->gc, 170, offset_y + 115, temp_str, strlen(temp_str));
-    }
+    if (app->input_active && app->nsuggest > 0) {
+        draw_suggestions(app);
+    } else {
+        // Город
+        r_text(r, COLOR_FG, 50, offset_y + 85, "Current City:", 13);
+        r_text(r, COLOR_FG, 170, offset_y + 85, app->city, strlen(app->city));
     
-    // Ощущаемая температура
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 140, "Feels like:", 11);
-    if (strlen(app->feels_like) > 0) {
-        char feels_str[50];
-        snprintf(feels_str, sizeof(feels_str), "%s °C", app->feels_like);
-        XDrawString(app->display, app->window, app->gc, 170, offset_y + 140, feels_str, strlen(feels_str));
-    }
+        // Температура
+        r_text(r, COLOR_FG, 50, offset_y + 115, "Temperature:", 12);
+        if (strlen(app->temperature) > 0) {
+            char temp_str[50];
+            snprintf(temp_str, sizeof(temp_str), "%s °C", app->temperature);
+            r_text(r, COLOR_FG, 170, offset_y + 115, temp_str, strlen(temp_str));
+        }
     
-    // Влажность 
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 165, "Humidity:", 9);
-    if (strlen(app->humidity) > 0) {
-        char humidity_str[50];
-        snprintf(humidity_str, sizeof(humidity_str), "%s %%", app->humidity);
-        XDrawString(app->display, app->window, app->gc, 170, offset_y + 165, humidity_str, strlen(humidity_str)); 
-    }
+        // Ощущаемая температура
+        r_text(r, COLOR_FG, 50, offset_y + 140, "Feels like:", 11);
+        if (strlen(app->feels_like) > 0) {
+            char feels_str[50];
+            snprintf(feels_str, sizeof(feels_str), "%s °C", app->feels_like);
+            r_text(r, COLOR_FG, 170, offset_y + 140, feels_str, strlen(feels_str));
+        }
     
-    // Описание
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 190, "Condition:", 10);
-    XDrawString(app->display, app->window, app->gc, 170, offset_y + 190, app->description, strlen(app->description));
+        // Влажность 
+        r_text(r, COLOR_FG, 50, offset_y + 165, "Humidity:", 9);
+        if (strlen(app->humidity) > 0) {
+            char humidity_str[50];
+            snprintf(humidity_str, sizeof(humidity_str), "%s %%", app->humidity);
+            r_text(r, COLOR_FG, 170, offset_y + 165, humidity_str, strlen(humidity_str)); 
+        }
     
+        // Описание
+        r_text(r, COLOR_FG, 50, offset_y + 190, "Condition:", 10);
+        r_text(r, COLOR_FG, 170, offset_y + 190, app->description, strlen(app->description));
+    }
+
     // Кнопка обновления
-    XDrawRectangle(app->display, app->window, app->gc, 150, offset_y + 225, 100, 30);
-    XDrawString(app->display, app->window, app->gc, 170, offset_y + 245, "Refresh", 7);
+    r_rect(r, COLOR_FG, 150, offset_y + 225, 100, 30);
+    r_text(r, COLOR_FG, 170, offset_y + 245, "Refresh", 7);
     
     // Кнопка выхода
-    XDrawRectangle(app->display, app->window, app->gc, 270, offset_y + 225, 100, 30);
-    XDrawString(app->display, app->window, app->gc, 290, offset_y + 245, "Exit", 4);
+    r_rect(r, COLOR_FG, 270, offset_y + 225, 100, 30);
+    r_text(r, COLOR_FG, 290, offset_y + 245, "Exit", 4);
     
-    // Сообщение об ошибке 
-    if (strlen(app->error) > 0) {
-        XDrawString(app->display, app->window, app->gc, 50, offset_y + 285, "Note:", 5);
-        XDrawString(app->display, app->window, app->gc, 100, offset_y + 285, app->error, strlen(app->error));
+    // Сообщение об ошибке или ожидание ответа
+    if (app->loading) {
+        char loading_str[100];
+        snprintf(loading_str, sizeof(loading_str), "%s %s...",
+                 strcmp(app->live_city, app->loading_city) == 0 ? "Updating" : "Loading",
+                 app->loading_city);
+        r_text(r, COLOR_FG, 50, offset_y + 285, "Note:", 5);
+        r_text(r, COLOR_FG, 100, offset_y + 285, loading_str, strlen(loading_str));
+    } else if (strlen(app->error) > 0) {
+        r_text(r, COLOR_FG, 50, offset_y + 285, "Note:", 5);
+        r_text(r, COLOR_FG, 100, offset_y + 285, app->error, strlen(app->error));
     }
     
     // Инструкция 
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 325, "Click city field to type | Enter to apply", 38);
-    XDrawString(app->display, app->window, app->gc, 50, offset_y + 345, "Press Q to quit", 15);
+    r_text(r, COLOR_FG, 50, offset_y + 325, "Click city field to type | Enter to apply", 38);
+    r_text(r, COLOR_FG, 50, offset_y + 345, "Press Q to quit | H: history / forecast", 39);
+
+    if (app->show_history) draw_history(app, offset_y + 360);
+    else draw_forecast(app, offset_y + 360);
+    r_flush(r);
+}
+
+// График прогноза от y до низа окна: температура и влажность - по
+// ломаной на серию, осадки - залитой площадью; засечки - начало суток.
+// Серии уже лежат столбцами float, так что точки для XDrawLines /
+// XFillPolygon строятся одним проходом по массиву (chart.h), с
+// прореживанием, если точек больше, чем пикселей по ширине
+void draw_forecast(WeatherApp* app, int y) {
+    Renderer* r = &app->r;
+    const Forecast* fc = &app->forecast;
+    int width = app->width > 0 ? app->width : WINDOW_WIDTH;
+    int height = app->height > 0 ? app->height : WINDOW_HEIGHT;
+    if (fc->n < 2 || width < 160) return;
+
+    float tmin, tmax, pmin, pmax;
+    chart_range(fc->temp, fc->n, &tmin, &tmax);
+    chart_range(fc->precip, fc->n, &pmin, &pmax);
+
+    char title[120];
+    snprintf(title, sizeof(title), "5-day forecast: %.0f..%.0f °C, humidity, rain up to %.1f mm/3h",
+             tmin, tmax, pmax);
+    r_text(r, COLOR_FG, 50, y + 12, title, strlen(title));
+
+    ChartFrame f = { 50, y + 20, width - 100, height - y - 30, 0, fc->hours[fc->n - 1], 0, 0 };
+    if (f.h < 20) return;
+    XPoint pts[4 * WINDOW_WIDTH + 2];
+    int max = f.w * 4 + 2 < (int)(sizeof(pts) / sizeof(pts[0])) ? f.w * 4 + 2 :
+              (int)(sizeof(pts) / sizeof(pts[0]));
+
+    // Осадки - снизу, шкала не мельче 2 мм
+    f.v0 = 0;
+    f.v1 = pmax > 2 ? pmax : 2;
+    int n = chart_area(&f, fc->hours, fc->precip, fc->n, pts, max);
+    r_polygon(r, COLOR_PRECIP, pts, n);
+
+    // Полночь по UTC: засечки суток
+    for (float h = (float)(86400 - fc->t0 % 86400) / 3600; h < f.t1; h += 24) {
+        int x = chart_x(&f, h);
+        r_line(r, COLOR_GRID, x, f.y, x, f.y + f.h);
+    }
+    r_rect(r, COLOR_GRID, f.x, f.y, f.w, f.h);
+
+    f.v0 = 0;
+    f.v1 = 100;
+    n = chart_points(&f, fc->hours, fc->humidity, fc->n, pts, max);
+    r_polyline(r, COLOR_HUMIDITY, pts, n);
+
+    // Температура - на всю высоту рамки, с запасом в градус
+    f.v0 = tmin - 1;
+    f.v1 = tmax + 1;
+    n = chart_points(&f, fc->hours, fc->temp, fc->n, pts, max);
+    r_polyline(r, COLOR_TEMP, pts, n);
+}
+
+// История города на экране за HISTORY_DAYS суток: среднее по корзинам -
+// линия, от минимума до максимума - полоса (один многоугольник: верх
+// слева направо, низ обратно). Диапазон ищется двоичным поиском по
+// отображенному файлу, корзин - по две на пиксель ширины
+void draw_history(WeatherApp* app, int y) {
+    Renderer* r = &app->r;
+    int width = app->width > 0 ? app->width : WINDOW_WIDTH;
+    int height = app->height > 0 ? app->height : WINDOW_HEIGHT;
+    if (width < 160 || !app->city[0]) return;
+
+    // Отображение держится между кадрами; файл перечитывается, только если
+    // сменился город, и переотображается, только если вырос
+    HistoryMap* h = &app->history;
+    if (!h->map || (app->city_id ? h->header->id != app->city_id :
+                    strcasecmp(h->header->name, app->city) != 0)) {
+        if (!(app->city_id && history_open(h, app->city_id, app->city)) &&
+            !history_open(h, 0, app->city)) {
+            history_find(h, app->city);
+        }
+    }
+    history_sync(h);
+
+    long long now = time(NULL), t0 = now - HISTORY_DAYS * 86400LL;
+    long first;
+    long count = h->map ? history_range(h, t0, now + 1, &first) : 0;
+    char title[160];
+    if (count == 0) {
+        snprintf(title, sizeof(title), "History: no observations of %s in %d days (H - forecast)",
+                 app->city, HISTORY_DAYS);
+        r_text(r, COLOR_FG, 50, y + 12, title, strlen(title));
+        return;
+    }
+
+    HistorySummary sum;
+    history_summary(h, first, count, &sum);
+    char at_min[16], at_max[16];
+    time_t tmin = (time_t)sum.min_at, tmax = (time_t)sum.max_at;
+    strftime(at_min, sizeof(at_min), "%d.%m %H:%M", localtime(&tmin));
+    strftime(at_max, sizeof(at_max), "%d.%m %H:%M", localtime(&tmax));
+    snprintf(title, sizeof(title), "%d days, %ld obs: min %.1f (%s), max %.1f (%s), avg %.1f",
+             HISTORY_DAYS, count, sum.min, at_min, sum.max, at_max, sum.avg);
+    r_text(r, COLOR_FG, 50, y + 12, title, strlen(title));
+
+    ChartFrame f = { 50, y + 20, width - 100, height - y - 30,
+                     0, HISTORY_DAYS * 24.0f, sum.min - 1, sum.max + 1 };
+    if (f.h < 20) return;
+
+    enum { MAX_BUCKETS = WINDOW_WIDTH / 2 };
+    HistoryBucket buckets[MAX_BUCKETS];
+    int nb = f.w / 2 < MAX_BUCKETS ? f.w / 2 : MAX_BUCKETS;
+    nb = history_downsample(h, t0, now + 1, buckets, nb);
+
+    // Корзины - в столбцы, низ полосы - в обратном порядке
+    float hours[MAX_BUCKETS], avg[MAX_BUCKETS], hi[MAX_BUCKETS];
+    float back_hours[MAX_BUCKETS], lo[MAX_BUCKETS];
+    for (int i = 0; i < nb; i++) {
+        hours[i] = buckets[i].hours;
+        avg[i] = buckets[i].avg;
+        hi[i] = buckets[i].max;
+        back_hours[nb - 1 - i] = buckets[i].hours;
+        lo[nb - 1 - i] = buckets[i].min;
+    }
+    XPoint pts[4 * WINDOW_WIDTH];
+    int n = chart_points(&f, hours, hi, nb, pts, 2 * WINDOW_WIDTH);
+    n += chart_points(&f, back_hours, lo, nb, pts + n, 2 * WINDOW_WIDTH);
+    r_polygon(r, COLOR_RANGE, pts, n);
+
+    for (int d = 1; d < HISTORY_DAYS; d++) {
+        int x = chart_x(&f, d * 24.0f);
+        r_line(r, COLOR_GRID, x, f.y, x, f.y + f.h);
+    }
+    r_rect(r, COLOR_GRID, f.x, f.y, f.w, f.h);
+
+    n = chart_points(&f, hours, avg, nb, pts, 4 * WINDOW_WIDTH);
+    r_polyline(r, COLOR_TEMP, pts, n);
 }
 
 // Обработка нажатий клавиш
@@ -508,47 +1203,53 @@ void handle_key_press(WeatherApp* app, XKeyEvent event, const char** current_cit
     
     char buffer[10];
     KeySym keysym;
-    int count = XLookupString(&event, buffer, sizeof(buffer) - 1, &keysym, NULL);
+    XLookupString(&event, buffer, sizeof(buffer) - 1, &keysym, NULL);
     
-    if (count > 0) {
-        buffer[count] = '\0';
-        
-        if (keysym == XK_BackSpace) {
-            // Удаление последнего символа
-            if (strlen(app->input_city) > 0) {
-                app->input_city[strlen(app->input_city) - 1] = '\0';
-            }
-        }
-        else if (keysym == XK_Return || keysym == XK_KP_Enter) {
-            // Применение введенного города
-            if (strlen(app->input_city) > 0) {
-                strcpy(app->city, app->input_city);
-                *current_city = app->city;
-                app->input_city[0] = '\0';
-                app->input_active = 0;
-                
-                printf("City changed to: %s\n", app->city);
-                
-                // Получаем погоду для нового города
-                if (!get_weather(app, OPENWEATHER_API_KEY, app->city)) {
-                    get_weather_mock(app, app->city);
-                }
-            }
-        }
-        else if (keysym == XK_Escape) {
-            // Отмена ввода
-            app->input_city[0] = '\0';
-            app->input_active = 0;
-        }
-        else if (buffer[0] >= 32 && buffer[0] <= 126) {
-            // Добавление символа
-            if (strlen(app->input_city) < MAX_CITY_LENGTH - 1) {
-                strncat(app->input_city, buffer, 1);
-            }
+    if (keysym == XK_BackSpace) {
+        // Удаление последнего символа (UTF-8 - целиком)
+        int len = strlen(app->input_city);
+        while (len > 0 && (app->input_city[len - 1] & 0xC0) == 0x80) len--;
+        if (len > 0) len--;
+        app->input_city[len] = '\0';
+        update_suggestions(app);
+    }
+    else if (keysym == XK_Return || keysym == XK_KP_Enter) {
+        // Применение выбранной подсказки или введенного города
+        if (apply_input_city(app, app->suggest_sel)) *current_city = app->city;
+    }
+    else if (keysym == XK_Escape) {
+        // Отмена ввода
+        app->input_city[0] = '\0';
+        app->input_active = 0;
+        app->nsuggest = 0;
+    }
+    else if ((keysym == XK_Down || keysym == XK_Up) && app->nsuggest > 0) {
+        // Выбор подсказки; за краем списка - снова набранный текст
+        int sel = app->suggest_sel + (keysym == XK_Down ? 1 : -1);
+        if (sel < -1) sel = app->nsuggest - 1;
+        if (sel >= app->nsuggest) sel = -1;
+        app->suggest_sel = sel;
+    }
+    else if (keysym == XK_Tab && app->nsuggest > 0) {
+        // Дополнение до имени подсказки
+        const CityRecord* c = app->suggest[app->suggest_sel >= 0 ? app->suggest_sel : 0];
+        snprintf(app->input_city, sizeof(app->input_city), "%s", citydb_name(cities(), c));
+        update_suggestions(app);
+    }
+    else {
+        // Добавление символа
+        char ch[2];
+        int n = keysym_utf8(keysym, ch);
+        int len = strlen(app->input_city);
+        if (n == 0) return;
+        if (len + n < MAX_CITY_LENGTH) {
+            memcpy(app->input_city + len, ch, n);
+            app->input_city[len + n] = '\0';
+            update_suggestions(app);
         }
-        
-        draw_weather(app);
     }
+    
+    draw_weather(app);
 }
 
 // Инициализация приложения
@@ -566,6 +1267,7 @@ void initialize_app(WeatherApp* app) {
         fprintf(stderr, "Failed to load any font!\n");
         exit(1);
     }
+    fm_init(&app->metrics, app->main_font);
 
     app->screen = DefaultScreen(app->display);
     app->window = XCreateSimpleWindow(app->display, 
@@ -576,13 +1278,17 @@ void initialize_app(WeatherApp* app) {
     
     XStoreName(app->display, app->window, "MINIX3 Weather");
     XSelectInput(app->display, app->window, 
-                ExposureMask | KeyPressMask | ButtonPressMask);
+                ExposureMask | KeyPressMask | ButtonPressMask | StructureNotifyMask);
     
     app->gc = XCreateGC(app->display, app->window, 0, NULL);
     XSetForeground(app->display, app->gc, BlackPixel(app->display, app->screen));
     
     XSetFont(app->display, app->gc, app->main_font->fid);
-    XMapWindow(app->display, app->window);
+
+    xres_init(&app->res, app->display, app->screen, app->window);
+    xb_init(&app->batch, app->display, app->window, &app->metrics);
+    render_init_xlib(&app->r, app->display, app->window, &app->res, &app->batch,
+                     app->main_font, &app->metrics, WINDOW_WIDTH, WINDOW_HEIGHT);
 
     XpmAttributes xa;
     memset(&xa, 0, sizeof(xa));
@@ -605,7 +1311,11 @@ void initialize_app(WeatherApp* app) {
     } else {
         printf("Failed to load cloud XPM (code %d)\n", xpm_result);
         app->cloud_pixmap = None;}
-    
+
+    // Полоса готова до первого Expose
+    compose_cloud_band(app, WINDOW_WIDTH);
+    cloud_anim_init(app);
+    XMapWindow(app->display, app->window);
 }
 
 // Очистка ресурсов
@@ -614,62 +1324,849 @@ void cleanup_app(WeatherApp* app) {
         if (app->main_font){
             XFreeFont(app->display, app->main_font);
         }
+        xres_free(&app->res);
+        if (app->cloud_pixmap != None) XFreePixmap(app->display, app->cloud_pixmap);
+        if (app->cloud_mask != None) XFreePixmap(app->display, app->cloud_mask);
+        if (app->band_pixmap != None) XFreePixmap(app->display, app->band_pixmap);
         XFreeGC(app->display, app->gc);
         XDestroyWindow(app->display, app->window);
         XCloseDisplay(app->display);
     }
-    if (app->cloud_pixmap != None) {
-        XFreePixmap(app->display, app->cloud_pixmap);
+
+}
+
+// ---------- dashboard ----------
+// weather --dashboard [город|id ...]   (или WEATHER_DASHBOARD="500096,524901,Tula")
+// Сетка плиток, по плитке на город. Города с числовым id OpenWeatherMap
+// собираются в пачки (WEATHER_DASH_GROUP, до DASH_GROUP_MAX - предел API)
+// и приходят одним ответом /data/2.5/group?id=...; имя из справочника
+// городов (citydb.h) заменяется на id, город по прочему имени идет
+// отдельным /weather?q=. Одновременно идет не больше DASH_INFLIGHT
+// запросов, остальные пачки ждут в очереди; соединения с API они делят
+// через пул fetch.h. Ответ пачки разбирается потоково, и плитка
+// рисуется, как только кончился ее элемент list[i], не дожидаясь
+// остальных городов пачки.
+// У каждой пачки свой таймер обновления со своей фазой в периоде
+// (равномерно по пачкам, со случайной долей): пачки идут в API по
+// очереди, а не разом, и не сходятся со временем - срок всегда
+// выравнивается на фазу. Ошибка сети - повтор пачки с sched_backoff,
+// на плитках остаются последние данные.
+
+#define DASH_MAX_CITIES 32
+#define DASH_GROUP_MAX  20      // id в одном запросе /group
+#define DASH_INFLIGHT   2       // одновременных запросов
+#define DASH_COLS       3
+#define DASH_LINE       16      // шаг строк в плитке
+
+typedef struct Dashboard Dashboard;
+
+typedef struct {
+    int id;                         // 0 - запрос по имени
+    char query[MAX_CITY_LENGTH];    // как город задан
+    int batch;
+    WeatherReply reply;             // последние данные
+    int has_data;
+    long updated;                   // time() получения
+    unsigned long seq;              // запрос пачки, который их принес
+    char error[100];
+} DashTile;
+
+typedef struct {
+    Dashboard* dash;
+    int tiles[DASH_GROUP_MAX];      // индексы в dash->tiles
+    int count;
+    int by_name;                    // один город по имени: /weather?q=
+    SchedTimer timer;
+    double phase_ms;                // фаза обновления в периоде
+    unsigned long queued;           // место в очереди; 0 - не ждет
+    int slot;                       // -1 - не идет
+    int pending;                    // срок пришел, пока окно свернуто
+    int failures;
+    unsigned long seq;              // номер текущего запроса
+} DashBatch;
+
+// Запрос в работе: ответ целиком (cod, message - или весь город для q=)
+// и поля текущего элемента list[i]
+typedef struct {
+    Dashboard* dash;
+    int batch;                      // -1 - слот свободен
+    Fetch fetch;
+    JsonParser json;
+    WeatherReply top;
+    JsonParser item;
+    WeatherReply stage;
+    int index;                      // i элемента в stage; -1 - нет
+} DashSlot;
+
+struct Dashboard {
+    WeatherApp* app;
+    DashTile tiles[DASH_MAX_CITIES];
+    int ntiles;
+    DashBatch batches[DASH_MAX_CITIES];
+    int nbatches;
+    DashSlot slots[DASH_INFLIGHT];
+    int inflight;
+    unsigned long queue_seq;
+    double start_ms;
+
+    unsigned long requests;
+    unsigned long cities;           // городов в отправленных запросах
+    unsigned long failed;
+    unsigned long tiles_drawn;      // плиток, нарисованных по приходу
+    int peak_inflight;
+    int shown;                      // плиток с данными
+    double first_tile_us;           // от запуска
+    double all_tiles_us;
+};
+
+static double dash_launch_us;
+
+static void dash_add_city(Dashboard* d, const char* s, int len) {
+    while (len > 0 && *s == ' ') s++, len--;
+    while (len > 0 && s[len - 1] == ' ') len--;
+    if (len <= 0 || len >= MAX_CITY_LENGTH || d->ntiles == DASH_MAX_CITIES) return;
+
+    DashTile* t = &d->tiles[d->ntiles++];
+    memset(t, 0, sizeof(*t));
+    memcpy(t->query, s, len);
+    t->id = (int)strspn(t->query, "0123456789") == len ? atoi(t->query) : 0;
+    // Город из справочника - по id, в общую пачку
+    const CityRecord* c = t->id ? NULL : citydb_exact(cities(), t->query);
+    if (c) t->id = c->id;
+}
+
+// Пачки: id - подряд по group штук, каждый город по имени - своя
+static void dash_plan(Dashboard* d, int group) {
+    DashBatch* open = NULL;
+    for (int i = 0; i < d->ntiles; i++) {
+        DashTile* t = &d->tiles[i];
+        DashBatch* b = t->id && open && open->count < group ? open : &d->batches[d->nbatches++];
+        if (b->count == 0) {
+            memset(b, 0, sizeof(*b));
+            b->dash = d;
+            b->slot = -1;
+            b->by_name = t->id == 0;
+            if (t->id) open = b;
+        }
+        t->batch = b - d->batches;
+        b->tiles[b->count++] = i;
+    }
+    for (int i = 0; i < d->nbatches; i++) {
+        double share = d->app->refresh_ms / d->nbatches;
+        d->batches[i].phase_ms = (i + (double)random() / RAND_MAX / 2) * share;
     }
+}
 
+// Геометрия плитки i
+static void dash_tile_rect(const Dashboard* d, int i, int* x, int* y, int* w, int* h) {
+    int cols = d->ntiles < DASH_COLS ? d->ntiles : DASH_COLS;
+    int rows = (d->ntiles + cols - 1) / cols;
+    int top = CLOUD_HEIGHT + 40;
+    *w = (WINDOW_WIDTH - 20) / cols;
+    *h = (WINDOW_HEIGHT - top - 10) / rows;
+    if (*h > 130) *h = 130;
+    *x = 10 + i % cols * *w;
+    *y = top + i / cols * *h;
 }
 
-int main(int argc, char* argv[]) {
-    WeatherApp app;
-    const char* current_city = DEFAULT_CITY;
+static void dash_draw_tile(Dashboard* d, int i) {
+    Renderer* r = &d->app->r;
+    DashTile* t = &d->tiles[i];
+    DashBatch* b = &d->batches[t->batch];
+    int x, y, w, h;
+    char line[100];
+    dash_tile_rect(d, i, &x, &y, &w, &h);
+
+    r_clear(r, x, y, w, h);
+    r_rect(r, COLOR_FG, x + 2, y + 2, w - 4, h - 4);
+
+    const char* lines[5];
+    char temp[50], humidity[30];
+    int n = 0;
+    lines[n++] = t->has_data && t->reply.name[0] ? t->reply.name : t->query;
+    if (t->has_data) {
+        snprintf(temp, sizeof(temp), "%.1f °C (feels %.1f)",
+                 t->reply.temp - 273.15, t->reply.feels_like - 273.15);
+        snprintf(humidity, sizeof(humidity), "Humidity: %d %%", t->reply.humidity);
+        lines[n++] = temp;
+        lines[n++] = t->reply.description;
+        lines[n++] = humidity;
+    }
+    if (b->slot >= 0) {
+        snprintf(line, sizeof(line), "%s...", t->has_data ? "Updating" : "Loading");
+    } else if (t->error[0]) {
+        snprintf(line, sizeof(line), "%s", t->error);
+    } else if (t->has_data) {
+        long age = time(NULL) - t->updated;
+        if (age < 60) snprintf(line, sizeof(line), "updated just now");
+        else snprintf(line, sizeof(line), "updated %ld min ago", age / 60);
+    } else {
+        line[0] = '\0';
+    }
+    lines[n++] = line;
+
+    for (int k = 0; k < n; k++) {
+        int ty = y + 8 + DASH_LINE * (k + 1);
+        if (ty > y + h - 6) break;
+        r_text(r, COLOR_FG, x + 10, ty, lines[k], strlen(lines[k]));
+    }
+}
+
+static void dash_draw_header(Dashboard* d) {
+    Renderer* r = &d->app->r;
+    char title[100];
+    int y = CLOUD_HEIGHT + 10;
+    snprintf(title, sizeof(title), "Weather dashboard: %d cities, %d/%d requests in flight",
+             d->ntiles, d->inflight, DASH_INFLIGHT);
+    r_clear(r, 0, y, WINDOW_WIDTH, 28);
+    r_text(r, COLOR_FG, 20, y + 15, title, strlen(title));
+    r_line(r, COLOR_FG, 20, y + 22, WINDOW_WIDTH - 20, y + 22);
+}
+
+void draw_dashboard(Dashboard* d) {
+    r_clear(&d->app->r, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    dash_draw_header(d);
+    for (int i = 0; i < d->ntiles; i++) dash_draw_tile(d, i);
+    r_flush(&d->app->r);
+}
+
+// Плитки пачки и заголовок (смена состояния запроса)
+static void dash_draw_batch(Dashboard* d, DashBatch* b) {
+    dash_draw_header(d);
+    for (int k = 0; k < b->count; k++) dash_draw_tile(d, b->tiles[k]);
+    r_flush(&d->app->r);
+}
+
+// Город из stage (элемент index ответа пачки) - на плитку и сразу на экран
+static void dash_commit(DashSlot* s) {
+    Dashboard* d = s->dash;
+    DashBatch* b = &d->batches[s->batch];
+    if (s->index < 0 || !(s->item.found & 1 << WF_TEMP)) return;
+
+    // Город узнается по id; без id - по порядку, как в запросе
+    int tile = -1;
+    for (int k = 0; k < b->count && (s->item.found & 1 << WF_ID); k++) {
+        if (d->tiles[b->tiles[k]].id == s->stage.id) tile = b->tiles[k];
+    }
+    if (tile < 0 && (b->by_name || !(s->item.found & 1 << WF_ID)) && s->index < b->count) {
+        tile = b->tiles[s->index];
+    }
+    if (tile < 0) return;
+
+    DashTile* t = &d->tiles[tile];
+    if (!t->has_data) {
+        d->shown++;
+        if (d->shown == 1) d->first_tile_us = now_us() - dash_launch_us;
+        if (d->shown == d->ntiles) d->all_tiles_us = now_us() - dash_launch_us;
+    }
+    t->reply = s->stage;
+    t->reply.found = s->item.found;
+    t->has_data = 1;
+    record_history(&t->reply, t->query);
+    t->updated = time(NULL);
+    t->seq = b->seq;
+    t->error[0] = '\0';
+
+    if (d->app->mapped) {
+        dash_draw_tile(d, tile);
+        r_flush(&d->app->r);
+        d->tiles_drawn++;
+    }
+}
+
+// Значения вида list[i].<путь> - в stage по таблице weather_fields;
+// новый i значит, что элемент i-1 закончился
+static void dash_on_value(JsonParser* p, int type, const char* value, int len, void* ctx) {
+    DashSlot* s = ctx;
+    if (p->path_len >= JSON_PATH_MAX || strncmp(p->path, "list[", 5) != 0) return;
+    char* end;
+    int index = (int)strtol(p->path + 5, &end, 10);
+    if (*end != ']' || end[1] != '.') return;
+
+    if (index != s->index) {
+        dash_commit(s);
+        memset(&s->stage, 0, sizeof(s->stage));
+        s->item.found = 0;
+        s->index = index;
+    }
+    const char* rest = end + 2;
+    json_match(&s->item, rest, p->path + p->path_len - rest, type, value, len);
+}
+
+static void dash_pump(Dashboard* d);
+
+static void dash_refresh_due(SchedTimer* t) {
+    DashBatch* b = t->ctx;
+    if (!b->dash->app->mapped) {
+        b->pending = 1;
+        return;
+    }
+    if (!b->queued && b->slot < 0) b->queued = ++b->dash->queue_seq;
+    dash_pump(b->dash);
+}
+
+// Следующий срок пачки: ближайший момент ее фазы не раньше чем через
+// полпериода (после ручного обновления или повтора фаза восстанавливается)
+static double dash_next_ms(Dashboard* d, DashBatch* b) {
+    double period = d->app->refresh_ms;
+    double now = sched_now_ms() - d->start_ms;
+    long k = (long)((now + period / 2 - b->phase_ms) / period) + 1;
+    if (k < 0) k = 0;
+    return b->phase_ms + k * period - now;
+}
+
+// Пачка завершилась (успешно или нет): плитки, таймер, следующая в очереди
+static void dash_finish(Dashboard* d, DashSlot* s) {
+    DashBatch* b = &d->batches[s->batch];
+    char error[100] = "";
+
+    if (s->fetch.state != FETCH_DONE) {
+        snprintf(error, sizeof(error), "Network %s", s->fetch.timed_out ? "timeout" : "error");
+    } else if (!json_finish(&s->json)) {
+        snprintf(error, sizeof(error), "Bad API response");
+    } else if ((s->json.found & 1 << WF_COD) && s->top.cod != 200) {
+        snprintf(error, sizeof(error), "API Error: %s",
+                 s->json.found & 1 << WF_MESSAGE ? s->top.message : "unknown");
+    } else if (b->by_name) {
+        // /weather?q= - город и есть весь ответ
+        s->stage = s->top;
+        s->item.found = s->json.found;
+        s->index = 0;
+        dash_commit(s);
+    } else {
+        dash_commit(s);     // последний элемент list
+    }
+
+    s->batch = -1;
+    b->slot = -1;
+    d->inflight--;
+
+    if (error[0]) {
+        d->failed++;
+        b->failures++;
+        double delay = sched_backoff(b->failures, RETRY_BASE_MS, RETRY_MAX_MS);
+        printf("Dashboard batch %d: %s, retry in %.1f s\n", (int)(b - d->batches), error, delay / 1e3);
+        for (int k = 0; k < b->count; k++) {
+            snprintf(d->tiles[b->tiles[k]].error, sizeof(d->tiles[0].error), "%s", error);
+        }
+        sched_add(&d->app->sched, &b->timer, delay, dash_refresh_due, b);
+    } else {
+        b->failures = 0;
+        for (int k = 0; k < b->count; k++) {
+            DashTile* t = &d->tiles[b->tiles[k]];
+            if (t->seq != b->seq) snprintf(t->error, sizeof(t->error), "Not in API response");
+        }
+        sched_add(&d->app->sched, &b->timer, dash_next_ms(d, b), dash_refresh_due, b);
+    }
+    if (d->app->mapped) dash_draw_batch(d, b);
+    dash_pump(d);
+}
+
+static void dash_start(Dashboard* d, DashBatch* b, DashSlot* s) {
+    char url[512];
+    int len, port;
+    const char* host = api_server(&port);
+    if (b->by_name) {
+        len = snprintf(url, sizeof(url), "/data/2.5/weather?q=%s&appid=%s",
+                       d->tiles[b->tiles[0]].query, OPENWEATHER_API_KEY);
+    } else {
+        len = snprintf(url, sizeof(url), "/data/2.5/group?id=");
+        for (int k = 0; k < b->count; k++) {
+            len += snprintf(url + len, sizeof(url) - len, "%s%d", k ? "," : "", d->tiles[b->tiles[k]].id);
+        }
+        len += snprintf(url + len, sizeof(url) - len, "&appid=%s", OPENWEATHER_API_KEY);
+    }
+
+    sched_cancel(&d->app->sched, &b->timer);
+    b->queued = 0;
+    b->pending = 0;
+    b->slot = s - d->slots;
+    b->seq++;
+    s->batch = b - d->batches;
+    d->inflight++;
+    if (d->inflight > d->peak_inflight) d->peak_inflight = d->inflight;
+    d->requests++;
+    d->cities += b->count;
+
+    memset(&s->top, 0, sizeof(s->top));
+    json_init(&s->json, weather_fields, WF_COUNT, &s->top);
+    s->json.on_value = dash_on_value;
+    s->json.ctx = s;
+    json_init(&s->item, weather_fields, WF_COUNT, &s->stage);
+    s->index = -1;
+    fetch_set_sink(&s->fetch, json_sink, &s->json);
+
+    if (d->app->mapped) dash_draw_batch(d, b);
+    if (len >= (int)sizeof(url) || !fetch_start(&s->fetch, host, port, url)) {
+        dash_finish(d, s);
+    }
+}
+
+// Свободные слоты - пачкам из очереди, в порядке постановки
+static void dash_pump(Dashboard* d) {
+    for (int i = 0; i < DASH_INFLIGHT && d->inflight < DASH_INFLIGHT; i++) {
+        if (d->slots[i].batch >= 0) continue;
+        DashBatch* next = NULL;
+        for (int k = 0; k < d->nbatches; k++) {
+            DashBatch* b = &d->batches[k];
+            if (b->queued && (!next || b->queued < next->queued)) next = b;
+        }
+        if (!next) return;
+        dash_start(d, next, &d->slots[i]);
+    }
+}
+
+// Пачка - в очередь сейчас (запуск, клик по плитке, окно развернуто)
+static void dash_queue(Dashboard* d, DashBatch* b) {
+    if (b->slot >= 0 || b->queued) return;
+    b->queued = ++d->queue_seq;
+    dash_pump(d);
+}
 
-    // Инициализация
-    memset(&app, 0, sizeof(WeatherApp));
-    strcpy(app.city, DEFAULT_CITY);
-    app.input_active = 0;
+void dash_report(const Dashboard* d) {
+    int by_name = 0;
+    for (int i = 0; i < d->nbatches; i++) by_name += d->batches[i].by_name;
+    printf("Dashboard: %d cities in %d requests per round (%d by name); %lu requests sent, "
+           "%.1f cities each, %lu failed, peak %d/%d in flight\n",
+           d->ntiles, d->nbatches, by_name, d->requests,
+           d->requests ? (double)d->cities / d->requests : 0.0, d->failed,
+           d->peak_inflight, DASH_INFLIGHT);
+    printf("Dashboard: first tile %.1f ms, all tiles %.1f ms after launch; %lu tiles drawn on arrival\n",
+           d->first_tile_us / 1e3, d->all_tiles_us / 1e3, d->tiles_drawn);
+}
+
+int run_dashboard(int argc, char* argv[]) {
+    static WeatherApp app;
+    static Dashboard dash;
+    dash_launch_us = now_us();
+    dash.app = &app;
 
-    if (argc > 1) {
-        current_city = argv[1];
-        strcpy(app.city, current_city);
+    const char* list = getenv("WEATHER_DASHBOARD");
+    if (argc > 0) {
+        for (int i = 0; i < argc; i++) dash_add_city(&dash, argv[i], strlen(argv[i]));
+    } else {
+        // Десяток городов по умолчанию - все по id, одним-двумя запросами
+        if (!list) list = "500096,524901,498817,551487,1496747,1486209,"
+                          "520555,499099,501175,542420,2013348,524305";
+        while (*list) {
+            int len = strcspn(list, ",");
+            dash_add_city(&dash, list, len);
+            list += len + (list[len] == ',');
+        }
     }
+    if (dash.ntiles == 0) {
+        fprintf(stderr, "Dashboard: no cities\n");
+        return 1;
+    }
+
+    initialize_app(&app);
+    XStoreName(app.display, app.window, "MINIX3 Weather Dashboard");
+    sched_init(&app.sched);
+    const char* refresh = getenv("WEATHER_REFRESH");
+    app.refresh_ms = (refresh && atoi(refresh) > 0 ? atoi(refresh) : REFRESH_DEFAULT_S) * 1e3;
+    dash.start_ms = sched_now_ms();
+
+    // По умолчанию города по id делятся поровну между слотами: первый
+    // экран - за один круг параллельных запросов, обновления - вразбивку
+    const char* group_env = getenv("WEATHER_DASH_GROUP");
+    int group = group_env ? atoi(group_env) : (dash.ntiles + DASH_INFLIGHT - 1) / DASH_INFLIGHT;
+    if (group < 1) group = 1;
+    if (group > DASH_GROUP_MAX) group = DASH_GROUP_MAX;
+    dash_plan(&dash, group);
+    printf("Dashboard: %d cities, %d requests per round, up to %d at once\n",
+           dash.ntiles, dash.nbatches, DASH_INFLIGHT);
+
+    for (int i = 0; i < DASH_INFLIGHT; i++) {
+        dash.slots[i].dash = &dash;
+        dash.slots[i].batch = -1;
+        fetch_init(&dash.slots[i].fetch);
+    }
+    for (int i = 0; i < dash.nbatches; i++) dash_queue(&dash, &dash.batches[i]);
+
+    XEvent event;
+    int running = 1;
+    int xfd = ConnectionNumber(app.display);
+
+    while (running) {
+        cloud_anim_tick(&app);
+        sched_run(&app.sched);
+
+        if (!XPending(app.display)) {
+            struct pollfd fds[1 + DASH_INFLIGHT];
+            int slot_fd[DASH_INFLIGHT];
+            int nfds = 1;
+            fds[0].fd = xfd;
+            fds[0].events = POLLIN;
+            fds[0].revents = 0;
+            int timeout = cloud_anim_timeout_ms(&app);
+            int timer = sched_timeout_ms(&app.sched);
+            if (timer >= 0 && (timeout < 0 || timer < timeout)) timeout = timer;
+            for (int i = 0; i < DASH_INFLIGHT; i++) {
+                Fetch* f = &dash.slots[i].fetch;
+                slot_fd[i] = -1;
+                if (!fetch_active(f)) continue;
+                int left = fetch_timeout_ms(f);
+                if (left >= 0 && (timeout < 0 || left < timeout)) timeout = left;
+                if (fetch_fd(f) < 0) continue;
+                fds[nfds].fd = fetch_fd(f);
+                fds[nfds].events = fetch_events(f);
+                fds[nfds].revents = 0;
+                slot_fd[i] = nfds++;
+            }
+            if (poll(fds, nfds, timeout) < 0 && errno != EINTR) {
+                perror("poll");
+                break;
+            }
+            for (int i = 0; i < DASH_INFLIGHT; i++) {
+                DashSlot* s = &dash.slots[i];
+                if (s->batch < 0 || !fetch_active(&s->fetch)) continue;
+                if (fetch_step(&s->fetch, slot_fd[i] >= 0 ? fds[slot_fd[i]].revents : 0) ||
+                    fetch_check_deadline(&s->fetch)) {
+                    dash_finish(&dash, s);
+                }
+            }
+            continue;
+        }
+
+        XNextEvent(app.display, &event);
+
+        switch (event.type) {
+            case Expose:
+                if (event.xexpose.count == 0) draw_dashboard(&dash);
+                break;
+
+            case MapNotify:
+            case UnmapNotify:
+                if (event.xany.window == app.window) {
+                    app.mapped = event.type == MapNotify;
+                    cloud_anim_set(&app, app.mapped, app.anim.visible);
+                    // Пачки, чей срок пришел, пока окно было свернуто
+                    for (int i = 0; app.mapped && i < dash.nbatches; i++) {
+                        if (dash.batches[i].pending) dash_queue(&dash, &dash.batches[i]);
+                    }
+                }
+                break;
+
+            case VisibilityNotify:
+                if (event.xvisibility.window == app.band) {
+                    cloud_anim_set(&app, app.anim.mapped,
+                                   event.xvisibility.state != VisibilityFullyObscured);
+                }
+                break;
+
+            case ConfigureNotify:
+                compose_cloud_band(&app, event.xconfigure.width);
+                break;
+
+            case ButtonPress:
+                // Клик по плитке - обновить ее пачку сейчас
+                for (int i = 0; i < dash.ntiles; i++) {
+                    int x, y, w, h;
+                    dash_tile_rect(&dash, i, &x, &y, &w, &h);
+                    if (event.xbutton.x >= x && event.xbutton.x < x + w &&
+                        event.xbutton.y >= y && event.xbutton.y < y + h) {
+                        dash_queue(&dash, &dash.batches[dash.tiles[i].batch]);
+                        break;
+                    }
+                }
+                break;
+
+            case KeyPress:
+                if (event.xkey.keycode == XKeysymToKeycode(app.display, XK_q) ||
+                    event.xkey.keycode == XKeysymToKeycode(app.display, XK_Q)) {
+                    running = 0;
+                }
+                break;
+        }
+    }
+
+    for (int i = 0; i < DASH_INFLIGHT; i++) fetch_free(&dash.slots[i].fetch);
+    fetch_report(stdout);
+    sched_report(&app.sched, stdout);
+    history_report(stdout);
+    dash_report(&dash);
+    cloud_anim_report(&app, dash_launch_us);
+    cleanup_app(&app);
+    printf("Weather Dashboard closed\n");
+    return 0;
+}
+
+// ---------- history ----------
+// weather --history <город|id> [суток]
+// Итог и по строке на сутки из локальной истории - без X и без сети.
+
+int run_history(int argc, char* argv[]) {
+    static HistoryMap h;
+    if (argc < 1) {
+        fprintf(stderr, "usage: weather --history <city|id> [days]\n");
+        return 1;
+    }
+    const char* city = argv[0];
+    int days = argc > 1 ? atoi(argv[1]) : HISTORY_DAYS;
+    if (days < 1) days = 1;
+    int id = strspn(city, "0123456789") == strlen(city) ? atoi(city) : 0;
+    if (!history_open(&h, id, city) && !history_find(&h, city)) {
+        fprintf(stderr, "No history for %s\n", city);
+        return 1;
+    }
+
+    long long now = time(NULL), t0 = now - days * 86400LL;
+    long first;
+    long count = history_range(&h, t0, now + 1, &first);
+    HistorySummary sum;
+    history_summary(&h, first, count, &sum);
+    printf("%s: %ld observations in file, %ld in last %d days\n", h.header->name, h.n, count, days);
+    if (count == 0) {
+        history_close(&h);
+        return 0;
+    }
+    printf("min %.1f °C, max %.1f °C, avg %.1f °C\n", sum.min, sum.max, sum.avg);
+
+    // Сутки - корзины от t0; пустые сутки не печатаются
+    HistoryBucket* b = calloc(days, sizeof(HistoryBucket));
+    int nb = b ? history_downsample(&h, t0, now + 1, b, days) : 0;
+    for (int i = 0; i < nb; i++) {
+        char day[32];
+        time_t t = (time_t)(t0 + b[i].hours * 3600);
+        strftime(day, sizeof(day), "%Y-%m-%d", localtime(&t));
+        printf("  %s  %6.1f .. %6.1f  avg %6.1f  (%d obs)\n", day, b[i].min, b[i].max, b[i].avg, b[i].n);
+    }
+    free(b);
+    history_close(&h);
+    return 0;
+}
+
+// ---------- headless benchmark ----------
+// weather --headless [--frames N] [--snapshot file.ppm] [--forecast file.json] [city]
+// Рисует окно программным растеризатором без X сервера и сети
+// (данные из get_weather_mock, график - из сохраненного ответа
+// /data/2.5/forecast): N кадров с набором текста в поле города.
+// Печатает время кадра и сохраняет снимок последнего кадра.
+
+int run_headless(int argc, char* argv[]) {
+    static WeatherApp app;
+    const char* city = DEFAULT_CITY;
+    const char* snapshot = NULL;
+    const char* forecast = NULL;
+    int frames = 1000;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot = argv[++i];
+        } else if (strcmp(argv[i], "--forecast") == 0 && i + 1 < argc) {
+            forecast = argv[++i];
+        } else {
+            city = argv[i];
+        }
+    }
+    if (frames < 1) frames = 1;
+
+    memset(&app, 0, sizeof(app));
+    if (!render_init_soft(&app.r, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+        fprintf(stderr, "Cannot allocate frame buffer\n");
+        return 1;
+    }
+    get_weather_mock(&app, city);
+    if (forecast) {
+        HttpBuffer text = {0};
+        FILE* f = fopen(forecast, "rb");
+        char chunk[4096];
+        size_t n;
+        while (f && (n = fread(chunk, 1, sizeof(chunk), f)) > 0) http_buffer_append(&text, chunk, n);
+        if (f) fclose(f);
+        if (!f || !forecast_parse(&app.forecast, text.data, text.len)) {
+            fprintf(stderr, "%s: no forecast\n", forecast);
+        }
+        http_buffer_free(&text);
+    }
+
+    const char* typed = "Saint Petersburg";
+    double start = now_us();
+    for (int i = 0; i < frames; i++) {
+        // Набор текста в поле ввода, как при нажатиях клавиш
+        int len = i % (strlen(typed) + 1);
+        memcpy(app.input_city, typed, len);
+        app.input_city[len] = '\0';
+        app.input_active = 1;
+        update_suggestions(&app);
+        draw_weather(&app);
+    }
+    double elapsed = now_us() - start;
+
+    printf("headless: %d frames, %.1f us/frame, %lu primitives/frame\n",
+           frames, elapsed / frames, app.r.prims / frames);
+    suggest_report(&app);
+
+    if (snapshot && !r_save_ppm(&app.r, snapshot)) {
+        perror(snapshot);
+        return 1;
+    }
+    render_free(&app.r);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        return run_headless(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--history") == 0) {
+        return run_history(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--dashboard") == 0) {
+        return run_dashboard(argc - 2, argv + 2);
+    }
+
+    double t_launch = now_us();
+    WeatherApp app;
+    const char* current_city = DEFAULT_CITY;
+    if (argc > 1) current_city = argv[1];
 
     printf("Starting Weather App for city: %s\n", current_city);
     printf("Using OpenWeatherMap API\n");
 
+    // Инициализация (initialize_app обнуляет app - город и снимок после нее)
     initialize_app(&app);
+    snprintf(app.city, sizeof(app.city), "%s", current_city);
 
-    // Первоначальная загрузка погоды
-    if (!get_weather(&app, OPENWEATHER_API_KEY, current_city)) {
-        get_weather_mock(&app, current_city);
-    }
+    // Снимок прошлого запуска - первый кадр не ждет сеть
+    int from_snapshot = load_snapshot(&app, current_city);
+
+    // Первоначальная загрузка погоды (окно рисуется, пока ждем ответ)
+    sched_init(&app.sched);
+    const char* refresh = getenv("WEATHER_REFRESH");
+    app.refresh_ms = (refresh && atoi(refresh) > 0 ? atoi(refresh) : REFRESH_DEFAULT_S) * 1e3;
+    fetch_init(&app.fetch);
+    fetch_init(&app.forecast_fetch);
+    app.width = WINDOW_WIDTH;
+    app.height = WINDOW_HEIGHT;
+    request_weather(&app, current_city);
+    int first_frame = 1;
 
-    // Главный цикл
+    // Главный цикл: события X и сокет запроса в одном poll
     XEvent event;
     int running = 1;
     int offset_y = CLOUD_HEIGHT + 10; // используем единое смещение для всех элементов
+    int xfd = ConnectionNumber(app.display);
 
     while (running) {
+        cloud_anim_tick(&app);
+        sched_run(&app.sched);
+
+        if (!XPending(app.display)) {
+            struct pollfd fds[3];
+            int nfds = 1;
+            fds[0].fd = xfd;
+            fds[0].events = POLLIN;
+            fds[0].revents = 0;
+            int fetching = fetch_active(&app.fetch);
+            int weather_fd = -1;
+            if (fetching && fetch_fd(&app.fetch) >= 0) {
+                fds[nfds].fd = fetch_fd(&app.fetch);
+                fds[nfds].events = fetch_events(&app.fetch);
+                fds[nfds].revents = 0;
+                weather_fd = nfds++;
+            }
+            int forecasting = fetch_active(&app.forecast_fetch);
+            int forecast_fd = -1;
+            if (forecasting && fetch_fd(&app.forecast_fetch) >= 0) {
+                fds[nfds].fd = fetch_fd(&app.forecast_fetch);
+                fds[nfds].events = fetch_events(&app.forecast_fetch);
+                fds[nfds].revents = 0;
+                forecast_fd = nfds++;
+            }
+
+            // Сон не дольше срока текущей фазы запросов, кадра дрейфа и таймеров
+            int timeout = fetch_timeout_ms(&app.fetch);
+            int forecast = fetch_timeout_ms(&app.forecast_fetch);
+            int frame = cloud_anim_timeout_ms(&app);
+            int timer = sched_timeout_ms(&app.sched);
+            if (forecast >= 0 && (timeout < 0 || forecast < timeout)) timeout = forecast;
+            if (frame >= 0 && (timeout < 0 || frame < timeout)) timeout = frame;
+            if (timer >= 0 && (timeout < 0 || timer < timeout)) timeout = timer;
+            if (poll(fds, nfds, timeout) < 0 && errno != EINTR) {
+                perror("poll");
+                break;
+            }
+            if (fetching && (fetch_step(&app.fetch, weather_fd >= 0 ? fds[weather_fd].revents : 0) ||
+                             fetch_check_deadline(&app.fetch))) {
+                finish_weather(&app);
+                draw_weather(&app);
+            }
+            if (forecasting &&
+                (fetch_step(&app.forecast_fetch, forecast_fd >= 0 ? fds[forecast_fd].revents : 0) ||
+                 fetch_check_deadline(&app.forecast_fetch))) {
+                finish_forecast(&app);
+                draw_weather(&app);
+            }
+            continue;
+        }
+
         XNextEvent(app.display, &event);
 
         switch (event.type) {
             case Expose:
                 draw_weather(&app);
+                if (first_frame) {
+                    first_frame = 0;
+                    XSync(app.display, False);
+                    printf("First frame after %.1f ms (%s)\n", (now_us() - t_launch) / 1e3,
+                           app.loading ? (from_snapshot ? "snapshot" : "empty, loading") :
+                           app.live_city[0] ? "cached data" : "mock data");
+                }
+                break;
+
+            case MapNotify:
+            case UnmapNotify:
+                if (event.xany.window == app.window) {
+                    app.mapped = event.type == MapNotify;
+                    cloud_anim_set(&app, app.mapped, app.anim.visible);
+                    // Обновление, отложенное на время свернутого окна
+                    if (app.mapped && app.refresh_pending) {
+                        refresh_weather(&app);
+                        draw_weather(&app);
+                    }
+                }
+                break;
+
+            case VisibilityNotify:
+                if (event.xvisibility.window == app.band) {
+                    cloud_anim_set(&app, app.anim.mapped,
+                                   event.xvisibility.state != VisibilityFullyObscured);
+                }
+                break;
+
+            case ConfigureNotify:
+                // Новая ширина - полоса пересобирается; высота ей не важна,
+                // но от нее зависит высота графика внизу
+                compose_cloud_band(&app, event.xconfigure.width);
+                if (event.xconfigure.width != app.width || event.xconfigure.height != app.height) {
+                    app.width = event.xconfigure.width;
+                    app.height = event.xconfigure.height;
+                    draw_weather(&app);
+                }
                 break;
 
             case ButtonPress: {
                 int mx = event.xbutton.x;
                 int my = event.xbutton.y;
 
+                // Подсказка под полем ввода
+                int pick = suggestion_at(&app, mx, my);
+                if (pick >= 0) {
+                    apply_input_city(&app, pick);
+                    current_city = app.city;
+                    draw_weather(&app);
+                    break;
+                }
+
                 // Поле ввода города
                 int input_x = 150, input_y = offset_y + 30, input_w = 200, input_h = 25;
                 if (mx >= input_x && mx <= input_x + input_w &&
                     my >= input_y && my <= input_y + input_h) {
                     app.input_active = 1;
+                    update_suggestions(&app);
                     draw_weather(&app);
                     break;
                 }
@@ -678,15 +2175,8 @@ int main(int argc, char* argv[]) {
                 int ok_x = 360, ok_y = offset_y + 30, ok_w = 30, ok_h = 25;
                 if (mx >= ok_x && mx <= ok_x + ok_w &&
                     my >= ok_y && my <= ok_y + ok_h) {
-                    if (strlen(app.input_city) > 0) {
-                        strcpy(app.city, app.input_city);
+                    if (apply_input_city(&app, app.input_active ? app.suggest_sel : -1)) {
                         current_city = app.city;
-                        app.input_city[0] = '\0';
-                        app.input_active = 0;
-
-                        if (!get_weather(&app, OPENWEATHER_API_KEY, app.city)) {
-                            get_weather_mock(&app, app.city);
-                        }
                         draw_weather(&app);
                     }
                     break;
@@ -696,9 +2186,7 @@ int main(int argc, char* argv[]) {
                 int refresh_x = 150, refresh_y = offset_y + 225, refresh_w = 100, refresh_h = 30;
                 if (mx >= refresh_x && mx <= refresh_x + refresh_w &&
                     my >= refresh_y && my <= refresh_y + refresh_h) {
-                    if (!get_weather(&app, OPENWEATHER_API_KEY, current_city)) {
-                        get_weather_mock(&app, current_city);
-                    }
+                    refresh_weather(&app);
                     draw_weather(&app);
                     break;
                 }
@@ -717,18 +2205,37 @@ int main(int argc, char* argv[]) {
                 break;
             }
 
-            case KeyPress:
+            case KeyPress: {
+                int typing = app.input_active;
                 handle_key_press(&app, event.xkey, &current_city);
 
-                // Выход по Q
-                if (event.xkey.keycode == XKeysymToKeycode(app.display, XK_q) ||
-                    event.xkey.keycode == XKeysymToKeycode(app.display, XK_Q)) {
+                // H - внизу история города вместо прогноза и обратно
+                if (!typing && XLookupKeysym(&event.xkey, 0) == XK_h) {
+                    app.show_history = !app.show_history;
+                    draw_weather(&app);
+                }
+
+                // Выход по Q (не во время ввода - Q бывает в названии города)
+                if (!typing && (event.xkey.keycode == XKeysymToKeycode(app.display, XK_q) ||
+                                event.xkey.keycode == XKeysymToKeycode(app.display, XK_Q))) {
                     running = 0;
                 }
                 break;
+            }
         }
     }
 
+    fetch_free(&app.fetch);
+    fetch_free(&app.forecast_fetch);
+    http_buffer_free(&app.body);
+    http_cache_free(&app.cached);
+    fetch_report(stdout);
+    http_cache_report(stdout);
+    history_report(stdout);
+    history_close(&app.history);
+    suggest_report(&app);
+    sched_report(&app.sched, stdout);
+    cloud_anim_report(&app, t_launch);
     cleanup_app(&app);
     printf("Weather App closed\n");
     return 0;
@@ -0,0 +1,355 @@
+#ifndef XBATCH_H
+#define XBATCH_H
+
+// Покадровая запись примитивов Xlib.
+// Вместо отдельного запроса на каждую линию/прямоугольник/строку примитивы
+// копятся за кадр, группируются по GC и уходят пачками:
+// XFillRectangles, XDrawRectangles, XDrawSegments и XDrawText
+// (все строки одной базовой линии - одним PolyText). Ломаные и
+// многоугольники графиков не группируются (у каждого свой запрос
+// XDrawLines / XFillPolygon), но идут в тот же порядок сброса.
+// Порядок при сбросе: заливки, залитые многоугольники, контуры и линии,
+// ломаные, текст. Так можно менять порядок только непересекающихся
+// примитивов: если новый примитив задевает уже накопленный, который
+// при сбросе ушел бы позже него (слой выше или группа GC дальше), батч
+// сначала сбрасывается - где примитивы перекрываются, порядок вызовов
+// сохраняется. Прямоугольники охвата копятся по слою и по группе.
+//
+// Статистика: "до" - сколько запросов ушло бы при рисовании по одному
+// примитиву, "после" - сколько реально отправлено (по NextRequest).
+// При XBATCH_STATS=1 в окружении печатается по каждому кадру.
+
+#include <X11/Xlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmetrics.h"
+
+#define XB_MAX_GROUPS 8
+#define XB_MAX_PRIMS  128
+#define XB_MAX_TEXTS  256
+#define XB_TEXT_BYTES 8192
+#define XB_MAX_POLYS  16
+#define XB_POLY_POINTS 4096
+
+// Слои в порядке сброса
+enum { XB_FILL, XB_POLYFILL, XB_OUTLINE, XB_POLYLINE, XB_TEXT, XB_LAYERS };
+
+// Охват накопленных примитивов; пустой - w = 0
+typedef struct {
+    int x0, y0, x1, y1;     // x1, y1 - не включительно
+} XBBox;
+
+typedef struct {
+    GC gc;
+    XRectangle fills[XB_MAX_PRIMS];
+    int nfill;
+    XRectangle rects[XB_MAX_PRIMS];
+    int nrect;
+    XSegment segs[XB_MAX_PRIMS];
+    int nseg;
+    XBBox fill_box;         // заливок группы
+    XBBox outline_box;      // контуров и линий группы
+} XBGroup;
+
+typedef struct {
+    GC gc;
+    int x, y;
+    int off, len;           // строка в b->chars
+} XBText;
+
+typedef struct {
+    GC gc;
+    int fill;               // XFillPolygon; иначе XDrawLines
+    int off, n;             // точки в b->points
+} XBPoly;
+
+typedef struct {
+    Display *dpy;
+    Drawable drawable;
+    FontMetrics *metrics;   // шрифт текста во всех GC батча
+
+    XBGroup groups[XB_MAX_GROUPS];
+    int ngroups;
+    XBText texts[XB_MAX_TEXTS];
+    int ntexts;
+    char chars[XB_TEXT_BYTES];
+    int nchars;
+    XBPoly polys[XB_MAX_POLYS];
+    int npolys;
+    XPoint points[XB_POLY_POINTS];
+    int npoints;
+    XBBox layer_box[XB_LAYERS];
+
+    unsigned long recorded;     // примитивов в текущем кадре
+    unsigned long frames;
+    unsigned long total_before;
+    unsigned long total_after;
+    int verbose;
+} XBatch;
+
+static void xb_flush(XBatch *b);
+
+static void xb_init(XBatch *b, Display *dpy, Drawable drawable, FontMetrics *metrics) {
+    memset(b, 0, sizeof(*b));
+    b->dpy = dpy;
+    b->drawable = drawable;
+    b->metrics = metrics;
+    const char *env = getenv("XBATCH_STATS");
+    b->verbose = env && *env && *env != '0';
+}
+
+// xb_flush для xres_set_flush: GC освобождается только после отправки батча
+static void xb_flush_ctx(void *batch) {
+    xb_flush(batch);
+}
+
+static XBBox xb_box(int x, int y, int w, int h) {
+    XBBox box = { x, y, x + w, y + h };
+    return box;
+}
+
+static int xb_box_hits(const XBBox *a, const XBBox *b) {
+    return a->x0 < a->x1 && b->x0 < b->x1 &&
+           a->x0 < b->x1 && b->x0 < a->x1 && a->y0 < b->y1 && b->y0 < a->y1;
+}
+
+static void xb_box_add(XBBox *a, const XBBox *b) {
+    if (a->x0 >= a->x1) {
+        *a = *b;
+        return;
+    }
+    if (b->x0 < a->x0) a->x0 = b->x0;
+    if (b->y0 < a->y0) a->y0 = b->y0;
+    if (b->x1 > a->x1) a->x1 = b->x1;
+    if (b->y1 > a->y1) a->y1 = b->y1;
+}
+
+// Новый примитив слоя layer с охватом box: если его задевает накопленный
+// примитив, который сброс отправил бы позже, батч сбрасывается сейчас.
+// Позже идут слои выше, а в слоях заливок и контуров - группы дальше
+// группы gc (новый GC встанет последним, дальше него никого нет)
+static void xb_keep_order(XBatch *b, int layer, GC gc, XBBox box) {
+    if (b->recorded == 0) return;
+    for (int l = layer + 1; l < XB_LAYERS; l++) {
+        if (xb_box_hits(&b->layer_box[l], &box)) {
+            xb_flush(b);
+            return;
+        }
+    }
+    if (layer != XB_FILL && layer != XB_OUTLINE) return;
+    int i = 0;
+    while (i < b->ngroups && b->groups[i].gc != gc) i++;
+    for (i++; i < b->ngroups; i++) {
+        const XBGroup *g = &b->groups[i];
+        if (xb_box_hits(layer == XB_FILL ? &g->fill_box : &g->outline_box, &box)) {
+            xb_flush(b);
+            return;
+        }
+    }
+}
+
+static XBGroup *xb_group(XBatch *b, GC gc) {
+    for (int i = 0; i < b->ngroups; i++) {
+        if (b->groups[i].gc == gc) return &b->groups[i];
+    }
+    if (b->ngroups == XB_MAX_GROUPS) xb_flush(b);
+
+    XBGroup *g = &b->groups[b->ngroups++];
+    g->gc = gc;
+    g->nfill = g->nrect = g->nseg = 0;
+    g->fill_box.x1 = g->fill_box.x0;
+    g->outline_box.x1 = g->outline_box.x0;
+    return g;
+}
+
+static void xb_fill(XBatch *b, GC gc, int x, int y, int w, int h) {
+    XBBox box = xb_box(x, y, w, h);
+    xb_keep_order(b, XB_FILL, gc, box);
+    XBGroup *g = xb_group(b, gc);
+    if (g->nfill == XB_MAX_PRIMS) {
+        xb_flush(b);
+        g = xb_group(b, gc);
+    }
+    XRectangle *r = &g->fills[g->nfill++];
+    r->x = x; r->y = y; r->width = w; r->height = h;
+    xb_box_add(&g->fill_box, &box);
+    xb_box_add(&b->layer_box[XB_FILL], &box);
+    b->recorded++;
+}
+
+static void xb_rect(XBatch *b, GC gc, int x, int y, int w, int h) {
+    XBBox box = xb_box(x, y, w + 1, h + 1);
+    xb_keep_order(b, XB_OUTLINE, gc, box);
+    XBGroup *g = xb_group(b, gc);
+    if (g->nrect == XB_MAX_PRIMS) {
+        xb_flush(b);
+        g = xb_group(b, gc);
+    }
+    XRectangle *r = &g->rects[g->nrect++];
+    r->x = x; r->y = y; r->width = w; r->height = h;
+    xb_box_add(&g->outline_box, &box);
+    xb_box_add(&b->layer_box[XB_OUTLINE], &box);
+    b->recorded++;
+}
+
+static void xb_line(XBatch *b, GC gc, int x1, int y1, int x2, int y2) {
+    XBBox box = { x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, (x1 > x2 ? x1 : x2) + 1, (y1 > y2 ? y1 : y2) + 1 };
+    xb_keep_order(b, XB_OUTLINE, gc, box);
+    XBGroup *g = xb_group(b, gc);
+    if (g->nseg == XB_MAX_PRIMS) {
+        xb_flush(b);
+        g = xb_group(b, gc);
+    }
+    XSegment *s = &g->segs[g->nseg++];
+    s->x1 = x1; s->y1 = y1; s->x2 = x2; s->y2 = y2;
+    xb_box_add(&g->outline_box, &box);
+    xb_box_add(&b->layer_box[XB_OUTLINE], &box);
+    b->recorded++;
+}
+
+static void xb_text(XBatch *b, GC gc, int x, int y, const char *s, int len) {
+    if (len <= 0) return;
+    if (b->ntexts == XB_MAX_TEXTS || b->nchars + len > XB_TEXT_BYTES) xb_flush(b);
+    if (len > XB_TEXT_BYTES) len = XB_TEXT_BYTES;
+
+    // Текст - верхний слой, позже него не уходит ничего. Охват без метрик
+    // шрифта не известен - тогда до правого края и на строку вокруг базы
+    XBBox box;
+    if (b->metrics && b->metrics->font) {
+        box = xb_box(x, y - b->metrics->ascent, fm_text_width(b->metrics, s, len),
+                     b->metrics->ascent + b->metrics->descent);
+    } else {
+        box = xb_box(x, y - 32, 1 << 15, 48);
+    }
+    xb_box_add(&b->layer_box[XB_TEXT], &box);
+
+    XBText *t = &b->texts[b->ntexts++];
+    t->gc = gc;
+    t->x = x;
+    t->y = y;
+    t->off = b->nchars;
+    t->len = len;
+    memcpy(b->chars + b->nchars, s, len);
+    b->nchars += len;
+    b->recorded++;
+}
+
+// Ломаная (fill = 0) или залитый многоугольник из n точек; точки копируются
+static void xb_poly(XBatch *b, GC gc, const XPoint *pts, int n, int fill) {
+    if (n < 2) return;
+    if (n > XB_POLY_POINTS) n = XB_POLY_POINTS;
+    XBBox box = { pts[0].x, pts[0].y, pts[0].x + 1, pts[0].y + 1 };
+    for (int i = 1; i < n; i++) {
+        if (pts[i].x < box.x0) box.x0 = pts[i].x;
+        if (pts[i].y < box.y0) box.y0 = pts[i].y;
+        if (pts[i].x >= box.x1) box.x1 = pts[i].x + 1;
+        if (pts[i].y >= box.y1) box.y1 = pts[i].y + 1;
+    }
+    int layer = fill ? XB_POLYFILL : XB_POLYLINE;
+    xb_keep_order(b, layer, gc, box);
+    if (b->npolys == XB_MAX_POLYS || b->npoints + n > XB_POLY_POINTS) xb_flush(b);
+    xb_box_add(&b->layer_box[layer], &box);
+
+    XBPoly *p = &b->polys[b->npolys++];
+    p->gc = gc;
+    p->fill = fill;
+    p->off = b->npoints;
+    p->n = n;
+    memcpy(b->points + b->npoints, pts, n * sizeof(XPoint));
+    b->npoints += n;
+    b->recorded++;
+}
+
+static int xb_text_cmp(const void *pa, const void *pb) {
+    const XBText *a = pa;
+    const XBText *b = pb;
+    if (a->gc != b->gc) return a->gc < b->gc ? -1 : 1;
+    if (a->y != b->y) return a->y - b->y;
+    return a->x - b->x;
+}
+
+static void xb_flush_texts(XBatch *b) {
+    XTextItem items[XB_MAX_TEXTS];
+
+    qsort(b->texts, b->ntexts, sizeof(XBText), xb_text_cmp);
+
+    int i = 0;
+    while (i < b->ntexts) {
+        XBText *first = &b->texts[i];
+        int n = 0;
+        int pen = first->x;
+
+        // Строки одного GC на одной базовой линии - один PolyText8;
+        // delta сдвигает перо от конца предыдущей строки (без метрик
+        // шрифта конец строки неизвестен - тогда по строке на запрос)
+        while (i < b->ntexts && b->texts[i].gc == first->gc && b->texts[i].y == first->y &&
+               (n == 0 || b->metrics)) {
+            XBText *t = &b->texts[i];
+            items[n].chars = b->chars + t->off;
+            items[n].nchars = t->len;
+            items[n].delta = t->x - pen;
+            items[n].font = None;
+            if (b->metrics) pen = t->x + fm_text_width(b->metrics, items[n].chars, t->len);
+            n++;
+            i++;
+        }
+        XDrawText(b->dpy, b->drawable, first->gc, first->x, first->y, items, n);
+    }
+}
+
+static void xb_flush(XBatch *b) {
+    if (b->recorded == 0) return;
+
+    unsigned long start = NextRequest(b->dpy);
+
+    for (int i = 0; i < b->ngroups; i++) {
+        XBGroup *g = &b->groups[i];
+        if (g->nfill) XFillRectangles(b->dpy, b->drawable, g->gc, g->fills, g->nfill);
+    }
+    for (int i = 0; i < b->npolys; i++) {
+        XBPoly *p = &b->polys[i];
+        if (p->fill) XFillPolygon(b->dpy, b->drawable, p->gc, b->points + p->off, p->n,
+                                  Nonconvex, CoordModeOrigin);
+    }
+    for (int i = 0; i < b->ngroups; i++) {
+        XBGroup *g = &b->groups[i];
+        if (g->nrect) XDrawRectangles(b->dpy, b->drawable, g->gc, g->rects, g->nrect);
+        if (g->nseg) XDrawSegments(b->dpy, b->drawable, g->gc, g->segs, g->nseg);
+    }
+    for (int i = 0; i < b->npolys; i++) {
+        XBPoly *p = &b->polys[i];
+        if (!p->fill) XDrawLines(b->dpy, b->drawable, p->gc, b->points + p->off, p->n,
+                                 CoordModeOrigin);
+    }
+    if (b->ntexts) xb_flush_texts(b);
+
+    unsigned long sent = NextRequest(b->dpy) - start;
+
+    b->frames++;
+    b->total_before += b->recorded;
+    b->total_after += sent;
+    if (b->verbose) {
+        printf("frame %lu: %lu requests immediate, %lu batched\n",
+               b->frames, b->recorded, sent);
+    }
+
+    b->ngroups = 0;
+    b->ntexts = 0;
+    b->nchars = 0;
+    b->npolys = 0;
+    b->npoints = 0;
+    b->recorded = 0;
+    memset(b->layer_box, 0, sizeof(b->layer_box));
+}
+
+static void xb_report(const XBatch *b) {
+    if (b->frames == 0) return;
+    printf("Draw batching: %lu frames, avg %.1f requests immediate -> %.1f batched\n",
+           b->frames,
+           (double)b->total_before / b->frames,
+           (double)b->total_after / b->frames);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef XMETRICS_H
+#define XMETRICS_H
+
+// Кэш метрик шрифта.
+// Таблица ширин на 256 символов строится один раз из XFontStruct.per_char,
+// дальше ширина текста считается локально, без запросов к X серверу:
+// одно сложение на байт, запоминать готовые ширины строк дороже.
+
+#include <X11/Xlib.h>
+#include <string.h>
+
+typedef struct {
+    XFontStruct *font;
+    int ascent;
+    int descent;
+    short adv[256];     // ширина каждого однобайтового символа
+} FontMetrics;
+
+// Повторяет логику XTextWidth: несуществующий глиф заменяется default_char,
+// а если нет и его - ширина 0.
+static XCharStruct *xm_char_info(XFontStruct *fs, unsigned int col) {
+    // В двухбайтовом шрифте однобайтовый текст попадает в строку 0
+    if (fs->min_byte1 != 0) return NULL;
+    if (col < fs->min_char_or_byte2 || col > fs->max_char_or_byte2) return NULL;
+    if (!fs->per_char) return &fs->min_bounds;
+
+    XCharStruct *cs = &fs->per_char[col - fs->min_char_or_byte2];
+    if (cs->width == 0 &&
+        (cs->rbearing | cs->lbearing | cs->ascent | cs->descent) == 0) return NULL;
+    return cs;
+}
+
+static void fm_init(FontMetrics *fm, XFontStruct *font) {
+    memset(fm, 0, sizeof(*fm));
+    fm->font = font;
+    if (!font) return;
+
+    fm->ascent = font->ascent;
+    fm->descent = font->descent;
+
+    XCharStruct *def = xm_char_info(font, font->default_char);
+    for (int c = 0; c < 256; c++) {
+        XCharStruct *cs = xm_char_info(font, c);
+        if (!cs) cs = def;
+        fm->adv[c] = cs ? cs->width : 0;
+    }
+}
+
+static int fm_measure(const FontMetrics *fm, const char *s, int len) {
+    const unsigned char *p = (const unsigned char *)s;
+    int w = 0;
+    for (int i = 0; i < len; i++) w += fm->adv[p[i]];
+    return w;
+}
+
+static int fm_text_width(const FontMetrics *fm, const char *s, int len) {
+    if (!s || len <= 0) return 0;
+    return fm_measure(fm, s, len);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef XRES_H
+#define XRES_H
+
+// Менеджер ресурсов X сервера.
+// Шрифты, цвета и настроенные GC запрашиваются у сервера один раз,
+// дальше отрисовка получает готовые хэндлы из кэша. XLoadQueryFont и
+// XAllocColor - это запросы с ответом (round trip), поэтому в цикле
+// перерисовки их быть не должно. Счетчики показывают, сколько таких
+// обращений удалось избежать.
+
+#include <X11/Xlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmetrics.h"
+
+#define XRES_MAX_FONTS  8
+#define XRES_MAX_COLORS 16
+#define XRES_MAX_GCS    16
+
+typedef struct {
+    char name[64];
+    XFontStruct *font;      // NULL - шрифт не найден (тоже кэшируется)
+    FontMetrics metrics;
+} XResFont;
+
+typedef struct {
+    unsigned short r, g, b;
+    unsigned long pixel;
+} XResColor;
+
+typedef struct {
+    unsigned long fg;
+    unsigned long bg;
+    Font fid;               // None - шрифт GC по умолчанию
+    GC gc;
+    unsigned long used;     // номер последней выдачи (для вытеснения)
+} XResGC;
+
+typedef struct {
+    Display *dpy;
+    int screen;
+    Drawable drawable;
+
+    XResFont fonts[XRES_MAX_FONTS];
+    int font_count;
+    XResColor colors[XRES_MAX_COLORS];
+    int color_count;
+    XResGC gcs[XRES_MAX_GCS];
+    int gc_count;
+    unsigned long gc_tick;
+
+    unsigned long round_trips;  // выполненные запросы с ответом
+    unsigned long avoided;      // запросы с ответом, замененные кэшем
+    unsigned long gc_reused;    // выдачи готового GC
+    unsigned long gc_evicted;   // GC, освобожденные при полной таблице
+    void (*flush)(void *ctx);   // отправка отложенного рисования (xb_flush)
+    void *flush_ctx;
+} XResources;
+
+static void xres_init(XResources *res, Display *dpy, int screen, Drawable drawable) {
+    memset(res, 0, sizeof(*res));
+    res->dpy = dpy;
+    res->screen = screen;
+    res->drawable = drawable;
+}
+
+// GC из xres_gc рисуют через батч (xbatch.h): перед освобождением GC
+// вызывается flush(ctx), чтобы отложенное рисование ушло раньше XFreeGC
+static void xres_set_flush(XResources *res, void (*flush)(void *ctx), void *ctx) {
+    res->flush = flush;
+    res->flush_ctx = ctx;
+}
+
+static XResFont *xres_font(XResources *res, const char *name) {
+    for (int i = 0; i < res->font_count; i++) {
+        if (strcmp(res->fonts[i].name, name) == 0) {
+            res->avoided++;
+            return res->fonts[i].font ? &res->fonts[i] : NULL;
+        }
+    }
+
+    XFontStruct *font = XLoadQueryFont(res->dpy, name);
+    res->round_trips++;
+    if (res->font_count == XRES_MAX_FONTS) {
+        if (font) XFreeFont(res->dpy, font);
+        return NULL;
+    }
+
+    XResFont *f = &res->fonts[res->font_count++];
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->font = font;
+    fm_init(&f->metrics, font);
+    return font ? f : NULL;
+}
+
+// Цвет по компонентам 0..65535, при неудаче - белый, как раньше в LightGrayPixel
+static unsigned long xres_color(XResources *res,
+                                unsigned short r, unsigned short g, unsigned short b) {
+    for (int i = 0; i < res->color_count; i++) {
+        XResColor *c = &res->colors[i];
+        if (c->r == r && c->g == g && c->b == b) {
+            res->avoided++;
+            return c->pixel;
+        }
+    }
+
+    XColor color;
+    color.red = r;
+    color.green = g;
+    color.blue = b;
+    color.flags = DoRed | DoGreen | DoBlue;
+
+    unsigned long pixel = WhitePixel(res->dpy, res->screen);
+    if (XAllocColor(res->dpy, DefaultColormap(res->dpy, res->screen), &color)) {
+        pixel = color.pixel;
+    }
+    res->round_trips++;
+
+    if (res->color_count < XRES_MAX_COLORS) {
+        XResColor *c = &res->colors[res->color_count++];
+        c->r = r;
+        c->g = g;
+        c->b = b;
+        c->pixel = pixel;
+    }
+    return pixel;
+}
+
+// GC с заданными цветами и шрифтом; один и тот же набор - один GC.
+// Таблица полна - освобождается GC, дольше всех не выдававшийся, чтобы
+// новый не утекал на каждом кадре. Тексты и многоугольники XBatch держат
+// GC до xb_flush, поэтому батч сперва отправляется - иначе сервер получил
+// бы рисование освобожденным GC (BadGC)
+static GC xres_gc(XResources *res, unsigned long fg, unsigned long bg, Font fid) {
+    for (int i = 0; i < res->gc_count; i++) {
+        XResGC *g = &res->gcs[i];
+        if (g->fg == fg && g->bg == bg && g->fid == fid) {
+            g->used = ++res->gc_tick;
+            res->gc_reused++;
+            return g->gc;
+        }
+    }
+
+    XGCValues values;
+    unsigned long mask = GCForeground | GCBackground;
+    values.foreground = fg;
+    values.background = bg;
+    if (fid != None) {
+        values.font = fid;
+        mask |= GCFont;
+    }
+    GC gc = XCreateGC(res->dpy, res->drawable, mask, &values);
+
+    XResGC *g;
+    if (res->gc_count < XRES_MAX_GCS) {
+        g = &res->gcs[res->gc_count++];
+    } else {
+        g = &res->gcs[0];
+        for (int i = 1; i < res->gc_count; i++) {
+            if (res->gcs[i].used < g->used) g = &res->gcs[i];
+        }
+        if (res->flush) res->flush(res->flush_ctx);
+        XFreeGC(res->dpy, g->gc);
+        res->gc_evicted++;
+    }
+    g->fg = fg;
+    g->bg = bg;
+    g->fid = fid;
+    g->gc = gc;
+    g->used = ++res->gc_tick;
+    return gc;
+}
+
+static void xres_report(const XResources *res) {
+    printf("X resources: %d fonts, %d colors, %d GCs; "
+           "round trips: %lu done, %lu avoided; GC reuses: %lu, evicted: %lu\n",
+           res->font_count, res->color_count, res->gc_count,
+           res->round_trips, res->avoided, res->gc_reused, res->gc_evicted);
+}
+
+static void xres_free(XResources *res) {
+    for (int i = 0; i < res->gc_count; i++) {
+        XFreeGC(res->dpy, res->gcs[i].gc);
+    }
+    for (int i = 0; i < res->font_count; i++) {
+        if (res->fonts[i].font) XFreeFont(res->dpy, res->fonts[i].font);
+    }
+    res->gc_count = 0;
+    res->font_count = 0;
+    res->color_count = 0;
+}
+
+#endif